@@ -157,6 +157,464 @@ typedef CL_API_ENTRY cl_int (CL_API_CALL *clTerminateContextKHR_fn)(cl_context /
  * Standard Portable Intermediate Representation (SPIR) instance
  */
 
+/*********************************
+* cl_khr_command_buffer extension *
+*********************************/
+#define cl_khr_command_buffer 1
+
+typedef cl_bitfield         cl_device_command_buffer_capabilities_khr;
+typedef struct _cl_command_buffer_khr * cl_command_buffer_khr;
+typedef cl_uint             cl_sync_point_khr;
+typedef cl_uint             cl_command_buffer_info_khr;
+typedef cl_uint             cl_command_buffer_state_khr;
+typedef cl_ulong            cl_command_buffer_properties_khr;
+typedef cl_bitfield         cl_command_buffer_flags_khr;
+typedef cl_ulong            cl_ndrange_kernel_command_properties_khr;
+typedef struct _cl_mutable_command_khr * cl_mutable_command_khr;
+
+/* cl_device_info */
+#define CL_DEVICE_COMMAND_BUFFER_CAPABILITIES_KHR               0x12A9
+#define CL_DEVICE_COMMAND_BUFFER_REQUIRED_QUEUE_PROPERTIES_KHR  0x12AA
+
+/* cl_device_command_buffer_capabilities_khr - bitfield */
+#define CL_COMMAND_BUFFER_CAPABILITY_KERNEL_PRINTF_KHR          (1 << 0)
+#define CL_COMMAND_BUFFER_CAPABILITY_DEVICE_SIDE_ENQUEUE_KHR    (1 << 1)
+#define CL_COMMAND_BUFFER_CAPABILITY_SIMULTANEOUS_USE_KHR       (1 << 2)
+#define CL_COMMAND_BUFFER_CAPABILITY_OUT_OF_ORDER_KHR           (1 << 3)
+
+/* cl_command_buffer_properties_khr */
+#define CL_COMMAND_BUFFER_FLAGS_KHR                             0x1293
+
+/* cl_command_buffer_flags_khr */
+#define CL_COMMAND_BUFFER_SIMULTANEOUS_USE_KHR                  (1 << 0)
+
+/* Error codes */
+#define CL_INVALID_COMMAND_BUFFER_KHR                           -1138
+#define CL_INVALID_SYNC_POINT_WAIT_LIST_KHR                     -1139
+#define CL_INCOMPATIBLE_COMMAND_QUEUE_KHR                       -1140
+
+/* cl_command_buffer_info_khr */
+#define CL_COMMAND_BUFFER_QUEUES_KHR                            0x1294
+#define CL_COMMAND_BUFFER_NUM_QUEUES_KHR                        0x1295
+#define CL_COMMAND_BUFFER_REFERENCE_COUNT_KHR                   0x1296
+#define CL_COMMAND_BUFFER_STATE_KHR                             0x1297
+#define CL_COMMAND_BUFFER_PROPERTIES_ARRAY_KHR                  0x1298
+#define CL_COMMAND_BUFFER_CONTEXT_KHR                           0x1299
+
+/* cl_command_buffer_state_khr */
+#define CL_COMMAND_BUFFER_STATE_RECORDING_KHR                   0
+#define CL_COMMAND_BUFFER_STATE_EXECUTABLE_KHR                  1
+#define CL_COMMAND_BUFFER_STATE_PENDING_KHR                     2
+
+/* cl_command_type */
+#define CL_COMMAND_COMMAND_BUFFER_KHR                           0x12A8
+
+extern CL_API_ENTRY cl_command_buffer_khr CL_API_CALL
+clCreateCommandBufferKHR(cl_uint                                  /* num_queues */,
+                         const cl_command_queue *                 /* queues */,
+                         const cl_command_buffer_properties_khr * /* properties */,
+                         cl_int *                                 /* errcode_ret */) CL_EXT_SUFFIX__VERSION_1_2;
+
+typedef CL_API_ENTRY cl_command_buffer_khr (CL_API_CALL *clCreateCommandBufferKHR_fn)(cl_uint                                  /* num_queues */,
+                                                                                      const cl_command_queue *                 /* queues */,
+                                                                                      const cl_command_buffer_properties_khr * /* properties */,
+                                                                                      cl_int *                                 /* errcode_ret */) CL_EXT_SUFFIX__VERSION_1_2;
+
+extern CL_API_ENTRY cl_int CL_API_CALL
+clFinalizeCommandBufferKHR(cl_command_buffer_khr /* command_buffer */) CL_EXT_SUFFIX__VERSION_1_2;
+
+typedef CL_API_ENTRY cl_int (CL_API_CALL *clFinalizeCommandBufferKHR_fn)(cl_command_buffer_khr /* command_buffer */) CL_EXT_SUFFIX__VERSION_1_2;
+
+extern CL_API_ENTRY cl_int CL_API_CALL
+clRetainCommandBufferKHR(cl_command_buffer_khr /* command_buffer */) CL_EXT_SUFFIX__VERSION_1_2;
+
+typedef CL_API_ENTRY cl_int (CL_API_CALL *clRetainCommandBufferKHR_fn)(cl_command_buffer_khr /* command_buffer */) CL_EXT_SUFFIX__VERSION_1_2;
+
+extern CL_API_ENTRY cl_int CL_API_CALL
+clReleaseCommandBufferKHR(cl_command_buffer_khr /* command_buffer */) CL_EXT_SUFFIX__VERSION_1_2;
+
+typedef CL_API_ENTRY cl_int (CL_API_CALL *clReleaseCommandBufferKHR_fn)(cl_command_buffer_khr /* command_buffer */) CL_EXT_SUFFIX__VERSION_1_2;
+
+extern CL_API_ENTRY cl_int CL_API_CALL
+clEnqueueCommandBufferKHR(cl_uint               /* num_queues */,
+                          cl_command_queue *    /* queues */,
+                          cl_command_buffer_khr /* command_buffer */,
+                          cl_uint               /* num_events_in_wait_list */,
+                          const cl_event *      /* event_wait_list */,
+                          cl_event *            /* event */) CL_EXT_SUFFIX__VERSION_1_2;
+
+typedef CL_API_ENTRY cl_int (CL_API_CALL *clEnqueueCommandBufferKHR_fn)(cl_uint               /* num_queues */,
+                                                                        cl_command_queue *    /* queues */,
+                                                                        cl_command_buffer_khr /* command_buffer */,
+                                                                        cl_uint               /* num_events_in_wait_list */,
+                                                                        const cl_event *      /* event_wait_list */,
+                                                                        cl_event *            /* event */) CL_EXT_SUFFIX__VERSION_1_2;
+
+extern CL_API_ENTRY cl_int CL_API_CALL
+clCommandBarrierWithWaitListKHR(cl_command_buffer_khr     /* command_buffer */,
+                                cl_command_queue          /* command_queue */,
+                                cl_uint                   /* num_sync_points_in_wait_list */,
+                                const cl_sync_point_khr * /* sync_point_wait_list */,
+                                cl_sync_point_khr *       /* sync_point */,
+                                cl_mutable_command_khr *  /* mutable_handle */) CL_EXT_SUFFIX__VERSION_1_2;
+
+typedef CL_API_ENTRY cl_int (CL_API_CALL *clCommandBarrierWithWaitListKHR_fn)(cl_command_buffer_khr     /* command_buffer */,
+                                                                              cl_command_queue          /* command_queue */,
+                                                                              cl_uint                   /* num_sync_points_in_wait_list */,
+                                                                              const cl_sync_point_khr * /* sync_point_wait_list */,
+                                                                              cl_sync_point_khr *       /* sync_point */,
+                                                                              cl_mutable_command_khr *  /* mutable_handle */) CL_EXT_SUFFIX__VERSION_1_2;
+
+extern CL_API_ENTRY cl_int CL_API_CALL
+clCommandCopyBufferKHR(cl_command_buffer_khr     /* command_buffer */,
+                       cl_command_queue          /* command_queue */,
+                       cl_mem                    /* src_buffer */,
+                       cl_mem                    /* dst_buffer */,
+                       size_t                    /* src_offset */,
+                       size_t                    /* dst_offset */,
+                       size_t                    /* size */,
+                       cl_uint                   /* num_sync_points_in_wait_list */,
+                       const cl_sync_point_khr * /* sync_point_wait_list */,
+                       cl_sync_point_khr *       /* sync_point */,
+                       cl_mutable_command_khr *  /* mutable_handle */) CL_EXT_SUFFIX__VERSION_1_2;
+
+typedef CL_API_ENTRY cl_int (CL_API_CALL *clCommandCopyBufferKHR_fn)(cl_command_buffer_khr     /* command_buffer */,
+                                                                     cl_command_queue          /* command_queue */,
+                                                                     cl_mem                    /* src_buffer */,
+                                                                     cl_mem                    /* dst_buffer */,
+                                                                     size_t                    /* src_offset */,
+                                                                     size_t                    /* dst_offset */,
+                                                                     size_t                    /* size */,
+                                                                     cl_uint                   /* num_sync_points_in_wait_list */,
+                                                                     const cl_sync_point_khr * /* sync_point_wait_list */,
+                                                                     cl_sync_point_khr *       /* sync_point */,
+                                                                     cl_mutable_command_khr *  /* mutable_handle */) CL_EXT_SUFFIX__VERSION_1_2;
+
+extern CL_API_ENTRY cl_int CL_API_CALL
+clCommandCopyBufferRectKHR(cl_command_buffer_khr     /* command_buffer */,
+                           cl_command_queue          /* command_queue */,
+                           cl_mem                    /* src_buffer */,
+                           cl_mem                    /* dst_buffer */,
+                           const size_t *            /* src_origin */,
+                           const size_t *            /* dst_origin */,
+                           const size_t *            /* region */,
+                           size_t                    /* src_row_pitch */,
+                           size_t                    /* src_slice_pitch */,
+                           size_t                    /* dst_row_pitch */,
+                           size_t                    /* dst_slice_pitch */,
+                           cl_uint                   /* num_sync_points_in_wait_list */,
+                           const cl_sync_point_khr * /* sync_point_wait_list */,
+                           cl_sync_point_khr *       /* sync_point */,
+                           cl_mutable_command_khr *  /* mutable_handle */) CL_EXT_SUFFIX__VERSION_1_2;
+
+typedef CL_API_ENTRY cl_int (CL_API_CALL *clCommandCopyBufferRectKHR_fn)(cl_command_buffer_khr     /* command_buffer */,
+                                                                         cl_command_queue          /* command_queue */,
+                                                                         cl_mem                    /* src_buffer */,
+                                                                         cl_mem                    /* dst_buffer */,
+                                                                         const size_t *            /* src_origin */,
+                                                                         const size_t *            /* dst_origin */,
+                                                                         const size_t *            /* region */,
+                                                                         size_t                    /* src_row_pitch */,
+                                                                         size_t                    /* src_slice_pitch */,
+                                                                         size_t                    /* dst_row_pitch */,
+                                                                         size_t                    /* dst_slice_pitch */,
+                                                                         cl_uint                   /* num_sync_points_in_wait_list */,
+                                                                         const cl_sync_point_khr * /* sync_point_wait_list */,
+                                                                         cl_sync_point_khr *       /* sync_point */,
+                                                                         cl_mutable_command_khr *  /* mutable_handle */) CL_EXT_SUFFIX__VERSION_1_2;
+
+extern CL_API_ENTRY cl_int CL_API_CALL
+clCommandFillBufferKHR(cl_command_buffer_khr     /* command_buffer */,
+                       cl_command_queue          /* command_queue */,
+                       cl_mem                    /* buffer */,
+                       const void *              /* pattern */,
+                       size_t                    /* pattern_size */,
+                       size_t                    /* offset */,
+                       size_t                    /* size */,
+                       cl_uint                   /* num_sync_points_in_wait_list */,
+                       const cl_sync_point_khr * /* sync_point_wait_list */,
+                       cl_sync_point_khr *       /* sync_point */,
+                       cl_mutable_command_khr *  /* mutable_handle */) CL_EXT_SUFFIX__VERSION_1_2;
+
+typedef CL_API_ENTRY cl_int (CL_API_CALL *clCommandFillBufferKHR_fn)(cl_command_buffer_khr     /* command_buffer */,
+                                                                     cl_command_queue          /* command_queue */,
+                                                                     cl_mem                    /* buffer */,
+                                                                     const void *              /* pattern */,
+                                                                     size_t                    /* pattern_size */,
+                                                                     size_t                    /* offset */,
+                                                                     size_t                    /* size */,
+                                                                     cl_uint                   /* num_sync_points_in_wait_list */,
+                                                                     const cl_sync_point_khr * /* sync_point_wait_list */,
+                                                                     cl_sync_point_khr *       /* sync_point */,
+                                                                     cl_mutable_command_khr *  /* mutable_handle */) CL_EXT_SUFFIX__VERSION_1_2;
+
+extern CL_API_ENTRY cl_int CL_API_CALL
+clCommandNDRangeKernelKHR(cl_command_buffer_khr                           /* command_buffer */,
+                          cl_command_queue                                /* command_queue */,
+                          const cl_ndrange_kernel_command_properties_khr * /* properties */,
+                          cl_kernel                                       /* kernel */,
+                          cl_uint                                         /* work_dim */,
+                          const size_t *                                  /* global_work_offset */,
+                          const size_t *                                  /* global_work_size */,
+                          const size_t *                                  /* local_work_size */,
+                          cl_uint                                         /* num_sync_points_in_wait_list */,
+                          const cl_sync_point_khr *                       /* sync_point_wait_list */,
+                          cl_sync_point_khr *                             /* sync_point */,
+                          cl_mutable_command_khr *                        /* mutable_handle */) CL_EXT_SUFFIX__VERSION_1_2;
+
+typedef CL_API_ENTRY cl_int (CL_API_CALL *clCommandNDRangeKernelKHR_fn)(cl_command_buffer_khr                           /* command_buffer */,
+                                                                        cl_command_queue                                /* command_queue */,
+                                                                        const cl_ndrange_kernel_command_properties_khr * /* properties */,
+                                                                        cl_kernel                                       /* kernel */,
+                                                                        cl_uint                                         /* work_dim */,
+                                                                        const size_t *                                  /* global_work_offset */,
+                                                                        const size_t *                                  /* global_work_size */,
+                                                                        const size_t *                                  /* local_work_size */,
+                                                                        cl_uint                                         /* num_sync_points_in_wait_list */,
+                                                                        const cl_sync_point_khr *                       /* sync_point_wait_list */,
+                                                                        cl_sync_point_khr *                             /* sync_point */,
+                                                                        cl_mutable_command_khr *                        /* mutable_handle */) CL_EXT_SUFFIX__VERSION_1_2;
+
+extern CL_API_ENTRY cl_int CL_API_CALL
+clGetCommandBufferInfoKHR(cl_command_buffer_khr      /* command_buffer */,
+                          cl_command_buffer_info_khr /* param_name */,
+                          size_t                     /* param_value_size */,
+                          void *                     /* param_value */,
+                          size_t *                   /* param_value_size_ret */) CL_EXT_SUFFIX__VERSION_1_2;
+
+typedef CL_API_ENTRY cl_int (CL_API_CALL *clGetCommandBufferInfoKHR_fn)(cl_command_buffer_khr      /* command_buffer */,
+                                                                        cl_command_buffer_info_khr /* param_name */,
+                                                                        size_t                     /* param_value_size */,
+                                                                        void *                     /* param_value */,
+                                                                        size_t *                   /* param_value_size_ret */) CL_EXT_SUFFIX__VERSION_1_2;
+
+/*******************************************
+* cl_intel_unified_shared_memory extension *
+*******************************************/
+#define cl_intel_unified_shared_memory 1
+
+typedef cl_bitfield         cl_device_unified_shared_memory_capabilities_intel;
+typedef cl_ulong            cl_mem_properties_intel;
+typedef cl_bitfield         cl_mem_alloc_flags_intel;
+typedef cl_uint             cl_mem_info_intel;
+typedef cl_uint             cl_unified_shared_memory_type_intel;
+typedef cl_uint             cl_mem_advice_intel;
+
+/* cl_device_info */
+#define CL_DEVICE_HOST_MEM_CAPABILITIES_INTEL                   0x4190
+#define CL_DEVICE_DEVICE_MEM_CAPABILITIES_INTEL                 0x4191
+#define CL_DEVICE_SINGLE_DEVICE_SHARED_MEM_CAPABILITIES_INTEL   0x4192
+#define CL_DEVICE_CROSS_DEVICE_SHARED_MEM_CAPABILITIES_INTEL    0x4193
+#define CL_DEVICE_SHARED_SYSTEM_MEM_CAPABILITIES_INTEL          0x4194
+
+/* cl_device_unified_shared_memory_capabilities_intel - bitfield */
+#define CL_UNIFIED_SHARED_MEMORY_ACCESS_INTEL                   (1 << 0)
+#define CL_UNIFIED_SHARED_MEMORY_ATOMIC_ACCESS_INTEL            (1 << 1)
+#define CL_UNIFIED_SHARED_MEMORY_CONCURRENT_ACCESS_INTEL        (1 << 2)
+#define CL_UNIFIED_SHARED_MEMORY_CONCURRENT_ATOMIC_ACCESS_INTEL (1 << 3)
+
+/* cl_mem_properties_intel */
+#define CL_MEM_ALLOC_FLAGS_INTEL                                0x4195
+
+/* cl_mem_alloc_flags_intel - bitfield */
+#define CL_MEM_ALLOC_WRITE_COMBINED_INTEL                       (1 << 0)
+#define CL_MEM_ALLOC_INITIAL_PLACEMENT_DEVICE_INTEL             (1 << 1)
+#define CL_MEM_ALLOC_INITIAL_PLACEMENT_HOST_INTEL               (1 << 2)
+
+/* cl_mem_alloc_info_intel */
+#define CL_MEM_ALLOC_TYPE_INTEL                                 0x419A
+#define CL_MEM_ALLOC_BASE_PTR_INTEL                             0x419B
+#define CL_MEM_ALLOC_SIZE_INTEL                                 0x419C
+#define CL_MEM_ALLOC_DEVICE_INTEL                               0x419D
+
+/* cl_unified_shared_memory_type_intel */
+#define CL_MEM_TYPE_UNKNOWN_INTEL                               0x4196
+#define CL_MEM_TYPE_HOST_INTEL                                  0x4197
+#define CL_MEM_TYPE_DEVICE_INTEL                                0x4198
+#define CL_MEM_TYPE_SHARED_INTEL                                0x4199
+
+/* cl_kernel_exec_info */
+#define CL_KERNEL_EXEC_INFO_INDIRECT_HOST_ACCESS_INTEL          0x4200
+#define CL_KERNEL_EXEC_INFO_INDIRECT_DEVICE_ACCESS_INTEL        0x4201
+#define CL_KERNEL_EXEC_INFO_INDIRECT_SHARED_ACCESS_INTEL        0x4202
+#define CL_KERNEL_EXEC_INFO_USM_PTRS_INTEL                      0x4203
+
+/* cl_command_type */
+#define CL_COMMAND_MEMFILL_INTEL                                0x4204
+#define CL_COMMAND_MEMCPY_INTEL                                 0x4205
+#define CL_COMMAND_MIGRATEMEM_INTEL                             0x4206
+#define CL_COMMAND_MEMADVISE_INTEL                              0x4207
+
+extern CL_API_ENTRY void * CL_API_CALL
+clHostMemAllocINTEL(cl_context                      /* context */,
+                    const cl_mem_properties_intel * /* properties */,
+                    size_t                          /* size */,
+                    cl_uint                         /* alignment */,
+                    cl_int *                        /* errcode_ret */) CL_EXT_SUFFIX__VERSION_1_2;
+
+typedef CL_API_ENTRY void * (CL_API_CALL *clHostMemAllocINTEL_fn)(cl_context                      /* context */,
+                                                                  const cl_mem_properties_intel * /* properties */,
+                                                                  size_t                          /* size */,
+                                                                  cl_uint                         /* alignment */,
+                                                                  cl_int *                        /* errcode_ret */) CL_EXT_SUFFIX__VERSION_1_2;
+
+extern CL_API_ENTRY void * CL_API_CALL
+clDeviceMemAllocINTEL(cl_context                      /* context */,
+                      cl_device_id                    /* device */,
+                      const cl_mem_properties_intel * /* properties */,
+                      size_t                          /* size */,
+                      cl_uint                         /* alignment */,
+                      cl_int *                        /* errcode_ret */) CL_EXT_SUFFIX__VERSION_1_2;
+
+typedef CL_API_ENTRY void * (CL_API_CALL *clDeviceMemAllocINTEL_fn)(cl_context                      /* context */,
+                                                                    cl_device_id                    /* device */,
+                                                                    const cl_mem_properties_intel * /* properties */,
+                                                                    size_t                          /* size */,
+                                                                    cl_uint                         /* alignment */,
+                                                                    cl_int *                        /* errcode_ret */) CL_EXT_SUFFIX__VERSION_1_2;
+
+extern CL_API_ENTRY void * CL_API_CALL
+clSharedMemAllocINTEL(cl_context                      /* context */,
+                      cl_device_id                    /* device */,
+                      const cl_mem_properties_intel * /* properties */,
+                      size_t                          /* size */,
+                      cl_uint                         /* alignment */,
+                      cl_int *                        /* errcode_ret */) CL_EXT_SUFFIX__VERSION_1_2;
+
+typedef CL_API_ENTRY void * (CL_API_CALL *clSharedMemAllocINTEL_fn)(cl_context                      /* context */,
+                                                                    cl_device_id                    /* device */,
+                                                                    const cl_mem_properties_intel * /* properties */,
+                                                                    size_t                          /* size */,
+                                                                    cl_uint                         /* alignment */,
+                                                                    cl_int *                        /* errcode_ret */) CL_EXT_SUFFIX__VERSION_1_2;
+
+extern CL_API_ENTRY cl_int CL_API_CALL
+clMemFreeINTEL(cl_context /* context */,
+               void *     /* ptr */) CL_EXT_SUFFIX__VERSION_1_2;
+
+typedef CL_API_ENTRY cl_int (CL_API_CALL *clMemFreeINTEL_fn)(cl_context /* context */,
+                                                             void *     /* ptr */) CL_EXT_SUFFIX__VERSION_1_2;
+
+extern CL_API_ENTRY cl_int CL_API_CALL
+clMemBlockingFreeINTEL(cl_context /* context */,
+                       void *     /* ptr */) CL_EXT_SUFFIX__VERSION_1_2;
+
+typedef CL_API_ENTRY cl_int (CL_API_CALL *clMemBlockingFreeINTEL_fn)(cl_context /* context */,
+                                                                     void *     /* ptr */) CL_EXT_SUFFIX__VERSION_1_2;
+
+extern CL_API_ENTRY cl_int CL_API_CALL
+clGetMemAllocInfoINTEL(cl_context        /* context */,
+                       const void *      /* ptr */,
+                       cl_mem_info_intel /* param_name */,
+                       size_t            /* param_value_size */,
+                       void *            /* param_value */,
+                       size_t *          /* param_value_size_ret */) CL_EXT_SUFFIX__VERSION_1_2;
+
+typedef CL_API_ENTRY cl_int (CL_API_CALL *clGetMemAllocInfoINTEL_fn)(cl_context        /* context */,
+                                                                     const void *      /* ptr */,
+                                                                     cl_mem_info_intel /* param_name */,
+                                                                     size_t            /* param_value_size */,
+                                                                     void *            /* param_value */,
+                                                                     size_t *          /* param_value_size_ret */) CL_EXT_SUFFIX__VERSION_1_2;
+
+extern CL_API_ENTRY cl_int CL_API_CALL
+clSetKernelArgMemPointerINTEL(cl_kernel    /* kernel */,
+                              cl_uint      /* arg_index */,
+                              const void * /* arg_value */) CL_EXT_SUFFIX__VERSION_1_2;
+
+typedef CL_API_ENTRY cl_int (CL_API_CALL *clSetKernelArgMemPointerINTEL_fn)(cl_kernel    /* kernel */,
+                                                                            cl_uint      /* arg_index */,
+                                                                            const void * /* arg_value */) CL_EXT_SUFFIX__VERSION_1_2;
+
+extern CL_API_ENTRY cl_int CL_API_CALL
+clEnqueueMemsetINTEL(cl_command_queue /* command_queue */,
+                     void *           /* dst_ptr */,
+                     cl_int           /* value */,
+                     size_t           /* size */,
+                     cl_uint          /* num_events_in_wait_list */,
+                     const cl_event * /* event_wait_list */,
+                     cl_event *       /* event */) CL_EXT_SUFFIX__VERSION_1_2;
+
+typedef CL_API_ENTRY cl_int (CL_API_CALL *clEnqueueMemsetINTEL_fn)(cl_command_queue /* command_queue */,
+                                                                   void *           /* dst_ptr */,
+                                                                   cl_int           /* value */,
+                                                                   size_t           /* size */,
+                                                                   cl_uint          /* num_events_in_wait_list */,
+                                                                   const cl_event * /* event_wait_list */,
+                                                                   cl_event *       /* event */) CL_EXT_SUFFIX__VERSION_1_2;
+
+extern CL_API_ENTRY cl_int CL_API_CALL
+clEnqueueMemFillINTEL(cl_command_queue /* command_queue */,
+                      void *           /* dst_ptr */,
+                      const void *     /* pattern */,
+                      size_t           /* pattern_size */,
+                      size_t           /* size */,
+                      cl_uint          /* num_events_in_wait_list */,
+                      const cl_event * /* event_wait_list */,
+                      cl_event *       /* event */) CL_EXT_SUFFIX__VERSION_1_2;
+
+typedef CL_API_ENTRY cl_int (CL_API_CALL *clEnqueueMemFillINTEL_fn)(cl_command_queue /* command_queue */,
+                                                                    void *           /* dst_ptr */,
+                                                                    const void *     /* pattern */,
+                                                                    size_t           /* pattern_size */,
+                                                                    size_t           /* size */,
+                                                                    cl_uint          /* num_events_in_wait_list */,
+                                                                    const cl_event * /* event_wait_list */,
+                                                                    cl_event *       /* event */) CL_EXT_SUFFIX__VERSION_1_2;
+
+extern CL_API_ENTRY cl_int CL_API_CALL
+clEnqueueMemcpyINTEL(cl_command_queue /* command_queue */,
+                     cl_bool          /* blocking */,
+                     void *           /* dst_ptr */,
+                     const void *     /* src_ptr */,
+                     size_t           /* size */,
+                     cl_uint          /* num_events_in_wait_list */,
+                     const cl_event * /* event_wait_list */,
+                     cl_event *       /* event */) CL_EXT_SUFFIX__VERSION_1_2;
+
+typedef CL_API_ENTRY cl_int (CL_API_CALL *clEnqueueMemcpyINTEL_fn)(cl_command_queue /* command_queue */,
+                                                                   cl_bool          /* blocking */,
+                                                                   void *           /* dst_ptr */,
+                                                                   const void *     /* src_ptr */,
+                                                                   size_t           /* size */,
+                                                                   cl_uint          /* num_events_in_wait_list */,
+                                                                   const cl_event * /* event_wait_list */,
+                                                                   cl_event *       /* event */) CL_EXT_SUFFIX__VERSION_1_2;
+
+extern CL_API_ENTRY cl_int CL_API_CALL
+clEnqueueMigrateMemINTEL(cl_command_queue       /* command_queue */,
+                         const void *           /* ptr */,
+                         size_t                 /* size */,
+                         cl_mem_migration_flags /* flags */,
+                         cl_uint                /* num_events_in_wait_list */,
+                         const cl_event *       /* event_wait_list */,
+                         cl_event *             /* event */) CL_EXT_SUFFIX__VERSION_1_2;
+
+typedef CL_API_ENTRY cl_int (CL_API_CALL *clEnqueueMigrateMemINTEL_fn)(cl_command_queue       /* command_queue */,
+                                                                       const void *           /* ptr */,
+                                                                       size_t                 /* size */,
+                                                                       cl_mem_migration_flags /* flags */,
+                                                                       cl_uint                /* num_events_in_wait_list */,
+                                                                       const cl_event *       /* event_wait_list */,
+                                                                       cl_event *             /* event */) CL_EXT_SUFFIX__VERSION_1_2;
+
+extern CL_API_ENTRY cl_int CL_API_CALL
+clEnqueueMemAdviseINTEL(cl_command_queue    /* command_queue */,
+                        const void *        /* ptr */,
+                        size_t              /* size */,
+                        cl_mem_advice_intel /* advice */,
+                        cl_uint             /* num_events_in_wait_list */,
+                        const cl_event *    /* event_wait_list */,
+                        cl_event *          /* event */) CL_EXT_SUFFIX__VERSION_1_2;
+
+typedef CL_API_ENTRY cl_int (CL_API_CALL *clEnqueueMemAdviseINTEL_fn)(cl_command_queue    /* command_queue */,
+                                                                      const void *        /* ptr */,
+                                                                      size_t              /* size */,
+                                                                      cl_mem_advice_intel /* advice */,
+                                                                      cl_uint             /* num_events_in_wait_list */,
+                                                                      const cl_event *    /* event_wait_list */,
+                                                                      cl_event *          /* event */) CL_EXT_SUFFIX__VERSION_1_2;
+
 /******************************************
 * cl_nv_device_attribute_query extension *
 ******************************************/
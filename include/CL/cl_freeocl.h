@@ -0,0 +1,362 @@
+/*
+	FreeOCL - a free OpenCL implementation for CPU
+	Copyright (C) 2011  Roland Brochard
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#ifndef __CL_FREEOCL_H
+#define __CL_FREEOCL_H
+
+/* cl_freeocl.h contains the FreeOCL specific OpenCL extensions. Enums use */
+/* the 0x4F00 - 0x4FFF range.                                               */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <CL/cl.h>
+
+/*************************************
+* cl_freeocl_native_ndrange extension *
+*************************************/
+#define cl_freeocl_native_ndrange 1
+
+/* cl_command_type */
+#define CL_COMMAND_NDRANGE_NATIVE_KERNEL_FREEOCL    0x4F00
+
+/* Description of the work-group passed to each call of the native function */
+typedef struct _cl_native_work_group_freeocl
+{
+    cl_uint work_dim;
+    size_t  group_id[3];
+    size_t  num_groups[3];
+    size_t  global_offset[3];   /* global id of the first work-item of the group */
+    size_t  local_size[3];      /* actual size of this work-group */
+} cl_native_work_group_freeocl;
+
+typedef void (CL_CALLBACK *cl_native_ndrange_func_freeocl)(void *                               /* args */,
+                                                            const cl_native_work_group_freeocl * /* work_group */);
+
+extern CL_API_ENTRY cl_int CL_API_CALL
+clEnqueueNDRangeNativeKernelFREEOCL(cl_command_queue               /* command_queue */,
+                                    cl_native_ndrange_func_freeocl /* user_func */,
+                                    void *                         /* args */,
+                                    size_t                         /* cb_args */,
+                                    cl_uint                        /* num_mem_objects */,
+                                    const cl_mem *                 /* mem_list */,
+                                    const void **                  /* args_mem_loc */,
+                                    cl_uint                        /* work_dim */,
+                                    const size_t *                 /* global_work_offset */,
+                                    const size_t *                 /* global_work_size */,
+                                    const size_t *                 /* local_work_size */,
+                                    cl_uint                        /* num_events_in_wait_list */,
+                                    const cl_event *               /* event_wait_list */,
+                                    cl_event *                     /* event */) CL_API_SUFFIX__VERSION_1_2;
+
+typedef CL_API_ENTRY cl_int (CL_API_CALL *clEnqueueNDRangeNativeKernelFREEOCL_fn)(cl_command_queue               /* command_queue */,
+                                                                                  cl_native_ndrange_func_freeocl /* user_func */,
+                                                                                  void *                         /* args */,
+                                                                                  size_t                         /* cb_args */,
+                                                                                  cl_uint                        /* num_mem_objects */,
+                                                                                  const cl_mem *                 /* mem_list */,
+                                                                                  const void **                  /* args_mem_loc */,
+                                                                                  cl_uint                        /* work_dim */,
+                                                                                  const size_t *                 /* global_work_offset */,
+                                                                                  const size_t *                 /* global_work_size */,
+                                                                                  const size_t *                 /* local_work_size */,
+                                                                                  cl_uint                        /* num_events_in_wait_list */,
+                                                                                  const cl_event *               /* event_wait_list */,
+                                                                                  cl_event *                     /* event */) CL_API_SUFFIX__VERSION_1_2;
+
+/******************************
+* cl_freeocl_file_io extension *
+******************************/
+#define cl_freeocl_file_io 1
+
+/* cl_command_type */
+#define CL_COMMAND_READ_FILE_FREEOCL                0x4F01
+#define CL_COMMAND_WRITE_FILE_FREEOCL               0x4F02
+
+/* Error code */
+#define CL_FILE_IO_ERROR_FREEOCL                    -20224
+
+extern CL_API_ENTRY cl_int CL_API_CALL
+clEnqueueReadFileFREEOCL(cl_command_queue /* command_queue */,
+                         cl_mem           /* buffer */,
+                         cl_bool          /* blocking */,
+                         size_t           /* offset */,
+                         size_t           /* cb */,
+                         int              /* fd */,
+                         cl_ulong         /* file_offset */,
+                         cl_uint          /* num_events_in_wait_list */,
+                         const cl_event * /* event_wait_list */,
+                         cl_event *       /* event */) CL_API_SUFFIX__VERSION_1_2;
+
+typedef CL_API_ENTRY cl_int (CL_API_CALL *clEnqueueReadFileFREEOCL_fn)(cl_command_queue /* command_queue */,
+                                                                       cl_mem           /* buffer */,
+                                                                       cl_bool          /* blocking */,
+                                                                       size_t           /* offset */,
+                                                                       size_t           /* cb */,
+                                                                       int              /* fd */,
+                                                                       cl_ulong         /* file_offset */,
+                                                                       cl_uint          /* num_events_in_wait_list */,
+                                                                       const cl_event * /* event_wait_list */,
+                                                                       cl_event *       /* event */) CL_API_SUFFIX__VERSION_1_2;
+
+extern CL_API_ENTRY cl_int CL_API_CALL
+clEnqueueWriteFileFREEOCL(cl_command_queue /* command_queue */,
+                          cl_mem           /* buffer */,
+                          cl_bool          /* blocking */,
+                          size_t           /* offset */,
+                          size_t           /* cb */,
+                          int              /* fd */,
+                          cl_ulong         /* file_offset */,
+                          cl_uint          /* num_events_in_wait_list */,
+                          const cl_event * /* event_wait_list */,
+                          cl_event *       /* event */) CL_API_SUFFIX__VERSION_1_2;
+
+typedef CL_API_ENTRY cl_int (CL_API_CALL *clEnqueueWriteFileFREEOCL_fn)(cl_command_queue /* command_queue */,
+                                                                        cl_mem           /* buffer */,
+                                                                        cl_bool          /* blocking */,
+                                                                        size_t           /* offset */,
+                                                                        size_t           /* cb */,
+                                                                        int              /* fd */,
+                                                                        cl_ulong         /* file_offset */,
+                                                                        cl_uint          /* num_events_in_wait_list */,
+                                                                        const cl_event * /* event_wait_list */,
+                                                                        cl_event *       /* event */) CL_API_SUFFIX__VERSION_1_2;
+
+/***************************
+* cl_freeocl_pipe extension *
+***************************/
+#define cl_freeocl_pipe 1
+
+/* cl_mem_object_type */
+#define CL_MEM_OBJECT_PIPE_FREEOCL                  0x4F03
+
+/* cl_pipe_info_freeocl */
+typedef cl_uint cl_pipe_info_freeocl;
+#define CL_PIPE_PACKET_SIZE_FREEOCL                 0x4F04
+#define CL_PIPE_MAX_PACKETS_FREEOCL                 0x4F05
+
+/* Error code */
+#define CL_INVALID_PIPE_SIZE_FREEOCL                -20225
+
+extern CL_API_ENTRY cl_mem CL_API_CALL
+clCreatePipeFREEOCL(cl_context           /* context */,
+                    cl_mem_flags         /* flags */,
+                    cl_uint              /* pipe_packet_size */,
+                    cl_uint              /* pipe_max_packets */,
+                    const cl_mem_flags * /* properties */,
+                    cl_int *             /* errcode_ret */) CL_API_SUFFIX__VERSION_1_2;
+
+typedef CL_API_ENTRY cl_mem (CL_API_CALL *clCreatePipeFREEOCL_fn)(cl_context           /* context */,
+                                                                  cl_mem_flags         /* flags */,
+                                                                  cl_uint              /* pipe_packet_size */,
+                                                                  cl_uint              /* pipe_max_packets */,
+                                                                  const cl_mem_flags * /* properties */,
+                                                                  cl_int *             /* errcode_ret */) CL_API_SUFFIX__VERSION_1_2;
+
+extern CL_API_ENTRY cl_int CL_API_CALL
+clGetPipeInfoFREEOCL(cl_mem               /* pipe */,
+                     cl_pipe_info_freeocl /* param_name */,
+                     size_t               /* param_value_size */,
+                     void *               /* param_value */,
+                     size_t *             /* param_value_size_ret */) CL_API_SUFFIX__VERSION_1_2;
+
+typedef CL_API_ENTRY cl_int (CL_API_CALL *clGetPipeInfoFREEOCL_fn)(cl_mem               /* pipe */,
+                                                                   cl_pipe_info_freeocl /* param_name */,
+                                                                   size_t               /* param_value_size */,
+                                                                   void *               /* param_value */,
+                                                                   size_t *             /* param_value_size_ret */) CL_API_SUFFIX__VERSION_1_2;
+
+/*********************************
+* cl_freeocl_huge_pages extension *
+*********************************/
+#define cl_freeocl_huge_pages 1
+
+/* cl_mem_flags - FreeOCL extensions use bits 32 to 49 */
+#define CL_MEM_HUGE_PAGES_1GB_FREEOCL               (((cl_mem_flags)1) << 32)
+
+/***************************
+* cl_freeocl_numa extension *
+***************************/
+#define cl_freeocl_numa 1
+
+/* cl_mem_flags */
+#define CL_MEM_NUMA_INTERLEAVE_FREEOCL              (((cl_mem_flags)1) << 33)
+#define CL_MEM_NUMA_FIRST_TOUCH_FREEOCL             (((cl_mem_flags)1) << 34)
+#define CL_MEM_NUMA_BIND_FREEOCL                    (((cl_mem_flags)1) << 35)
+/* Prefer NUMA node <node> (0 - 255), stored in bits 40 to 47 */
+#define CL_MEM_NUMA_NODE_FREEOCL(node)              (CL_MEM_NUMA_BIND_FREEOCL | ((((cl_mem_flags)(node)) & 0xFF) << 40))
+
+/**********************************
+* cl_freeocl_file_buffer extension *
+**********************************/
+#define cl_freeocl_file_buffer 1
+
+/* cl_mem_flags - access pattern hints of file buffers */
+#define CL_MEM_FILE_SEQUENTIAL_FREEOCL              (((cl_mem_flags)1) << 36)
+#define CL_MEM_FILE_RANDOM_FREEOCL                  (((cl_mem_flags)1) << 37)
+#define CL_MEM_FILE_WILLNEED_FREEOCL                (((cl_mem_flags)1) << 38)
+
+extern CL_API_ENTRY cl_mem CL_API_CALL
+clCreateBufferFromFileFREEOCL(cl_context   /* context */,
+                              cl_mem_flags /* flags */,
+                              int          /* fd */,
+                              cl_ulong     /* file_offset */,
+                              size_t       /* size */,
+                              cl_int *     /* errcode_ret */) CL_API_SUFFIX__VERSION_1_2;
+
+typedef CL_API_ENTRY cl_mem (CL_API_CALL *clCreateBufferFromFileFREEOCL_fn)(cl_context   /* context */,
+                                                                            cl_mem_flags /* flags */,
+                                                                            int          /* fd */,
+                                                                            cl_ulong     /* file_offset */,
+                                                                            size_t       /* size */,
+                                                                            cl_int *     /* errcode_ret */) CL_API_SUFFIX__VERSION_1_2;
+
+/***********************************
+* cl_freeocl_buffer_clone extension *
+***********************************/
+#define cl_freeocl_buffer_clone 1
+
+/* cl_mem_flags */
+#define CL_MEM_CLONEABLE_FREEOCL                    (((cl_mem_flags)1) << 39)
+
+/* cl_command_type */
+#define CL_COMMAND_CLONE_BUFFER_FREEOCL             0x4F06
+
+extern CL_API_ENTRY cl_mem CL_API_CALL
+clEnqueueCloneBufferFREEOCL(cl_command_queue /* command_queue */,
+                            cl_mem           /* buffer */,
+                            cl_mem_flags     /* flags */,
+                            cl_uint          /* num_events_in_wait_list */,
+                            const cl_event * /* event_wait_list */,
+                            cl_event *       /* event */,
+                            cl_int *         /* errcode_ret */) CL_API_SUFFIX__VERSION_1_2;
+
+typedef CL_API_ENTRY cl_mem (CL_API_CALL *clEnqueueCloneBufferFREEOCL_fn)(cl_command_queue /* command_queue */,
+                                                                          cl_mem           /* buffer */,
+                                                                          cl_mem_flags     /* flags */,
+                                                                          cl_uint          /* num_events_in_wait_list */,
+                                                                          const cl_event * /* event_wait_list */,
+                                                                          cl_event *       /* event */,
+                                                                          cl_int *         /* errcode_ret */) CL_API_SUFFIX__VERSION_1_2;
+
+/************************************
+* cl_freeocl_memory_stats extension *
+************************************/
+#define cl_freeocl_memory_stats 1
+
+/* cl_context_info */
+#define CL_CONTEXT_MEMORY_USAGE_FREEOCL             0x4F07
+#define CL_CONTEXT_MEMORY_PEAK_FREEOCL              0x4F08
+
+/* cl_context_properties and cl_context_info */
+#define CL_CONTEXT_MEMORY_BUDGET_FREEOCL            0x4F09
+
+/* cl_device_info */
+#define CL_DEVICE_MEMORY_USAGE_FREEOCL              0x4F0A
+#define CL_DEVICE_MEMORY_PEAK_FREEOCL               0x4F0B
+#define CL_DEVICE_MEMORY_BUDGET_FREEOCL             0x4F0C
+
+/* Indices of the cl_ulong arrays returned for CL_CONTEXT_MEMORY_USAGE_FREEOCL */
+/* and CL_DEVICE_MEMORY_USAGE_FREEOCL                                         */
+#define CL_MEMORY_KIND_BUFFERS_FREEOCL              0
+#define CL_MEMORY_KIND_IMAGES_FREEOCL               1
+#define CL_MEMORY_KIND_PIPES_FREEOCL                2
+#define CL_MEMORY_KIND_BUFFER_CACHE_FREEOCL         3
+#define CL_MEMORY_KIND_PROGRAMS_FREEOCL             4
+#define CL_MEMORY_KIND_STACKS_FREEOCL               5
+#define CL_MEMORY_KIND_FILE_MAPPINGS_FREEOCL        6
+#define CL_MEMORY_KIND_USM_FREEOCL                  7
+#define CL_MEMORY_KIND_KERNEL_ARGS_FREEOCL          8
+#define CL_MEMORY_KIND_COUNT_FREEOCL                9
+
+/*************************************
+* cl_freeocl_shared_buffer extension *
+*************************************/
+#define cl_freeocl_shared_buffer 1
+
+/* cl_mem_flags */
+#define CL_MEM_SHAREABLE_FREEOCL                    (((cl_mem_flags)1) << 48)
+
+/* cl_mem_info */
+#define CL_MEM_FENCE_VALUE_FREEOCL                  0x4F0D
+
+/* cl_command_type */
+#define CL_COMMAND_SIGNAL_FENCE_FREEOCL             0x4F0E
+#define CL_COMMAND_WAIT_FENCE_FREEOCL               0x4F0F
+
+extern CL_API_ENTRY cl_int CL_API_CALL
+clExportBufferFREEOCL(cl_mem /* buffer */,
+                      int *  /* fd */) CL_API_SUFFIX__VERSION_1_2;
+
+typedef CL_API_ENTRY cl_int (CL_API_CALL *clExportBufferFREEOCL_fn)(cl_mem /* buffer */,
+                                                                    int *  /* fd */) CL_API_SUFFIX__VERSION_1_2;
+
+extern CL_API_ENTRY cl_mem CL_API_CALL
+clImportBufferFREEOCL(cl_context   /* context */,
+                      cl_mem_flags /* flags */,
+                      int          /* fd */,
+                      cl_int *     /* errcode_ret */) CL_API_SUFFIX__VERSION_1_2;
+
+typedef CL_API_ENTRY cl_mem (CL_API_CALL *clImportBufferFREEOCL_fn)(cl_context   /* context */,
+                                                                    cl_mem_flags /* flags */,
+                                                                    int          /* fd */,
+                                                                    cl_int *     /* errcode_ret */) CL_API_SUFFIX__VERSION_1_2;
+
+extern CL_API_ENTRY cl_int CL_API_CALL
+clEnqueueSignalFenceFREEOCL(cl_command_queue /* command_queue */,
+                            cl_mem           /* buffer */,
+                            cl_uint          /* value */,
+                            cl_uint          /* num_events_in_wait_list */,
+                            const cl_event * /* event_wait_list */,
+                            cl_event *       /* event */) CL_API_SUFFIX__VERSION_1_2;
+
+typedef CL_API_ENTRY cl_int (CL_API_CALL *clEnqueueSignalFenceFREEOCL_fn)(cl_command_queue /* command_queue */,
+                                                                          cl_mem           /* buffer */,
+                                                                          cl_uint          /* value */,
+                                                                          cl_uint          /* num_events_in_wait_list */,
+                                                                          const cl_event * /* event_wait_list */,
+                                                                          cl_event *       /* event */) CL_API_SUFFIX__VERSION_1_2;
+
+extern CL_API_ENTRY cl_int CL_API_CALL
+clEnqueueWaitFenceFREEOCL(cl_command_queue /* command_queue */,
+                          cl_mem           /* buffer */,
+                          cl_uint          /* value */,
+                          cl_uint          /* num_events_in_wait_list */,
+                          const cl_event * /* event_wait_list */,
+                          cl_event *       /* event */) CL_API_SUFFIX__VERSION_1_2;
+
+typedef CL_API_ENTRY cl_int (CL_API_CALL *clEnqueueWaitFenceFREEOCL_fn)(cl_command_queue /* command_queue */,
+                                                                        cl_mem           /* buffer */,
+                                                                        cl_uint          /* value */,
+                                                                        cl_uint          /* num_events_in_wait_list */,
+                                                                        const cl_event * /* event_wait_list */,
+                                                                        cl_event *       /* event */) CL_API_SUFFIX__VERSION_1_2;
+
+/************************************
+* cl_freeocl_tiled_images extension *
+************************************/
+#define cl_freeocl_tiled_images 1
+
+/* cl_mem_flags */
+#define CL_MEM_TILED_FREEOCL                        (((cl_mem_flags)1) << 49)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CL_FREEOCL_H */
@@ -26,6 +26,7 @@ struct image2d_array_t
 	__size_t row_pitch, slice_pitch;
 	__size_t element_size;
 	void *data;
+	const __image_access *access;	// set by __FCL_init
 };
 
 static inline __int2 __address_mode(const image2d_array_t &image, const sampler_t sampler, const __int2 &coord)
@@ -43,100 +44,32 @@ static inline __int2 __address_mode(const image2d_array_t &image, const sampler_
 		__coord = clamp(coord, __int2::make(-1), __int2::make(image.width, image.height));
 		break;
 	case CLK_ADDRESS_REPEAT:
-		__coord = coord % __int2::make(image.width, image.height);
+		__coord = __int2::make(__repeat(coord.get<0>(), image.width),
+							   __repeat(coord.get<1>(), image.height));
 		break;
 	case CLK_ADDRESS_MIRRORED_REPEAT:
-		__coord = coord % __int2::make(image.width << 1, image.height << 1);
-		__coord = convert_int2(abs(__coord - __int2::make(image.width, image.height)));
+		__coord = __int2::make(__mirror(coord.get<0>(), image.width),
+							   __mirror(coord.get<1>(), image.height));
 		break;
 	}
 	return __coord;
 }
 
+// Texel at a coordinate returned by __address_mode in a clamped layer
+static inline const __char *__sampled_texel(const image2d_array_t &image, const __int x, const __int y, const __int layer)
+{
+	if (__uint(x) >= image.width || __uint(y) >= image.height)
+		return __border_texel;
+	return (const __char*)image.data + x * image.element_size + y * image.row_pitch + layer * image.slice_pitch;
+}
+
 static inline __float4 read_imagef(const image2d_array_t &image, sampler_t sampler, const __int4 &coord)
 {
 	const __int2 __coord = __address_mode(image, sampler, __int2::make(coord.get<0>(), coord.get<1>()));
     const __int layer = clamp(coord.get<2>(), 0, int(image.array_size) - 1);
 
-	const __char * const ptr = (const __char*)image.data
-							 + __coord.get<0>() * image.element_size
-							 + __coord.get<1>() * image.row_pitch
-							 + layer * image.slice_pitch;
-	__size_t nb_chan;
-	switch(image.channel_order)
-	{
-	case CLK_R:			nb_chan = 1;	break;
-	case CLK_A:			nb_chan = 1;	break;
-	case CLK_INTENSITY:	nb_chan = 1;	break;
-	case CLK_LUMINANCE:	nb_chan = 1;	break;
-	case CLK_Rx:		nb_chan = 1;	break;
-
-	case CLK_RG:		nb_chan = 2;	break;
-	case CLK_RA:		nb_chan = 2;	break;
-	case CLK_RGx:		nb_chan = 2;	break;
-
-	case CLK_RGB:		nb_chan = 3;	break;
-	case CLK_RGBx:		nb_chan = 3;	break;
-
-	case CLK_RGBA:		nb_chan = 4;	break;
-	case CLK_BGRA:		nb_chan = 4;	break;
-	case CLK_ARGB:		nb_chan = 4;	break;
-	}
-
-	__float4 v;
-	switch(image.channel_data_type)
-	{
-	case CLK_UNORM_INT8:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			v.v[i] = ((const __uchar*)ptr)[i] * (1.0f / 255.0f);
-		break;
-	case CLK_UNORM_INT16:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			v.v[i] = ((const __ushort*)ptr)[i] * (1.0f / 65535.0f);
-		break;
-	case CLK_UNORM_SHORT_555:
-		{
-			const __uint s = *(const __ushort*)ptr;
-			v.get<0>() = ((s >> 10) & 31U) * (1.0f / 31.0f);
-			v.get<1>() = ((s >> 5) & 31U) * (1.0f / 31.0f);
-			v.get<2>() = (s & 31U) * (1.0f / 31.0f);
-		}
-		break;
-	case CLK_UNORM_SHORT_565:
-		{
-			const __uint s = *(const __ushort*)ptr;
-			v.get<0>() = ((s >> 11) & 31U) * (1.0f / 31.0f);
-			v.get<1>() = ((s >> 5) & 63U) * (1.0f / 63.0f);
-			v.get<2>() = (s & 31U) * (1.0f / 31.0f);
-		}
-		break;
-	case CLK_UNORM_INT_101010:
-		{
-			const __uint s = *(const __uint*)ptr;
-			v.get<0>() = ((s >> 20) & 1023U) * (1.0f / 1023.0f);
-			v.get<1>() = ((s >> 10) & 1023U) * (1.0f / 1023.0f);
-			v.get<2>() = (s & 1023U) * (1.0f / 1023.0f);
-		}
-		break;
-	case CLK_SNORM_INT8:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			v.v[i] = ((const __char*)ptr)[i] * (1.0f / 127.0f);
-		break;
-	case CLK_SNORM_INT16:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			v.v[i] = ((const __short*)ptr)[i] * (1.0f / 32767.0f);
-		break;
-	case CLK_HALF_FLOAT:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			v.v[i] = ((const __half*)ptr)[i];
-		break;
-	case CLK_FLOAT:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			v.v[i] = ((const float*)ptr)[i];
-		break;
-	}
-
-	return __map_channels_for_reading(image, v);
+	const __char * const ptr = __sampled_texel(image, __coord.get<0>(), __coord.get<1>(), layer);
+	return __read_texelf(image, ptr);
 }
 static inline __float4 read_imagef(const image2d_array_t &image, sampler_t sampler, const __float4 &coord)
 {
@@ -146,15 +79,17 @@ static inline __float4 read_imagef(const image2d_array_t &image, sampler_t sampl
 	rcoord.get<2>() = floor(0.5f + rcoord.get<2>());
 	if (!(sampler & CLK_FILTER_LINEAR))
 		return read_imagef(image, sampler, convert_int4(rcoord));
-	const __int4 c0 = convert_int4(rcoord - __float4::make(0.5f, 0.5f, 0.0f, 0.f));
-	const __float4 dp = rcoord - convert_float4(c0);
-	__float4 v0 = read_imagef(image, sampler, c0);
-	__float4 v1 = read_imagef(image, sampler, c0 + __int4::make(1,0,0,0));
-	v0 += dp.get<0>() * (v1 - v0);
-	v1 = read_imagef(image, sampler, c0 + __int4::make(0,1,0,0));
-	__float4 v2 = read_imagef(image, sampler, c0 + __int4::make(1,1,0,0));
-	v1 += dp.get<0>() * (v2 - v1);
-	return v0 + dp.get<1>() * (v1 - v0);
+	const __float2 p = __float2::make(rcoord.get<0>() - 0.5f, rcoord.get<1>() - 0.5f);
+	const __float2 f = floor(p);
+	const __int2 c0 = __address_mode(image, sampler, convert_int2(f));
+	const __int2 c1 = __address_mode(image, sampler, convert_int2(f) + __int2::make(1));
+	const __int layer = clamp(convert_int(rcoord.get<2>()), 0, int(image.array_size) - 1);
+	return __filter_texelsf(image,
+							__sampled_texel(image, c0.get<0>(), c0.get<1>(), layer),
+							__sampled_texel(image, c1.get<0>(), c0.get<1>(), layer),
+							__sampled_texel(image, c0.get<0>(), c1.get<1>(), layer),
+							__sampled_texel(image, c1.get<0>(), c1.get<1>(), layer),
+							p - f);
 }
 static inline __float4 read_imagef(const image2d_array_t &image, const __int4 &coord)
 {
@@ -166,49 +101,8 @@ static inline __int4 read_imagei(const image2d_array_t &image, sampler_t sampler
 	const __int2 __coord = __address_mode(image, sampler, __int2::make(coord.get<0>(), coord.get<1>()));
     const __int layer = clamp(coord.get<2>(), 0, int(image.array_size) - 1);
 
-	const __char * const ptr = (const __char*)image.data
-							 + __coord.get<0>() * image.element_size
-							 + __coord.get<1>() * image.row_pitch
-							 + layer * image.slice_pitch;
-	__size_t nb_chan;
-	switch(image.channel_order)
-	{
-	case CLK_R:			nb_chan = 1;	break;
-	case CLK_A:			nb_chan = 1;	break;
-	case CLK_INTENSITY:	nb_chan = 1;	break;
-	case CLK_LUMINANCE:	nb_chan = 1;	break;
-	case CLK_Rx:		nb_chan = 1;	break;
-
-	case CLK_RG:		nb_chan = 2;	break;
-	case CLK_RA:		nb_chan = 2;	break;
-	case CLK_RGx:		nb_chan = 2;	break;
-
-	case CLK_RGB:		nb_chan = 3;	break;
-	case CLK_RGBx:		nb_chan = 3;	break;
-
-	case CLK_RGBA:		nb_chan = 4;	break;
-	case CLK_BGRA:		nb_chan = 4;	break;
-	case CLK_ARGB:		nb_chan = 4;	break;
-	}
-
-	__int4 v;
-	switch(image.channel_data_type)
-	{
-	case CLK_SIGNED_INT8:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			v.v[i] = ((const __char*)ptr)[i];
-		break;
-	case CLK_SIGNED_INT16:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			v.v[i] = ((const __short*)ptr)[i];
-		break;
-	case CLK_SIGNED_INT32:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			v.v[i] = ((const __int*)ptr)[i];
-		break;
-	}
-
-	return __map_channels_for_reading(image, v);
+	const __char * const ptr = __sampled_texel(image, __coord.get<0>(), __coord.get<1>(), layer);
+	return __read_texeli(image, ptr);
 }
 static inline __int4 read_imagei(const image2d_array_t &image, sampler_t sampler, const __float4 &coord)
 {
@@ -233,49 +127,8 @@ static inline __uint4 read_imageui(const image2d_array_t &image, sampler_t sampl
     const __int layer = clamp(coord.get<2>(), 0, int(image.array_size) - 1);
 
 
-	const __char * const ptr = (const __char*)image.data
-							 + __coord.get<0>() * image.element_size
-							 + __coord.get<1>() * image.row_pitch
-							 + layer * image.slice_pitch;
-	__size_t nb_chan;
-	switch(image.channel_order)
-	{
-	case CLK_R:			nb_chan = 1;	break;
-	case CLK_A:			nb_chan = 1;	break;
-	case CLK_INTENSITY:	nb_chan = 1;	break;
-	case CLK_LUMINANCE:	nb_chan = 1;	break;
-	case CLK_Rx:		nb_chan = 1;	break;
-
-	case CLK_RG:		nb_chan = 2;	break;
-	case CLK_RA:		nb_chan = 2;	break;
-	case CLK_RGx:		nb_chan = 2;	break;
-
-	case CLK_RGB:		nb_chan = 3;	break;
-	case CLK_RGBx:		nb_chan = 3;	break;
-
-	case CLK_RGBA:		nb_chan = 4;	break;
-	case CLK_BGRA:		nb_chan = 4;	break;
-	case CLK_ARGB:		nb_chan = 4;	break;
-	}
-
-	__uint4 v;
-	switch(image.channel_data_type)
-	{
-	case CLK_UNSIGNED_INT8:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			v.v[i] = ((const __uchar*)ptr)[i];
-		break;
-	case CLK_UNSIGNED_INT16:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			v.v[i] = ((const __ushort*)ptr)[i];
-		break;
-	case CLK_UNSIGNED_INT32:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			v.v[i] = ((const __uint*)ptr)[i];
-		break;
-	}
-
-	return __map_channels_for_reading(image, v);
+	const __char * const ptr = __sampled_texel(image, __coord.get<0>(), __coord.get<1>(), layer);
+	return __read_texelui(image, ptr);
 }
 static inline __uint4 read_imageui(const image2d_array_t &image, sampler_t sampler, const __float4 &coord)
 {
@@ -296,102 +149,27 @@ static inline __uint4 read_imageui(const image2d_array_t &image, const __int4 &c
 
 static inline void write_imagef(image2d_array_t &image, const __int4 &coord, const __float4 &color)
 {
-	__size_t nb_chan;
-	const __float4 v = __map_channels_for_writing(image, color, nb_chan);
 	__char *const ptr = (__char*)image.data
 					  + image.row_pitch * coord.get<1>()
 					  + coord.get<0>() * image.element_size
 					  + coord.get<2>() * image.slice_pitch;
-	switch(image.channel_data_type)
-	{
-	case CLK_SNORM_INT8:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			((__char*)ptr)[i] = clamp(v.v[i] * 127.0f, -127.0f, 127.0f);
-		break;
-	case CLK_SNORM_INT16:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			((__short*)ptr)[i] = clamp(v.v[i] * 32767.0f, -32767.0f, 32767.0f);
-		break;
-	case CLK_UNORM_INT8:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			((__uchar*)ptr)[i] = clamp(v.v[i] * 255.0f, 0.0f, 255.0f);
-		break;
-	case CLK_UNORM_INT16:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			((__ushort*)ptr)[i] = clamp(v.v[i] * 65535.0f, 0.0f, 65535.0f);
-		break;
-	case CLK_UNORM_SHORT_565:
-		*((__ushort*)ptr) = (((__uint)clamp(v.get<0>() * 31.0f, 0.0f, 31.0f)) << 11)
-						| (((__uint)clamp(v.get<1>() * 63.0f, 0.0f, 63.0f)) << 5)
-						| ((__uint)clamp(v.get<2>() * 31.0f, 0.0f, 31.0f));
-		break;
-	case CLK_UNORM_SHORT_555:
-		*((__ushort*)ptr) = (((__uint)clamp(v.get<0>() * 31.0f, 0.0f, 31.0f)) << 10)
-						| (((__uint)clamp(v.get<1>() * 31.0f, 0.0f, 31.0f)) << 5)
-						| ((__uint)clamp(v.get<2>() * 31.0f, 0.0f, 31.0f));
-		break;
-	case CLK_UNORM_INT_101010:
-		*((__uint*)ptr) = (((__uint)clamp(v.get<0>() * 1023.0f, 0.0f, 1023.0f)) << 20)
-						| (((__uint)clamp(v.get<1>() * 1023.0f, 0.0f, 1023.0f)) << 10)
-						| ((__uint)clamp(v.get<2>() * 1023.0f, 0.0f, 1023.0f));
-		break;
-	case CLK_HALF_FLOAT:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			((__half*)ptr)[i] = __half::from_float(v.v[i]);
-		break;
-	case CLK_FLOAT:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			((float*)ptr)[i] = v.v[i];
-		break;
-	}
+	__write_texelf(image, ptr, color);
 }
 static inline void write_imagei(image2d_array_t &image, const __int4 &coord, const __int4 &color)
 {
-	__size_t nb_chan;
-	const __int4 v = __map_channels_for_writing(image, color, nb_chan);
 	__char *const ptr = (__char*)image.data
 					  + image.row_pitch * coord.get<1>()
 					  + coord.get<0>() * image.element_size
 					  + coord.get<2>() * image.slice_pitch;
-	switch(image.channel_data_type)
-	{
-	case CLK_SIGNED_INT8:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			((__char*)ptr)[i] = clamp(v.v[i], -128, 127);
-		break;
-	case CLK_SIGNED_INT16:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			((__short*)ptr)[i] = clamp(v.v[i], -32768, 32767);
-		break;
-	case CLK_SIGNED_INT32:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			((__int*)ptr)[i] = v.v[i];
-		break;
-	}
+	__write_texeli(image, ptr, color);
 }
 static inline void write_imageui(image2d_array_t &image, const __int4 &coord, const __uint4 &color)
 {
-	__size_t nb_chan;
-	const __uint4 v = __map_channels_for_writing(image, color, nb_chan);
 	__char *const ptr = (__char*)image.data
 					  + image.row_pitch * coord.get<1>()
 					  + coord.get<0>() * image.element_size
 					  + coord.get<2>() * image.slice_pitch;
-	switch(image.channel_data_type)
-	{
-	case CLK_UNSIGNED_INT8:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			((__uchar*)ptr)[i] = clamp(v.v[i], 0, 255);
-		break;
-	case CLK_UNSIGNED_INT16:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			((__ushort*)ptr)[i] = clamp(v.v[i], 0, 65535);
-		break;
-	case CLK_SIGNED_INT32:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			((__uint*)ptr)[i] = v.v[i];
-		break;
-	}
+	__write_texelui(image, ptr, color);
 }
 
 static inline __int get_image_width(const image2d_array_t &image)	{	return image.width;	}
@@ -25,9 +25,23 @@ struct image2d_t
 	__size_t width, height;
 	__size_t row_pitch;
 	__size_t element_size;
+	__uint tile_shift_x, tile_shift_y;	// 0 unless the image is tiled
 	void *data;
+	const __image_access *access;	// set by __FCL_init
 };
 
+// Offset of a texel from image.data, see FreeOCL::image_layout
+static inline __size_t __texel_offset(const image2d_t &image, const __int x, const __int y)
+{
+	if (image.tile_shift_x == 0)
+		return x * image.element_size + y * image.row_pitch;
+	const __int mask_x = (1 << image.tile_shift_x) - 1;
+	const __int mask_y = (1 << image.tile_shift_y) - 1;
+	return (x >> image.tile_shift_x) * 4096
+			+ (y >> image.tile_shift_y) * image.row_pitch
+			+ ((((y & mask_y) << image.tile_shift_x) | (x & mask_x)) * image.element_size);
+}
+
 static inline __int2 __address_mode(const image2d_t &image, const sampler_t sampler, const __int2 &coord)
 {
 	__int2 __coord;
@@ -43,97 +57,32 @@ static inline __int2 __address_mode(const image2d_t &image, const sampler_t samp
 		__coord = clamp(coord, __int2::make(-1), __int2::make(image.width, image.height));
 		break;
 	case CLK_ADDRESS_REPEAT:
-		__coord = coord % __int2::make(image.width, image.height);
+		__coord = __int2::make(__repeat(coord.get<0>(), image.width),
+							   __repeat(coord.get<1>(), image.height));
 		break;
 	case CLK_ADDRESS_MIRRORED_REPEAT:
-		__coord = coord % __int2::make(image.width << 1, image.height << 1);
-		__coord = convert_int2(abs(__coord - __int2::make(image.width, image.height)));
+		__coord = __int2::make(__mirror(coord.get<0>(), image.width),
+							   __mirror(coord.get<1>(), image.height));
 		break;
 	}
 	return __coord;
 }
 
+// Texel at a coordinate returned by __address_mode
+static inline const __char *__sampled_texel(const image2d_t &image, const __int x, const __int y)
+{
+	if (__uint(x) >= image.width || __uint(y) >= image.height)
+		return __border_texel;
+	return (const __char*)image.data + __texel_offset(image, x, y);
+}
+
 // Built-in image read/write functions
 static inline __float4 read_imagef(const image2d_t &image, sampler_t sampler, const __int2 &coord)
 {
 	const __int2 __coord = __address_mode(image, sampler, coord);
 
-	const __char * const ptr = (const __char*)image.data + __coord.get<0>() * image.element_size + __coord.get<1>() * image.row_pitch;
-	__size_t nb_chan;
-	switch(image.channel_order)
-	{
-	case CLK_R:			nb_chan = 1;	break;
-	case CLK_A:			nb_chan = 1;	break;
-	case CLK_INTENSITY:	nb_chan = 1;	break;
-	case CLK_LUMINANCE:	nb_chan = 1;	break;
-	case CLK_Rx:		nb_chan = 1;	break;
-
-	case CLK_RG:		nb_chan = 2;	break;
-	case CLK_RA:		nb_chan = 2;	break;
-	case CLK_RGx:		nb_chan = 2;	break;
-
-	case CLK_RGB:		nb_chan = 3;	break;
-	case CLK_RGBx:		nb_chan = 3;	break;
-
-	case CLK_RGBA:		nb_chan = 4;	break;
-	case CLK_BGRA:		nb_chan = 4;	break;
-	case CLK_ARGB:		nb_chan = 4;	break;
-	}
-
-	__float4 v;
-	switch(image.channel_data_type)
-	{
-	case CLK_UNORM_INT8:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			v.v[i] = ((const __uchar*)ptr)[i] * (1.0f / 255.0f);
-		break;
-	case CLK_UNORM_INT16:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			v.v[i] = ((const __ushort*)ptr)[i] * (1.0f / 65535.0f);
-		break;
-	case CLK_UNORM_SHORT_555:
-		{
-			const __uint s = *(const __ushort*)ptr;
-			v.get<0>() = ((s >> 10) & 31U) * (1.0f / 31.0f);
-			v.get<1>() = ((s >> 5) & 31U) * (1.0f / 31.0f);
-			v.get<2>() = (s & 31U) * (1.0f / 31.0f);
-		}
-		break;
-	case CLK_UNORM_SHORT_565:
-		{
-			const __uint s = *(const __ushort*)ptr;
-			v.get<0>() = ((s >> 11) & 31U) * (1.0f / 31.0f);
-			v.get<1>() = ((s >> 5) & 63U) * (1.0f / 63.0f);
-			v.get<2>() = (s & 31U) * (1.0f / 31.0f);
-		}
-		break;
-	case CLK_UNORM_INT_101010:
-		{
-			const __uint s = *(const __uint*)ptr;
-			v.get<0>() = ((s >> 20) & 1023U) * (1.0f / 1023.0f);
-			v.get<1>() = ((s >> 10) & 1023U) * (1.0f / 1023.0f);
-			v.get<2>() = (s & 1023U) * (1.0f / 1023.0f);
-		}
-		break;
-	case CLK_SNORM_INT8:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			v.v[i] = ((const __char*)ptr)[i] * (1.0f / 127.0f);
-		break;
-	case CLK_SNORM_INT16:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			v.v[i] = ((const __short*)ptr)[i] * (1.0f / 32767.0f);
-		break;
-	case CLK_HALF_FLOAT:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			v.v[i] = ((const __half*)ptr)[i];
-		break;
-	case CLK_FLOAT:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			v.v[i] = ((const __float*)ptr)[i];
-		break;
-	}
-
-	return __map_channels_for_reading(image, v);
+	const __char * const ptr = __sampled_texel(image, __coord.get<0>(), __coord.get<1>());
+	return __read_texelf(image, ptr);
 }
 static inline __float4 read_imagef(const image2d_t &image, sampler_t sampler, const __float2 &coord)
 {
@@ -142,16 +91,17 @@ static inline __float4 read_imagef(const image2d_t &image, sampler_t sampler, co
 		rcoord *= __float2::make(image.width, image.height);
 	if (!(sampler & CLK_FILTER_LINEAR))
 		return read_imagef(image, sampler, convert_int2(rcoord));
-	const __int2 c0 = convert_int2(rcoord - __float2::make(0.5f, 0.5f));
-	const __float2 dp = rcoord - convert_float2(c0);
-	__float4 v0 = read_imagef(image, sampler, c0);
-	__float4 v1 = read_imagef(image, sampler, c0 + __int2::make(1,0));
-	v0 = v0 + dp.get<0>() * (v1 - v0);
-	v1 = read_imagef(image, sampler, c0 + __int2::make(0,1));
-	const __float4 v2 = read_imagef(image, sampler, c0 + __int2::make(1,1));
-	v1 = v1 + dp.get<0>() * (v2 - v1);
-
-	return v0 + dp.get<1>() * (v1 - v0);
+	const __float2 p = rcoord - __float2::make(0.5f, 0.5f);
+	const __float2 f = floor(p);
+	// Addressing applies to each coordinate, so the two corners give the four texels
+	const __int2 c0 = __address_mode(image, sampler, convert_int2(f));
+	const __int2 c1 = __address_mode(image, sampler, convert_int2(f) + __int2::make(1));
+	return __filter_texelsf(image,
+							__sampled_texel(image, c0.get<0>(), c0.get<1>()),
+							__sampled_texel(image, c1.get<0>(), c0.get<1>()),
+							__sampled_texel(image, c0.get<0>(), c1.get<1>()),
+							__sampled_texel(image, c1.get<0>(), c1.get<1>()),
+							p - f);
 }
 static inline __float4 read_imagef(const image2d_t &image, const __int2 &coord)
 {
@@ -162,46 +112,8 @@ static inline __int4 read_imagei(const image2d_t &image, sampler_t sampler, cons
 {
 	const __int2 __coord = __address_mode(image, sampler, coord);
 
-	const __char * const ptr = (const __char*)image.data + __coord.get<0>() * image.element_size + __coord.get<1>() * image.row_pitch;
-	__size_t nb_chan;
-	switch(image.channel_order)
-	{
-	case CLK_R:			nb_chan = 1;	break;
-	case CLK_A:			nb_chan = 1;	break;
-	case CLK_INTENSITY:	nb_chan = 1;	break;
-	case CLK_LUMINANCE:	nb_chan = 1;	break;
-	case CLK_Rx:		nb_chan = 1;	break;
-
-	case CLK_RG:		nb_chan = 2;	break;
-	case CLK_RA:		nb_chan = 2;	break;
-	case CLK_RGx:		nb_chan = 2;	break;
-
-	case CLK_RGB:		nb_chan = 3;	break;
-	case CLK_RGBx:		nb_chan = 3;	break;
-
-	case CLK_RGBA:		nb_chan = 4;	break;
-	case CLK_BGRA:		nb_chan = 4;	break;
-	case CLK_ARGB:		nb_chan = 4;	break;
-	}
-
-	__int4 v;
-	switch(image.channel_data_type)
-	{
-	case CLK_SIGNED_INT8:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			v.v[i] = ((const __char*)ptr)[i];
-		break;
-	case CLK_SIGNED_INT16:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			v.v[i] = ((const __short*)ptr)[i];
-		break;
-	case CLK_SIGNED_INT32:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			v.v[i] = ((const __int*)ptr)[i];
-		break;
-	}
-
-	return __map_channels_for_reading(image, v);
+	const __char * const ptr = __sampled_texel(image, __coord.get<0>(), __coord.get<1>());
+	return __read_texeli(image, ptr);
 }
 static inline __int4 read_imagei(const image2d_t &image, sampler_t sampler, const __float2 &coord)
 {
@@ -218,46 +130,8 @@ static inline __uint4 read_imageui(const image2d_t &image, sampler_t sampler, co
 {
 	const __int2 __coord = __address_mode(image, sampler, coord);
 
-	const __char * const ptr = (const __char*)image.data + __coord.get<0>() * image.element_size + __coord.get<1>() * image.row_pitch;
-	__size_t nb_chan;
-	switch(image.channel_order)
-	{
-	case CLK_R:			nb_chan = 1;	break;
-	case CLK_A:			nb_chan = 1;	break;
-	case CLK_INTENSITY:	nb_chan = 1;	break;
-	case CLK_LUMINANCE:	nb_chan = 1;	break;
-	case CLK_Rx:		nb_chan = 1;	break;
-
-	case CLK_RG:		nb_chan = 2;	break;
-	case CLK_RA:		nb_chan = 2;	break;
-	case CLK_RGx:		nb_chan = 2;	break;
-
-	case CLK_RGB:		nb_chan = 3;	break;
-	case CLK_RGBx:		nb_chan = 3;	break;
-
-	case CLK_RGBA:		nb_chan = 4;	break;
-	case CLK_BGRA:		nb_chan = 4;	break;
-	case CLK_ARGB:		nb_chan = 4;	break;
-	}
-
-	__uint4 v;
-	switch(image.channel_data_type)
-	{
-	case CLK_UNSIGNED_INT8:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			v.v[i] = ((const __uchar*)ptr)[i];
-		break;
-	case CLK_UNSIGNED_INT16:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			v.v[i] = ((const __ushort*)ptr)[i];
-		break;
-	case CLK_UNSIGNED_INT32:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			v.v[i] = ((const __uint*)ptr)[i];
-		break;
-	}
-
-	return __map_channels_for_reading(image, v);
+	const __char * const ptr = __sampled_texel(image, __coord.get<0>(), __coord.get<1>());
+	return __read_texelui(image, ptr);
 }
 static inline __uint4 read_imageui(const image2d_t &image, sampler_t sampler, const __float2 &coord)
 {
@@ -272,95 +146,20 @@ static inline __uint4 read_imageui(const image2d_t &image, const __int2 &coord)
 
 static inline void write_imagef(image2d_t &image, const __int2 &coord, const __float4 &color)
 {
-	__size_t nb_chan;
-	const __float4 v = __map_channels_for_writing(image, color, nb_chan);
-	__char *const ptr = (__char*)image.data + image.row_pitch * coord.get<1>() + coord.get<0>() * image.element_size;
-	switch(image.channel_data_type)
-	{
-	case CLK_SNORM_INT8:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			((__char*)ptr)[i] = clamp(v.v[i] * 127.0f, -127.0f, 127.0f);
-		break;
-	case CLK_SNORM_INT16:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			((__short*)ptr)[i] = clamp(v.v[i] * 32767.0f, -32767.0f, 32767.0f);
-		break;
-	case CLK_UNORM_INT8:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			((__uchar*)ptr)[i] = clamp(v.v[i] * 255.0f, 0.0f, 255.0f);
-		break;
-	case CLK_UNORM_INT16:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			((__ushort*)ptr)[i] = clamp(v.v[i] * 65535.0f, 0.0f, 65535.0f);
-		break;
-	case CLK_UNORM_SHORT_565:
-		*((__ushort*)ptr) = (((__uint)clamp(v.get<0>() * 31.0f, 0.0f, 31.0f)) << 11)
-						| (((__uint)clamp(v.get<1>() * 63.0f, 0.0f, 63.0f)) << 5)
-						| ((__uint)clamp(v.get<2>() * 31.0f, 0.0f, 31.0f));
-		break;
-	case CLK_UNORM_SHORT_555:
-		*((__ushort*)ptr) = (((__uint)clamp(v.get<0>() * 31.0f, 0.0f, 31.0f)) << 10)
-						| (((__uint)clamp(v.get<1>() * 31.0f, 0.0f, 31.0f)) << 5)
-						| ((__uint)clamp(v.get<2>() * 31.0f, 0.0f, 31.0f));
-		break;
-	case CLK_UNORM_INT_101010:
-		*((__uint*)ptr) = (((__uint)clamp(v.get<0>() * 1023.0f, 0.0f, 1023.0f)) << 20)
-						| (((__uint)clamp(v.get<1>() * 1023.0f, 0.0f, 1023.0f)) << 10)
-						| ((__uint)clamp(v.get<2>() * 1023.0f, 0.0f, 1023.0f));
-		break;
-	case CLK_HALF_FLOAT:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			((__half*)ptr)[i] = __half::from_float(v.v[i]);
-		break;
-	case CLK_FLOAT:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			((__float*)ptr)[i] = v.v[i];
-		break;
-	}
+	__char *const ptr = (__char*)image.data + __texel_offset(image, coord.get<0>(), coord.get<1>());
+	__write_texelf(image, ptr, color);
 }
 
 static inline void write_imagei(image2d_t &image, const __int2 &coord, const __int4 &color)
 {
-	__size_t nb_chan;
-	const __int4 v = __map_channels_for_writing(image, color, nb_chan);
-	__char *const ptr = (__char*)image.data + image.row_pitch * coord.get<1>() + coord.get<0>() * image.element_size;
-	switch(image.channel_data_type)
-	{
-	case CLK_SIGNED_INT8:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			((__char*)ptr)[i] = clamp(v.v[i], -128, 127);
-		break;
-	case CLK_SIGNED_INT16:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			((__short*)ptr)[i] = clamp(v.v[i], -32768, 32767);
-		break;
-	case CLK_SIGNED_INT32:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			((__int*)ptr)[i] = v.v[i];
-		break;
-	}
+	__char *const ptr = (__char*)image.data + __texel_offset(image, coord.get<0>(), coord.get<1>());
+	__write_texeli(image, ptr, color);
 }
 
 static inline void write_imageui(image2d_t &image, const __int2 &coord, const __uint4 &color)
 {
-	__size_t nb_chan;
-	const __uint4 v = __map_channels_for_writing(image, color, nb_chan);
-	__char *const ptr = (__char*)image.data + image.row_pitch * coord.get<1>() + coord.get<0>() * image.element_size;
-	switch(image.channel_data_type)
-	{
-	case CLK_UNSIGNED_INT8:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			((__uchar*)ptr)[i] = clamp(v.v[i], 0, 255);
-		break;
-	case CLK_UNSIGNED_INT16:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			((__ushort*)ptr)[i] = clamp(v.v[i], 0, 65535);
-		break;
-	case CLK_SIGNED_INT32:
-		for(__size_t i = 0 ; i < nb_chan ; ++i)
-			((__uint*)ptr)[i] = v.v[i];
-		break;
-	}
+	__char *const ptr = (__char*)image.data + __texel_offset(image, coord.get<0>(), coord.get<1>());
+	__write_texelui(image, ptr, color);
 }
 
 static inline __int get_image_width(const image2d_t &image)	{	return image.width;	}
@@ -71,11 +71,34 @@ static inline __float __quarter(__float v)	{	return v * 0.25f;	}
 static inline __int __quarter(__int v)	{	return v >> 2;	}
 static inline __uint __quarter(__uint v)	{	return v >> 2;	}
 
-template<class I, class T>
-static inline T __map_channels_for_reading(const I &image, const T &v)
+static inline __size_t __channel_count(const __uint channel_order)
+{
+	switch(channel_order)
+	{
+	case CLK_R:
+	case CLK_A:
+	case CLK_INTENSITY:
+	case CLK_LUMINANCE:
+	case CLK_Rx:
+		return 1;
+
+	case CLK_RG:
+	case CLK_RA:
+	case CLK_RGx:
+		return 2;
+
+	case CLK_RGB:
+	case CLK_RGBx:
+		return 3;
+	}
+	return 4;
+}
+
+template<class T>
+static inline T __map_channels_for_reading(const __uint channel_order, const T &v)
 {
 	T color;
-	switch(image.channel_order)
+	switch(channel_order)
 	{
 	case CLK_R:
 	case CLK_Rx:
@@ -117,11 +140,11 @@ static inline T __map_channels_for_reading(const I &image, const T &v)
 	return color;
 }
 
-template<typename I, class T>
-static inline T __map_channels_for_writing(const I &image, const T &color, __size_t &nb_chan)
+template<class T>
+static inline T __map_channels_for_writing(const __uint channel_order, const T &color, __size_t &nb_chan)
 {
 	T v;
-	switch(image.channel_order)
+	switch(channel_order)
 	{
 	case CLK_R:
 		v.v[0] = color.v[0];
@@ -151,7 +174,7 @@ static inline T __map_channels_for_writing(const I &image, const T &color, __siz
 		break;
 	case CLK_RA:
 		v.v[0] = color.v[0];
-		v.v[1] = v.v[3];
+		v.v[1] = color.v[3];
 		nb_chan = 2;
 		break;
 	case CLK_RGx:
@@ -195,6 +218,421 @@ static inline T __map_channels_for_writing(const I &image, const T &color, __siz
 	return v;
 }
 
+// Texel conversions between the storage of an image and the values kernels
+// read and write. They are generic in the channel order and data type, and
+// only fold into a load and a conversion when those are constants, which
+// they are in the accessors of __image_access_of.
+static inline __attribute__((always_inline)) __float4 __load_texelf(const void *ptr, const __uint channel_order, const __uint channel_data_type)
+{
+	const __size_t nb_chan = __channel_count(channel_order);
+	__float4 v;
+	switch(channel_data_type)
+	{
+	case CLK_UNORM_INT8:
+		for(__size_t i = 0 ; i < nb_chan ; ++i)
+			v.v[i] = ((const __uchar*)ptr)[i] * (1.0f / 255.0f);
+		break;
+	case CLK_UNORM_INT16:
+		for(__size_t i = 0 ; i < nb_chan ; ++i)
+			v.v[i] = ((const __ushort*)ptr)[i] * (1.0f / 65535.0f);
+		break;
+	case CLK_UNORM_SHORT_555:
+		{
+			const __uint s = *(const __ushort*)ptr;
+			v.get<0>() = ((s >> 10) & 31U) * (1.0f / 31.0f);
+			v.get<1>() = ((s >> 5) & 31U) * (1.0f / 31.0f);
+			v.get<2>() = (s & 31U) * (1.0f / 31.0f);
+		}
+		break;
+	case CLK_UNORM_SHORT_565:
+		{
+			const __uint s = *(const __ushort*)ptr;
+			v.get<0>() = ((s >> 11) & 31U) * (1.0f / 31.0f);
+			v.get<1>() = ((s >> 5) & 63U) * (1.0f / 63.0f);
+			v.get<2>() = (s & 31U) * (1.0f / 31.0f);
+		}
+		break;
+	case CLK_UNORM_INT_101010:
+		{
+			const __uint s = *(const __uint*)ptr;
+			v.get<0>() = ((s >> 20) & 1023U) * (1.0f / 1023.0f);
+			v.get<1>() = ((s >> 10) & 1023U) * (1.0f / 1023.0f);
+			v.get<2>() = (s & 1023U) * (1.0f / 1023.0f);
+		}
+		break;
+	case CLK_SNORM_INT8:
+		for(__size_t i = 0 ; i < nb_chan ; ++i)
+			v.v[i] = ((const __char*)ptr)[i] * (1.0f / 127.0f);
+		break;
+	case CLK_SNORM_INT16:
+		for(__size_t i = 0 ; i < nb_chan ; ++i)
+			v.v[i] = ((const __short*)ptr)[i] * (1.0f / 32767.0f);
+		break;
+	case CLK_HALF_FLOAT:
+		for(__size_t i = 0 ; i < nb_chan ; ++i)
+			v.v[i] = ((const __half*)ptr)[i];
+		break;
+	case CLK_FLOAT:
+		for(__size_t i = 0 ; i < nb_chan ; ++i)
+			v.v[i] = ((const __float*)ptr)[i];
+		break;
+	}
+
+	return __map_channels_for_reading(channel_order, v);
+}
+
+static inline __attribute__((always_inline)) __int4 __load_texeli(const void *ptr, const __uint channel_order, const __uint channel_data_type)
+{
+	const __size_t nb_chan = __channel_count(channel_order);
+	__int4 v;
+	switch(channel_data_type)
+	{
+	case CLK_SIGNED_INT8:
+		for(__size_t i = 0 ; i < nb_chan ; ++i)
+			v.v[i] = ((const __char*)ptr)[i];
+		break;
+	case CLK_SIGNED_INT16:
+		for(__size_t i = 0 ; i < nb_chan ; ++i)
+			v.v[i] = ((const __short*)ptr)[i];
+		break;
+	case CLK_SIGNED_INT32:
+		for(__size_t i = 0 ; i < nb_chan ; ++i)
+			v.v[i] = ((const __int*)ptr)[i];
+		break;
+	}
+
+	return __map_channels_for_reading(channel_order, v);
+}
+
+static inline __attribute__((always_inline)) __uint4 __load_texelui(const void *ptr, const __uint channel_order, const __uint channel_data_type)
+{
+	const __size_t nb_chan = __channel_count(channel_order);
+	__uint4 v;
+	switch(channel_data_type)
+	{
+	case CLK_UNSIGNED_INT8:
+		for(__size_t i = 0 ; i < nb_chan ; ++i)
+			v.v[i] = ((const __uchar*)ptr)[i];
+		break;
+	case CLK_UNSIGNED_INT16:
+		for(__size_t i = 0 ; i < nb_chan ; ++i)
+			v.v[i] = ((const __ushort*)ptr)[i];
+		break;
+	case CLK_UNSIGNED_INT32:
+		for(__size_t i = 0 ; i < nb_chan ; ++i)
+			v.v[i] = ((const __uint*)ptr)[i];
+		break;
+	}
+
+	return __map_channels_for_reading(channel_order, v);
+}
+
+static inline __attribute__((always_inline)) void __store_texelf(void *ptr, const __float4 &color, const __uint channel_order, const __uint channel_data_type)
+{
+	__size_t nb_chan;
+	const __float4 v = __map_channels_for_writing(channel_order, color, nb_chan);
+	switch(channel_data_type)
+	{
+	case CLK_SNORM_INT8:
+		for(__size_t i = 0 ; i < nb_chan ; ++i)
+			((__char*)ptr)[i] = clamp(v.v[i] * 127.0f, -127.0f, 127.0f);
+		break;
+	case CLK_SNORM_INT16:
+		for(__size_t i = 0 ; i < nb_chan ; ++i)
+			((__short*)ptr)[i] = clamp(v.v[i] * 32767.0f, -32767.0f, 32767.0f);
+		break;
+	case CLK_UNORM_INT8:
+		for(__size_t i = 0 ; i < nb_chan ; ++i)
+			((__uchar*)ptr)[i] = clamp(v.v[i] * 255.0f, 0.0f, 255.0f);
+		break;
+	case CLK_UNORM_INT16:
+		for(__size_t i = 0 ; i < nb_chan ; ++i)
+			((__ushort*)ptr)[i] = clamp(v.v[i] * 65535.0f, 0.0f, 65535.0f);
+		break;
+	case CLK_UNORM_SHORT_565:
+		*((__ushort*)ptr) = (((__uint)clamp(v.get<0>() * 31.0f, 0.0f, 31.0f)) << 11)
+						| (((__uint)clamp(v.get<1>() * 63.0f, 0.0f, 63.0f)) << 5)
+						| ((__uint)clamp(v.get<2>() * 31.0f, 0.0f, 31.0f));
+		break;
+	case CLK_UNORM_SHORT_555:
+		*((__ushort*)ptr) = (((__uint)clamp(v.get<0>() * 31.0f, 0.0f, 31.0f)) << 10)
+						| (((__uint)clamp(v.get<1>() * 31.0f, 0.0f, 31.0f)) << 5)
+						| ((__uint)clamp(v.get<2>() * 31.0f, 0.0f, 31.0f));
+		break;
+	case CLK_UNORM_INT_101010:
+		*((__uint*)ptr) = (((__uint)clamp(v.get<0>() * 1023.0f, 0.0f, 1023.0f)) << 20)
+						| (((__uint)clamp(v.get<1>() * 1023.0f, 0.0f, 1023.0f)) << 10)
+						| ((__uint)clamp(v.get<2>() * 1023.0f, 0.0f, 1023.0f));
+		break;
+	case CLK_HALF_FLOAT:
+		for(__size_t i = 0 ; i < nb_chan ; ++i)
+			((__half*)ptr)[i] = __half::from_float(v.v[i]);
+		break;
+	case CLK_FLOAT:
+		for(__size_t i = 0 ; i < nb_chan ; ++i)
+			((__float*)ptr)[i] = v.v[i];
+		break;
+	}
+}
+
+static inline __attribute__((always_inline)) void __store_texeli(void *ptr, const __int4 &color, const __uint channel_order, const __uint channel_data_type)
+{
+	__size_t nb_chan;
+	const __int4 v = __map_channels_for_writing(channel_order, color, nb_chan);
+	switch(channel_data_type)
+	{
+	case CLK_SIGNED_INT8:
+		for(__size_t i = 0 ; i < nb_chan ; ++i)
+			((__char*)ptr)[i] = clamp(v.v[i], -128, 127);
+		break;
+	case CLK_SIGNED_INT16:
+		for(__size_t i = 0 ; i < nb_chan ; ++i)
+			((__short*)ptr)[i] = clamp(v.v[i], -32768, 32767);
+		break;
+	case CLK_SIGNED_INT32:
+		for(__size_t i = 0 ; i < nb_chan ; ++i)
+			((__int*)ptr)[i] = v.v[i];
+		break;
+	}
+}
+
+static inline __attribute__((always_inline)) void __store_texelui(void *ptr, const __uint4 &color, const __uint channel_order, const __uint channel_data_type)
+{
+	__size_t nb_chan;
+	const __uint4 v = __map_channels_for_writing(channel_order, color, nb_chan);
+	switch(channel_data_type)
+	{
+	case CLK_UNSIGNED_INT8:
+		for(__size_t i = 0 ; i < nb_chan ; ++i)
+			((__uchar*)ptr)[i] = clamp(v.v[i], 0U, 255U);
+		break;
+	case CLK_UNSIGNED_INT16:
+		for(__size_t i = 0 ; i < nb_chan ; ++i)
+			((__ushort*)ptr)[i] = clamp(v.v[i], 0U, 65535U);
+		break;
+	case CLK_UNSIGNED_INT32:
+		for(__size_t i = 0 ; i < nb_chan ; ++i)
+			((__uint*)ptr)[i] = v.v[i];
+		break;
+	}
+}
+
+// Texel accessors of an image format, chosen once per kernel launch by
+// __image_bind_access so that reading or writing a texel is an indirect
+// call to a load or a store and its conversion. The arguments give the
+// format to the generic accessors, specialized ones ignore them.
+struct __image_access
+{
+	__float4 (*read_f)(const void *ptr, const __uint channel_order, const __uint channel_data_type);
+	__int4 (*read_i)(const void *ptr, const __uint channel_order, const __uint channel_data_type);
+	__uint4 (*read_ui)(const void *ptr, const __uint channel_order, const __uint channel_data_type);
+	// Bilinear filtering of the texels at p00, p10 (next column), p01 (next
+	// row) and p11, w being the position of the sample between them
+	__float4 (*filter_f)(const void *p00, const void *p10, const void *p01, const void *p11, const __float2 &w, const __uint channel_order, const __uint channel_data_type);
+	void (*write_f)(void *ptr, const __float4 &color, const __uint channel_order, const __uint channel_data_type);
+	void (*write_i)(void *ptr, const __int4 &color, const __uint channel_order, const __uint channel_data_type);
+	void (*write_ui)(void *ptr, const __uint4 &color, const __uint channel_order, const __uint channel_data_type);
+};
+
+// ORDER and TYPE are 0 for the generic accessors
+template<__uint ORDER, __uint TYPE>
+static __float4 __access_readf(const void *ptr, const __uint channel_order, const __uint channel_data_type)
+{	return __load_texelf(ptr, ORDER ? ORDER : channel_order, TYPE ? TYPE : channel_data_type);	}
+template<__uint ORDER, __uint TYPE>
+static __int4 __access_readi(const void *ptr, const __uint channel_order, const __uint channel_data_type)
+{	return __load_texeli(ptr, ORDER ? ORDER : channel_order, TYPE ? TYPE : channel_data_type);	}
+template<__uint ORDER, __uint TYPE>
+static __uint4 __access_readui(const void *ptr, const __uint channel_order, const __uint channel_data_type)
+{	return __load_texelui(ptr, ORDER ? ORDER : channel_order, TYPE ? TYPE : channel_data_type);	}
+template<__uint ORDER, __uint TYPE>
+static __float4 __access_filterf(const void *p00, const void *p10, const void *p01, const void *p11, const __float2 &w, const __uint channel_order, const __uint channel_data_type)
+{
+	const __uint order = ORDER ? ORDER : channel_order;
+	const __uint type = TYPE ? TYPE : channel_data_type;
+	const __float4 v00 = __load_texelf(p00, order, type);
+	const __float4 v10 = __load_texelf(p10, order, type);
+	const __float4 v01 = __load_texelf(p01, order, type);
+	const __float4 v11 = __load_texelf(p11, order, type);
+	const __float4 v0 = v00 + w.get<0>() * (v10 - v00);
+	const __float4 v1 = v01 + w.get<0>() * (v11 - v01);
+	return v0 + w.get<1>() * (v1 - v0);
+}
+template<__uint ORDER, __uint TYPE>
+static void __access_writef(void *ptr, const __float4 &color, const __uint channel_order, const __uint channel_data_type)
+{	__store_texelf(ptr, color, ORDER ? ORDER : channel_order, TYPE ? TYPE : channel_data_type);	}
+template<__uint ORDER, __uint TYPE>
+static void __access_writei(void *ptr, const __int4 &color, const __uint channel_order, const __uint channel_data_type)
+{	__store_texeli(ptr, color, ORDER ? ORDER : channel_order, TYPE ? TYPE : channel_data_type);	}
+template<__uint ORDER, __uint TYPE>
+static void __access_writeui(void *ptr, const __uint4 &color, const __uint channel_order, const __uint channel_data_type)
+{	__store_texelui(ptr, color, ORDER ? ORDER : channel_order, TYPE ? TYPE : channel_data_type);	}
+
+// Filtering of the formats resampling kernels use most: texels are loaded
+// as one vector, blended and normalized once rather than each of them
+// being converted channel by channel.
+template<>
+__float4 __access_filterf<CLK_R, CLK_FLOAT>(const void *p00, const void *p10, const void *p01, const void *p11, const __float2 &w, const __uint, const __uint)
+{
+	const __float v00 = *(const __float*)p00;
+	const __float v01 = *(const __float*)p01;
+	const __float v0 = v00 + w.get<0>() * (*(const __float*)p10 - v00);
+	const __float v1 = v01 + w.get<0>() * (*(const __float*)p11 - v01);
+	return __float4::make(v0 + w.get<1>() * (v1 - v0), 0.0f, 0.0f, 0.0f);
+}
+
+#ifdef __SSE2__
+static inline __m128 __bilinear(const __m128 v00, const __m128 v10, const __m128 v01, const __m128 v11, const __float2 &w)
+{
+	const __m128 wx = _mm_set1_ps(w.get<0>());
+	const __m128 v0 = _mm_add_ps(v00, _mm_mul_ps(wx, _mm_sub_ps(v10, v00)));
+	const __m128 v1 = _mm_add_ps(v01, _mm_mul_ps(wx, _mm_sub_ps(v11, v01)));
+	return _mm_add_ps(v0, _mm_mul_ps(_mm_set1_ps(w.get<1>()), _mm_sub_ps(v1, v0)));
+}
+
+// The 4 channels of an 8 bit texel, not normalized
+static inline __m128 __unpack_texel8(const void *ptr)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i v = _mm_cvtsi32_si128(*(const __int*)ptr);
+	return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(v, zero), zero));
+}
+
+template<>
+__float4 __access_filterf<CLK_RGBA, CLK_UNORM_INT8>(const void *p00, const void *p10, const void *p01, const void *p11, const __float2 &w, const __uint, const __uint)
+{
+	const __m128 v = _mm_mul_ps(__bilinear(__unpack_texel8(p00), __unpack_texel8(p10), __unpack_texel8(p01), __unpack_texel8(p11), w),
+								_mm_set1_ps(1.0f / 255.0f));
+	return reinterpret_cast<const __float4&>(v);
+}
+
+template<>
+__float4 __access_filterf<CLK_BGRA, CLK_UNORM_INT8>(const void *p00, const void *p10, const void *p01, const void *p11, const __float2 &w, const __uint, const __uint)
+{
+	const __m128 v = _mm_mul_ps(__bilinear(__unpack_texel8(p00), __unpack_texel8(p10), __unpack_texel8(p01), __unpack_texel8(p11), w),
+								_mm_set1_ps(1.0f / 255.0f));
+	const __m128 rgba = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 0, 1, 2));
+	return reinterpret_cast<const __float4&>(rgba);
+}
+
+template<>
+__float4 __access_filterf<CLK_RGBA, CLK_FLOAT>(const void *p00, const void *p10, const void *p01, const void *p11, const __float2 &w, const __uint, const __uint)
+{
+	const __m128 v = __bilinear(_mm_loadu_ps((const __float*)p00), _mm_loadu_ps((const __float*)p10),
+								_mm_loadu_ps((const __float*)p01), _mm_loadu_ps((const __float*)p11), w);
+	return reinterpret_cast<const __float4&>(v);
+}
+#endif
+
+template<__uint ORDER, __uint TYPE>
+static inline const __image_access *__image_access_of()
+{
+	static const __image_access access = { __access_readf<ORDER, TYPE>,
+										   __access_readi<ORDER, TYPE>,
+										   __access_readui<ORDER, TYPE>,
+										   __access_filterf<ORDER, TYPE>,
+										   __access_writef<ORDER, TYPE>,
+										   __access_writei<ORDER, TYPE>,
+										   __access_writeui<ORDER, TYPE> };
+	return &access;
+}
+
+// Only the most common formats get specialized accessors: each of them is
+// compiled with every kernel using images.
+template<class I>
+static inline const __image_access *__image_access_for(const I &image)
+{
+#define __IMAGE_ACCESS_CASE(ORDER, TYPE)	case TYPE:	return __image_access_of<ORDER, TYPE>()
+	switch(image.channel_order)
+	{
+	case CLK_RGBA:
+		switch(image.channel_data_type)
+		{
+		__IMAGE_ACCESS_CASE(CLK_RGBA, CLK_UNORM_INT8);
+		__IMAGE_ACCESS_CASE(CLK_RGBA, CLK_UNORM_INT16);
+		__IMAGE_ACCESS_CASE(CLK_RGBA, CLK_HALF_FLOAT);
+		__IMAGE_ACCESS_CASE(CLK_RGBA, CLK_FLOAT);
+		__IMAGE_ACCESS_CASE(CLK_RGBA, CLK_SIGNED_INT32);
+		__IMAGE_ACCESS_CASE(CLK_RGBA, CLK_UNSIGNED_INT8);
+		__IMAGE_ACCESS_CASE(CLK_RGBA, CLK_UNSIGNED_INT32);
+		}
+		break;
+	case CLK_BGRA:
+		switch(image.channel_data_type)
+		{
+		__IMAGE_ACCESS_CASE(CLK_BGRA, CLK_UNORM_INT8);
+		}
+		break;
+	case CLK_R:
+		switch(image.channel_data_type)
+		{
+		__IMAGE_ACCESS_CASE(CLK_R, CLK_UNORM_INT8);
+		__IMAGE_ACCESS_CASE(CLK_R, CLK_UNORM_INT16);
+		__IMAGE_ACCESS_CASE(CLK_R, CLK_HALF_FLOAT);
+		__IMAGE_ACCESS_CASE(CLK_R, CLK_FLOAT);
+		__IMAGE_ACCESS_CASE(CLK_R, CLK_SIGNED_INT32);
+		__IMAGE_ACCESS_CASE(CLK_R, CLK_UNSIGNED_INT8);
+		__IMAGE_ACCESS_CASE(CLK_R, CLK_UNSIGNED_INT32);
+		}
+		break;
+	case CLK_RG:
+		switch(image.channel_data_type)
+		{
+		__IMAGE_ACCESS_CASE(CLK_RG, CLK_FLOAT);
+		}
+		break;
+	}
+#undef __IMAGE_ACCESS_CASE
+	return __image_access_of<0, 0>();
+}
+
+// Called by __FCL_init for each image argument of a kernel, before any
+// work-item runs
+template<class I>
+static inline void __image_bind_access(const I &image)
+{
+	const_cast<I&>(image).access = __image_access_for(image);
+}
+
+template<class I>
+static inline __float4 __read_texelf(const I &image, const void *ptr)
+{	return image.access->read_f(ptr, image.channel_order, image.channel_data_type);	}
+template<class I>
+static inline __int4 __read_texeli(const I &image, const void *ptr)
+{	return image.access->read_i(ptr, image.channel_order, image.channel_data_type);	}
+template<class I>
+static inline __uint4 __read_texelui(const I &image, const void *ptr)
+{	return image.access->read_ui(ptr, image.channel_order, image.channel_data_type);	}
+template<class I>
+static inline __float4 __filter_texelsf(const I &image, const void *p00, const void *p10, const void *p01, const void *p11, const __float2 &w)
+{	return image.access->filter_f(p00, p10, p01, p11, w, image.channel_order, image.channel_data_type);	}
+template<class I>
+static inline void __write_texelf(I &image, void *ptr, const __float4 &color)
+{	image.access->write_f(ptr, color, image.channel_order, image.channel_data_type);	}
+template<class I>
+static inline void __write_texeli(I &image, void *ptr, const __int4 &color)
+{	image.access->write_i(ptr, color, image.channel_order, image.channel_data_type);	}
+template<class I>
+static inline void __write_texelui(I &image, void *ptr, const __uint4 &color)
+{	image.access->write_ui(ptr, color, image.channel_order, image.channel_data_type);	}
+
+// Wraps coord into [0, size) for CLK_ADDRESS_REPEAT, negative coordinates included
+static inline __int __repeat(const __int coord, const __int size)
+{
+	const __int r = coord % size;
+	return r < 0 ? r + size : r;
+}
+// Folds coord into [0, size) for CLK_ADDRESS_MIRRORED_REPEAT
+static inline __int __mirror(const __int coord, const __int size)
+{
+	const __int r = __repeat(coord, size << 1);
+	return r < size ? r : (size << 1) - 1 - r;
+}
+
+// Read instead of texels outside of the image, which CLK_ADDRESS_CLAMP
+// leaves one texel away from the edges: zero in every format gives the
+// border colour
+static const __char __border_texel[16] = {0};
+
 #include "image1d_t.h"
 #include "image1d_buffer_t.h"
 #include "image1d_array_t.h"
@@ -317,6 +317,7 @@ struct __igentype<V, typename __right<__igentype<typename __vector<V>::base_type
 #include "vmisc.h"
 #include "converters.h"
 #include "imgreadwrite.h"
+#include "pipe.h"
 #include "printf.h"
 
 #undef FLOAT2
@@ -0,0 +1,165 @@
+/*
+	FreeOCL - a free OpenCL implementation for CPU
+	Copyright (C) 2011  Roland Brochard
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#ifndef __FREEOCL_OPENCL_C_PREINCLUDE_PIPE_H__
+#define __FREEOCL_OPENCL_C_PREINCLUDE_PIPE_H__
+
+// A pipe is a bounded multi-producer multi-consumer ring (this layout must
+// match FreeOCL::pipe_header in src/mem.h). Writers and readers claim slots
+// with a CAS on their own index, each index lives on its own cache line so
+// producers and consumers running on different cores don't share one.
+// Every slot has a sequence number telling whether it is free or holds a
+// packet for the current lap: operations never wait for another work-item,
+// they just fail when the pipe is full or empty.
+struct __pipe
+{
+	volatile __uint write_index;
+	__uint __pad0[15];
+	volatile __uint read_index;
+	__uint __pad1[15];
+	__uint packet_size;
+	__uint max_packets;
+	__uint capacity;		// power of two >= max_packets
+	__uint __pad2[13];
+	// followed by capacity sequence numbers then capacity packets, both cache line aligned
+};
+
+typedef __pipe *pipe_t;
+
+struct reserve_id_t
+{
+	__uint base;
+	__uint num_packets;		// 0 for an invalid reservation
+};
+
+static inline volatile __uint *__pipe_seq(const pipe_t p)
+{
+	return (volatile __uint*)(p + 1);
+}
+
+static inline char *__pipe_packet(const pipe_t p, const __uint idx)
+{
+	return (char*)(p + 1)
+			+ ((p->capacity * sizeof(__uint) + 63) & ~(size_t)63)
+			+ (size_t)(idx & (p->capacity - 1)) * p->packet_size;
+}
+
+// lap is 0 for writers (slot at pos is free when its sequence number is pos)
+// and 1 for readers (slot at pos is full when its sequence number is pos + 1)
+static inline reserve_id_t __pipe_reserve(const pipe_t p, volatile __uint *index, const __uint num_packets, const __uint lap)
+{
+	reserve_id_t rid = { 0, 0 };
+	if (num_packets == 0 || num_packets > p->capacity)
+		return rid;
+	volatile __uint *seq = __pipe_seq(p);
+	const __uint mask = p->capacity - 1;
+	while(true)
+	{
+		const __uint pos = *index;
+		__int diff = 0;
+		for(__uint i = 0 ; i < num_packets && diff == 0 ; ++i)
+			diff = (__int)(seq[(pos + i) & mask] - (pos + i + lap));
+		if (diff < 0)			// full or empty
+			return rid;
+		if (diff > 0)			// another work-item moved index, try again
+			continue;
+		if (__sync_bool_compare_and_swap(index, pos, pos + num_packets))
+		{
+			rid.base = pos;
+			rid.num_packets = num_packets;
+			return rid;
+		}
+	}
+}
+
+static inline void __pipe_commit(const pipe_t p, const reserve_id_t &rid, const __uint lap)
+{
+	volatile __uint *seq = __pipe_seq(p);
+	const __uint mask = p->capacity - 1;
+	__sync_synchronize();
+	for(__uint i = 0 ; i < rid.num_packets ; ++i)
+		seq[(rid.base + i) & mask] = rid.base + i + lap;
+}
+
+// Built-in pipe functions
+static inline bool is_valid_reserve_id(const reserve_id_t &rid)	{	return rid.num_packets != 0;	}
+
+static inline reserve_id_t reserve_read_pipe(const pipe_t p, const __uint num_packets)
+{
+	return __pipe_reserve(p, &p->read_index, num_packets, 1);
+}
+
+static inline reserve_id_t reserve_write_pipe(const pipe_t p, const __uint num_packets)
+{
+	return __pipe_reserve(p, &p->write_index, num_packets, 0);
+}
+
+static inline void commit_read_pipe(const pipe_t p, const reserve_id_t &rid)
+{
+	__pipe_commit(p, rid, p->capacity);
+}
+
+static inline void commit_write_pipe(const pipe_t p, const reserve_id_t &rid)
+{
+	__pipe_commit(p, rid, 1);
+}
+
+static inline __int read_pipe(const pipe_t p, const reserve_id_t &rid, const __uint index, void *ptr)
+{
+	if (index >= rid.num_packets)
+		return -1;
+	memcpy(ptr, __pipe_packet(p, rid.base + index), p->packet_size);
+	return 0;
+}
+
+static inline __int write_pipe(const pipe_t p, const reserve_id_t &rid, const __uint index, const void *ptr)
+{
+	if (index >= rid.num_packets)
+		return -1;
+	memcpy(__pipe_packet(p, rid.base + index), ptr, p->packet_size);
+	return 0;
+}
+
+static inline __int read_pipe(const pipe_t p, void *ptr)
+{
+	const reserve_id_t rid = reserve_read_pipe(p, 1);
+	if (!is_valid_reserve_id(rid))
+		return -1;
+	read_pipe(p, rid, 0, ptr);
+	commit_read_pipe(p, rid);
+	return 0;
+}
+
+static inline __int write_pipe(const pipe_t p, const void *ptr)
+{
+	const reserve_id_t rid = reserve_write_pipe(p, 1);
+	if (!is_valid_reserve_id(rid))
+		return -1;
+	write_pipe(p, rid, 0, ptr);
+	commit_write_pipe(p, rid);
+	return 0;
+}
+
+static inline __uint get_pipe_num_packets(const pipe_t p)
+{
+	const __uint n = p->write_index - p->read_index;
+	return n < p->capacity ? n : p->capacity;
+}
+
+static inline __uint get_pipe_max_packets(const pipe_t p)	{	return p->max_packets;	}
+
+#endif
@@ -523,6 +523,9 @@ namespace FreeOCL
 					case native_type::IMAGE3D_T:
 						type_id = CL_MEM_OBJECT_IMAGE3D;
 						break;
+					case native_type::PIPE_T:
+						type_id = CL_MEM_OBJECT_PIPE_FREEOCL;
+						break;
 					}
 				}
 				gen	<< "\tcase " << j << ":" << std::endl
@@ -556,6 +559,19 @@ namespace FreeOCL
 				<< "\t\tFreeOCL::num_groups[i] = global_size[i] / local_size[i];" << std::endl
 				<< "\t}" << std::endl
 				<< std::endl;
+			// Image accessors are chosen here once per launch rather than
+			// for each texel
+			std::stringstream arg_offset;
+			arg_offset << '0';
+			for(size_t j = 0 ; j < params->size() ; ++j)
+			{
+				const smartptr<chunk> cur = (*params)[j].as<chunk>();
+				const smartptr<type> p_type = cur->front().as<type>();
+				const smartptr<native_type> native = p_type.as<native_type>();
+				if (native && native->is_image())
+					gen << "\t__image_bind_access(*(" << *p_type << "*)((const char*)args + " << arg_offset.str() << "));" << std::endl;
+				arg_offset << " + sizeof(" << *p_type << ")";
+			}
 			bool b_needs_sync = false;
 			static const char *sync_functions[] = {"barrier", "mem_fence", "read_mem_fence", "write_mem_fence",
 												   "wait_group_events", "async_work_group_copy", "async_work_group_strided_copy"};
@@ -0,0 +1,587 @@
+/*
+	FreeOCL - a free OpenCL implementation for CPU
+	Copyright (C) 2011  Roland Brochard
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include "commandbuffer.h"
+#include "context.h"
+#include "kernel.h"
+#include "mem.h"
+#include "program.h"
+#include "utils/memops.h"
+#include <cstring>
+#include <algorithm>
+#include "prototypes.h"
+
+#define SET_VAR(X)	FreeOCL::copy_memory_within_limits(&(X), sizeof(X), param_value_size, param_value, param_value_size_ret)
+#define SET_RET(X)	if (errcode_ret)	*errcode_ret = (X)
+
+namespace
+{
+	// Checks the arguments shared by all clCommand*KHR functions
+	cl_int check_command_args(cl_command_buffer_khr command_buffer,
+							  cl_command_queue command_queue,
+							  cl_uint num_sync_points_in_wait_list,
+							  const cl_sync_point_khr *sync_point_wait_list,
+							  cl_mutable_command_khr *mutable_handle)
+	{
+		if (command_queue != NULL)
+			return CL_INVALID_COMMAND_QUEUE;
+		if (mutable_handle != NULL)
+			return CL_INVALID_VALUE;
+		if (command_buffer->state != CL_COMMAND_BUFFER_STATE_RECORDING_KHR)
+			return CL_INVALID_OPERATION;
+		if ((num_sync_points_in_wait_list > 0 && sync_point_wait_list == NULL)
+			|| (num_sync_points_in_wait_list == 0 && sync_point_wait_list != NULL))
+			return CL_INVALID_SYNC_POINT_WAIT_LIST_KHR;
+		for(size_t i = 0 ; i < num_sync_points_in_wait_list ; ++i)
+			if (sync_point_wait_list[i] >= command_buffer->commands.size())
+				return CL_INVALID_SYNC_POINT_WAIT_LIST_KHR;
+		return CL_SUCCESS;
+	}
+
+	void record(cl_command_buffer_khr command_buffer,
+				FreeOCL::smartptr<FreeOCL::command> cmd,
+				cl_sync_point_khr *sync_point)
+	{
+		cmd->num_events_in_wait_list = 0;
+		cmd->event_wait_list = NULL;
+		cmd->event = NULL;
+		if (sync_point)
+			*sync_point = command_buffer->commands.size();
+		command_buffer->commands.push_back(cmd);
+	}
+}
+
+extern "C"
+{
+	cl_command_buffer_khr clCreateCommandBufferKHRFCL(cl_uint num_queues,
+													  const cl_command_queue *queues,
+													  const cl_command_buffer_properties_khr *properties,
+													  cl_int *errcode_ret)
+	{
+		MSG(clCreateCommandBufferKHRFCL);
+		if (num_queues != 1 || queues == NULL)
+		{
+			SET_RET(CL_INVALID_VALUE);
+			return 0;
+		}
+
+		cl_command_buffer_flags_khr flags = 0;
+		std::vector<FreeOCL::command_buffer_property> props;
+		if (properties)
+		{
+			for(; *properties ; properties += 2)
+			{
+				switch(properties[0])
+				{
+				case CL_COMMAND_BUFFER_FLAGS_KHR:
+					if (properties[1] & ~CL_COMMAND_BUFFER_SIMULTANEOUS_USE_KHR)
+					{
+						SET_RET(CL_INVALID_VALUE);
+						return 0;
+					}
+					flags = properties[1];
+					break;
+				default:
+					SET_RET(CL_INVALID_VALUE);
+					return 0;
+				}
+				props.push_back(properties[0]);
+				props.push_back(properties[1]);
+			}
+			props.push_back(0);
+		}
+
+		if (!FreeOCL::is_valid(queues[0]))
+		{
+			SET_RET(CL_INVALID_COMMAND_QUEUE);
+			return 0;
+		}
+
+		cl_command_buffer_khr command_buffer = new _cl_command_buffer_khr(queues[0]->context);
+		command_buffer->queue = queues[0];
+		command_buffer->flags = flags;
+		command_buffer->properties.swap(props);
+		queues[0]->unlock();
+
+		SET_RET(CL_SUCCESS);
+		return command_buffer;
+	}
+
+	cl_int clFinalizeCommandBufferKHRFCL(cl_command_buffer_khr command_buffer)
+	{
+		MSG(clFinalizeCommandBufferKHRFCL);
+		if (!FreeOCL::is_valid(command_buffer))
+			return CL_INVALID_COMMAND_BUFFER_KHR;
+
+		if (command_buffer->state != CL_COMMAND_BUFFER_STATE_RECORDING_KHR)
+		{
+			command_buffer->unlock();
+			return CL_INVALID_OPERATION;
+		}
+		command_buffer->state = CL_COMMAND_BUFFER_STATE_EXECUTABLE_KHR;
+		command_buffer->unlock();
+		return CL_SUCCESS;
+	}
+
+	cl_int clRetainCommandBufferKHRFCL(cl_command_buffer_khr command_buffer)
+	{
+		MSG(clRetainCommandBufferKHRFCL);
+		if (!FreeOCL::is_valid(command_buffer))
+			return CL_INVALID_COMMAND_BUFFER_KHR;
+
+		command_buffer->retain();
+		command_buffer->unlock();
+		return CL_SUCCESS;
+	}
+
+	cl_int clReleaseCommandBufferKHRFCL(cl_command_buffer_khr command_buffer)
+	{
+		MSG(clReleaseCommandBufferKHRFCL);
+		if (!FreeOCL::is_valid(command_buffer))
+			return CL_INVALID_COMMAND_BUFFER_KHR;
+
+		if (command_buffer->release())
+		{
+			command_buffer->invalidate();
+			command_buffer->unlock();
+			delete command_buffer;
+		}
+		else
+			command_buffer->unlock();
+		return CL_SUCCESS;
+	}
+
+	cl_int clEnqueueCommandBufferKHRFCL(cl_uint num_queues,
+										cl_command_queue *queues,
+										cl_command_buffer_khr command_buffer,
+										cl_uint num_events_in_wait_list,
+										const cl_event *event_wait_list,
+										cl_event *event)
+	{
+		MSG(clEnqueueCommandBufferKHRFCL);
+		if ((num_queues > 0 && queues == NULL)
+			|| (num_queues == 0 && queues != NULL)
+			|| num_queues > 1)
+			return CL_INVALID_VALUE;
+
+		if ((num_events_in_wait_list > 0 && event_wait_list == NULL)
+			|| (num_events_in_wait_list == 0 && event_wait_list != NULL))
+			return CL_INVALID_EVENT_WAIT_LIST;
+
+		FreeOCL::unlocker unlock;
+		if (!FreeOCL::is_valid(command_buffer))
+			return CL_INVALID_COMMAND_BUFFER_KHR;
+		unlock.handle(command_buffer);
+
+		if (command_buffer->state == CL_COMMAND_BUFFER_STATE_RECORDING_KHR
+			|| (command_buffer->state == CL_COMMAND_BUFFER_STATE_PENDING_KHR
+				&& !(command_buffer->flags & CL_COMMAND_BUFFER_SIMULTANEOUS_USE_KHR)))
+			return CL_INVALID_OPERATION;
+
+		cl_command_queue command_queue = num_queues ? queues[0] : command_buffer->queue.weak();
+		if (!FreeOCL::is_valid(command_queue))
+			return CL_INVALID_COMMAND_QUEUE;
+		unlock.handle(command_queue);
+
+		// Recorded commands only depend on the device and the context
+		if (command_queue->device != command_buffer->queue->device
+			|| command_queue->context != command_buffer->context)
+			return CL_INCOMPATIBLE_COMMAND_QUEUE_KHR;
+
+		FreeOCL::smartptr<FreeOCL::command_command_buffer> cmd = new FreeOCL::command_command_buffer;
+		cmd->num_events_in_wait_list = num_events_in_wait_list;
+		cmd->event_wait_list = event_wait_list;
+		cmd->event = event ? new _cl_event(command_queue->context) : NULL;
+		cmd->command_buffer = command_buffer;
+
+		if (cmd->event)
+		{
+			cmd->event->command_queue = command_queue;
+			cmd->event->command_type = CL_COMMAND_COMMAND_BUFFER_KHR;
+			cmd->event->status = CL_QUEUED;
+		}
+
+		if (event)
+			*event = cmd->event.weak();
+
+		++command_buffer->pending;
+		command_buffer->state = CL_COMMAND_BUFFER_STATE_PENDING_KHR;
+
+		unlock.forget(command_queue);
+		command_queue->enqueue(cmd);
+
+		return CL_SUCCESS;
+	}
+
+	cl_int clCommandBarrierWithWaitListKHRFCL(cl_command_buffer_khr command_buffer,
+											  cl_command_queue command_queue,
+											  cl_uint num_sync_points_in_wait_list,
+											  const cl_sync_point_khr *sync_point_wait_list,
+											  cl_sync_point_khr *sync_point,
+											  cl_mutable_command_khr *mutable_handle)
+	{
+		MSG(clCommandBarrierWithWaitListKHRFCL);
+		FreeOCL::unlocker unlock;
+		if (!FreeOCL::is_valid(command_buffer))
+			return CL_INVALID_COMMAND_BUFFER_KHR;
+		unlock.handle(command_buffer);
+
+		const cl_int err = check_command_args(command_buffer, command_queue, num_sync_points_in_wait_list, sync_point_wait_list, mutable_handle);
+		if (err != CL_SUCCESS)
+			return err;
+
+		// Commands are replayed in order, a barrier only needs a sync point
+		record(command_buffer, new FreeOCL::command_marker, sync_point);
+
+		return CL_SUCCESS;
+	}
+
+	cl_int clCommandCopyBufferKHRFCL(cl_command_buffer_khr command_buffer,
+									 cl_command_queue command_queue,
+									 cl_mem src_buffer,
+									 cl_mem dst_buffer,
+									 size_t src_offset,
+									 size_t dst_offset,
+									 size_t size,
+									 cl_uint num_sync_points_in_wait_list,
+									 const cl_sync_point_khr *sync_point_wait_list,
+									 cl_sync_point_khr *sync_point,
+									 cl_mutable_command_khr *mutable_handle)
+	{
+		MSG(clCommandCopyBufferKHRFCL);
+		FreeOCL::unlocker unlock;
+		if (!FreeOCL::is_valid(command_buffer))
+			return CL_INVALID_COMMAND_BUFFER_KHR;
+		unlock.handle(command_buffer);
+
+		const cl_int err = check_command_args(command_buffer, command_queue, num_sync_points_in_wait_list, sync_point_wait_list, mutable_handle);
+		if (err != CL_SUCCESS)
+			return err;
+
+		if (!FreeOCL::is_valid(src_buffer))
+			return CL_INVALID_MEM_OBJECT;
+		unlock.handle(src_buffer);
+		if (src_buffer->mem_type == CL_MEM_OBJECT_PIPE_FREEOCL)
+			return CL_INVALID_MEM_OBJECT;
+		if (src_buffer->size < src_offset + size)
+			return CL_INVALID_VALUE;
+
+		if (dst_buffer != src_buffer)		// Don't lock it twice if it's the same buffer
+		{
+			if (!FreeOCL::is_valid(dst_buffer))
+				return CL_INVALID_MEM_OBJECT;
+			unlock.handle(dst_buffer);
+			if (dst_buffer->mem_type == CL_MEM_OBJECT_PIPE_FREEOCL)
+				return CL_INVALID_MEM_OBJECT;
+			if (dst_buffer->size < dst_offset + size)
+				return CL_INVALID_VALUE;
+		}
+
+		if (dst_buffer->is_read_only_file())
+			return CL_INVALID_OPERATION;
+
+		if (src_buffer->context != command_buffer->context
+			|| dst_buffer->context != command_buffer->context)
+			return CL_INVALID_CONTEXT;
+
+		if (src_buffer == dst_buffer
+			&& std::max(src_offset, dst_offset) - std::min(src_offset, dst_offset) < size)
+			return CL_MEM_COPY_OVERLAP;
+
+		FreeOCL::smartptr<FreeOCL::command_copy_buffer> cmd = new FreeOCL::command_copy_buffer;
+		cmd->src_buffer = src_buffer;
+		cmd->src_offset = src_offset;
+		cmd->dst_buffer = dst_buffer;
+		dst_buffer->mark_written();
+		cmd->dst_offset = dst_offset;
+		cmd->cb = size;
+		record(command_buffer, cmd, sync_point);
+
+		return CL_SUCCESS;
+	}
+
+	cl_int clCommandCopyBufferRectKHRFCL(cl_command_buffer_khr command_buffer,
+										 cl_command_queue command_queue,
+										 cl_mem src_buffer,
+										 cl_mem dst_buffer,
+										 const size_t *src_origin,
+										 const size_t *dst_origin,
+										 const size_t *region,
+										 size_t src_row_pitch,
+										 size_t src_slice_pitch,
+										 size_t dst_row_pitch,
+										 size_t dst_slice_pitch,
+										 cl_uint num_sync_points_in_wait_list,
+										 const cl_sync_point_khr *sync_point_wait_list,
+										 cl_sync_point_khr *sync_point,
+										 cl_mutable_command_khr *mutable_handle)
+	{
+		MSG(clCommandCopyBufferRectKHRFCL);
+		if (src_origin == NULL || dst_origin == NULL || region == NULL)
+			return CL_INVALID_VALUE;
+
+		if (src_row_pitch == 0)	src_row_pitch = region[0];
+		if (dst_row_pitch == 0)	dst_row_pitch = region[0];
+		if (src_slice_pitch == 0)	src_slice_pitch = region[1] * src_row_pitch;
+		if (dst_slice_pitch == 0)	dst_slice_pitch = region[1] * dst_row_pitch;
+
+		if (region[0] == 0
+				|| region[1] == 0
+				|| region[2] == 0
+				|| src_row_pitch < region[0]
+				|| dst_row_pitch < region[0]
+				|| src_slice_pitch < region[1] * src_row_pitch
+				|| dst_slice_pitch < region[1] * dst_row_pitch)
+			return CL_INVALID_VALUE;
+
+		FreeOCL::unlocker unlock;
+		if (!FreeOCL::is_valid(command_buffer))
+			return CL_INVALID_COMMAND_BUFFER_KHR;
+		unlock.handle(command_buffer);
+
+		const cl_int err = check_command_args(command_buffer, command_queue, num_sync_points_in_wait_list, sync_point_wait_list, mutable_handle);
+		if (err != CL_SUCCESS)
+			return err;
+
+		if (!FreeOCL::is_valid(src_buffer))
+			return CL_INVALID_MEM_OBJECT;
+		unlock.handle(src_buffer);
+		if (src_buffer->mem_type == CL_MEM_OBJECT_PIPE_FREEOCL)
+			return CL_INVALID_MEM_OBJECT;
+
+		if (dst_buffer != src_buffer)
+		{
+			if (!FreeOCL::is_valid(dst_buffer))
+				return CL_INVALID_MEM_OBJECT;
+			unlock.handle(dst_buffer);
+			if (dst_buffer->mem_type == CL_MEM_OBJECT_PIPE_FREEOCL)
+				return CL_INVALID_MEM_OBJECT;
+		}
+
+		if (dst_buffer->is_read_only_file())
+			return CL_INVALID_OPERATION;
+
+		if (src_buffer->context != command_buffer->context
+			|| dst_buffer->context != command_buffer->context)
+			return CL_INVALID_CONTEXT;
+
+		if (src_buffer->size < src_origin[0] + (region[0]-1)
+		    + (src_origin[1] + (region[1]-1)) * src_row_pitch
+		    + (src_origin[2] + (region[2]-1)) * src_slice_pitch)
+			return CL_INVALID_VALUE;
+
+		if (dst_buffer->size < dst_origin[0] + (region[0]-1)
+		    + (dst_origin[1] + (region[1]-1)) * dst_row_pitch
+		    + (dst_origin[2] + (region[2]-1)) * dst_slice_pitch)
+			return CL_INVALID_VALUE;
+
+		FreeOCL::smartptr<FreeOCL::command_copy_buffer_rect> cmd = new FreeOCL::command_copy_buffer_rect;
+		cmd->src_buffer = src_buffer;
+		cmd->src_offset = src_origin[0] + src_origin[1] * src_row_pitch + src_origin[2] * src_slice_pitch;
+		cmd->dst_buffer = dst_buffer;
+		dst_buffer->mark_written();
+		cmd->dst_offset = dst_origin[0] + dst_origin[1] * dst_row_pitch + dst_origin[2] * dst_slice_pitch;
+		cmd->cb[0] = region[0];
+		cmd->cb[1] = region[1];
+		cmd->cb[2] = region[2];
+		cmd->src_pitch[0] = src_row_pitch;
+		cmd->src_pitch[1] = src_slice_pitch;
+		cmd->dst_pitch[0] = dst_row_pitch;
+		cmd->dst_pitch[1] = dst_slice_pitch;
+		record(command_buffer, cmd, sync_point);
+
+		return CL_SUCCESS;
+	}
+
+	cl_int clCommandFillBufferKHRFCL(cl_command_buffer_khr command_buffer,
+									 cl_command_queue command_queue,
+									 cl_mem buffer,
+									 const void *pattern,
+									 size_t pattern_size,
+									 size_t offset,
+									 size_t size,
+									 cl_uint num_sync_points_in_wait_list,
+									 const cl_sync_point_khr *sync_point_wait_list,
+									 cl_sync_point_khr *sync_point,
+									 cl_mutable_command_khr *mutable_handle)
+	{
+		MSG(clCommandFillBufferKHRFCL);
+		if ((pattern_size & (pattern_size - 1))
+				|| pattern_size > 128
+				|| pattern_size == 0
+				|| pattern == NULL)
+			return CL_INVALID_VALUE;
+
+		if (offset % pattern_size || size % pattern_size)
+			return CL_INVALID_VALUE;
+
+		FreeOCL::unlocker unlock;
+		if (!FreeOCL::is_valid(command_buffer))
+			return CL_INVALID_COMMAND_BUFFER_KHR;
+		unlock.handle(command_buffer);
+
+		const cl_int err = check_command_args(command_buffer, command_queue, num_sync_points_in_wait_list, sync_point_wait_list, mutable_handle);
+		if (err != CL_SUCCESS)
+			return err;
+
+		if (!FreeOCL::is_valid(buffer))
+			return CL_INVALID_MEM_OBJECT;
+		unlock.handle(buffer);
+		if (buffer->mem_type == CL_MEM_OBJECT_PIPE_FREEOCL)
+			return CL_INVALID_MEM_OBJECT;
+		if (buffer->is_read_only_file())
+			return CL_INVALID_OPERATION;
+
+		if (buffer->context != command_buffer->context)
+			return CL_INVALID_CONTEXT;
+
+		if (buffer->size < offset + size)
+			return CL_INVALID_VALUE;
+
+		FreeOCL::smartptr<FreeOCL::command_fill_buffer> cmd = new FreeOCL::command_fill_buffer;
+		cmd->buffer = buffer;
+		if (!FreeOCL::is_zero(pattern, pattern_size))
+			buffer->mark_written();
+		cmd->offset = offset;
+		cmd->size = size;
+		cmd->pattern_size = pattern_size;
+		cmd->pattern = malloc(pattern_size);
+		memcpy(cmd->pattern, pattern, pattern_size);
+		record(command_buffer, cmd, sync_point);
+
+		return CL_SUCCESS;
+	}
+
+	cl_int clCommandNDRangeKernelKHRFCL(cl_command_buffer_khr command_buffer,
+										cl_command_queue command_queue,
+										const cl_ndrange_kernel_command_properties_khr *properties,
+										cl_kernel kernel,
+										cl_uint work_dim,
+										const size_t *global_work_offset,
+										const size_t *global_work_size,
+										const size_t *local_work_size,
+										cl_uint num_sync_points_in_wait_list,
+										const cl_sync_point_khr *sync_point_wait_list,
+										cl_sync_point_khr *sync_point,
+										cl_mutable_command_khr *mutable_handle)
+	{
+		MSG(clCommandNDRangeKernelKHRFCL);
+		// No property is defined for this command yet
+		if (properties && *properties)
+			return CL_INVALID_VALUE;
+
+		if (work_dim < 1 || work_dim > 3)
+			return CL_INVALID_WORK_DIMENSION;
+
+		if (global_work_size == NULL)
+			return CL_INVALID_GLOBAL_WORK_SIZE;
+
+		FreeOCL::unlocker unlock;
+		if (!FreeOCL::is_valid(command_buffer))
+			return CL_INVALID_COMMAND_BUFFER_KHR;
+		unlock.handle(command_buffer);
+
+		const cl_int err = check_command_args(command_buffer, command_queue, num_sync_points_in_wait_list, sync_point_wait_list, mutable_handle);
+		if (err != CL_SUCCESS)
+			return err;
+
+		if (!FreeOCL::is_valid(kernel))
+			return CL_INVALID_KERNEL;
+		unlock.handle(kernel);
+
+		if (kernel->program->context != command_buffer->context)
+			return CL_INVALID_CONTEXT;
+
+		FreeOCL::smartptr<FreeOCL::command_ndrange_kernel> cmd = new FreeOCL::command_ndrange_kernel;
+		cmd->dim = work_dim;
+		cmd->kernel = kernel;
+		for(size_t i = work_dim ; i < 3 ; ++i)
+		{
+			cmd->global_size[i] = 1;
+			cmd->global_offset[i] = 0;
+			cmd->local_size[i] = 1;
+		}
+		for(size_t i = 0 ; i < work_dim ; ++i)
+		{
+			cmd->global_size[i] = global_work_size[i];
+			cmd->global_offset[i] = global_work_offset ? global_work_offset[i] : 0;
+			cmd->local_size[i] = local_work_size ? local_work_size[i] : 1;
+		}
+		// Arguments are captured once here and reused by every execution
+		cmd->set_args();
+		record(command_buffer, cmd, sync_point);
+
+		return CL_SUCCESS;
+	}
+
+	cl_int clGetCommandBufferInfoKHRFCL(cl_command_buffer_khr command_buffer,
+										cl_command_buffer_info_khr param_name,
+										size_t param_value_size,
+										void *param_value,
+										size_t *param_value_size_ret)
+	{
+		MSG(clGetCommandBufferInfoKHRFCL);
+		if (!FreeOCL::is_valid(command_buffer))
+			return CL_INVALID_COMMAND_BUFFER_KHR;
+
+		const cl_uint num_queues = 1;
+		bool bTooSmall = false;
+		switch(param_name)
+		{
+		case CL_COMMAND_BUFFER_QUEUES_KHR:				bTooSmall = SET_VAR(command_buffer->queue.weak());	break;
+		case CL_COMMAND_BUFFER_NUM_QUEUES_KHR:			bTooSmall = SET_VAR(num_queues);	break;
+		case CL_COMMAND_BUFFER_REFERENCE_COUNT_KHR:		bTooSmall = SET_VAR(command_buffer->get_ref_count());	break;
+		case CL_COMMAND_BUFFER_STATE_KHR:				bTooSmall = SET_VAR(command_buffer->state);	break;
+		case CL_COMMAND_BUFFER_CONTEXT_KHR:				bTooSmall = SET_VAR(command_buffer->context);	break;
+		case CL_COMMAND_BUFFER_PROPERTIES_ARRAY_KHR:
+			bTooSmall = FreeOCL::copy_memory_within_limits(command_buffer->properties.empty() ? NULL : &(command_buffer->properties.front()),
+														   command_buffer->properties.size() * sizeof(FreeOCL::command_buffer_property),
+														   param_value_size, param_value, param_value_size_ret);
+			break;
+		default:
+			command_buffer->unlock();
+			return CL_INVALID_VALUE;
+		}
+		command_buffer->unlock();
+		if (bTooSmall && param_value != NULL)
+			return CL_INVALID_VALUE;
+
+		return CL_SUCCESS;
+	}
+}
+
+_cl_command_buffer_khr::_cl_command_buffer_khr(cl_context context)
+	: context_resource(context, FreeOCL::MAGIC_COMMAND_BUFFER),
+	  flags(0),
+	  state(CL_COMMAND_BUFFER_STATE_RECORDING_KHR),
+	  pending(0)
+{
+	magic = FreeOCL::MAGIC_COMMAND_BUFFER;
+}
+
+_cl_command_buffer_khr::~_cl_command_buffer_khr()
+{
+	magic = 0;
+	// The last execution of a command buffer may end on the thread of its
+	// queue, which can't destroy the queue since that waits for the thread
+	// to stop
+	if (queue && queue->is_queue_thread())
+	{
+		FreeOCL::release_command_queue_later(queue.weak());
+		queue.weak() = NULL;
+	}
+}
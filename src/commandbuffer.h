@@ -0,0 +1,50 @@
+/*
+	FreeOCL - a free OpenCL implementation for CPU
+	Copyright (C) 2011  Roland Brochard
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#ifndef __FREEOCL_COMMANDBUFFER_H__
+#define __FREEOCL_COMMANDBUFFER_H__
+
+#include "freeocl.h"
+#include "utils/commandqueue.h"
+#include <vector>
+
+namespace FreeOCL
+{
+	// cl_command_buffer_properties_khr without its alignment attribute, which
+	// std::vector would ignore
+	typedef unsigned long long command_buffer_property;
+}
+
+struct _cl_command_buffer_khr : public FreeOCL::icd_table, public FreeOCL::ref_counter, public FreeOCL::mutex, public FreeOCL::valid_flag, public FreeOCL::context_resource
+{
+	_cl_command_buffer_khr(cl_context);
+	~_cl_command_buffer_khr();
+
+	// Retained until the command buffer is destroyed
+	FreeOCL::smartptr<_cl_command_queue> queue;
+	cl_command_buffer_flags_khr flags;
+	std::vector<FreeOCL::command_buffer_property> properties;
+	cl_command_buffer_state_khr state;
+	// Number of enqueued executions which have not completed yet
+	size_t pending;
+	// Recorded commands, in execution order. The sync point of a command is
+	// its index in this list. It must not be modified once finalized since
+	// command queues walk it without locking the command buffer.
+	std::vector<FreeOCL::smartptr<FreeOCL::command> > commands;
+};
+
+#endif
@@ -25,7 +25,9 @@
 #include "program.h"
 #include "sampler.h"
 #include "utils/commandqueue.h"
+#include "commandbuffer.h"
 #include <iostream>
+#include <cstdio>
 
 #define SET_VAR(X)	FreeOCL::copy_memory_within_limits(&(X), sizeof(X), param_value_size, param_value, param_value_size_ret)
 #define SET_RET(X)	if (errcode_ret)	*errcode_ret = (X)
@@ -88,7 +90,10 @@ extern "C"
 					}
 					++k;
 				}
-				if (properties[0] != CL_CONTEXT_PLATFORM || k > 1)
+				else if (properties[0] == CL_CONTEXT_MEMORY_BUDGET_FREEOCL)
+					c->memory.set_budget(properties[1]);
+				if ((properties[0] != CL_CONTEXT_PLATFORM && properties[0] != CL_CONTEXT_MEMORY_BUDGET_FREEOCL)
+					|| k > 1)
 				{
 					SET_RET(CL_INVALID_PROPERTY);
 					delete c;
@@ -177,8 +182,7 @@ extern "C"
 		if (!FreeOCL::is_valid(context))
 			return CL_INVALID_CONTEXT;
 
-		context->release();
-		if (context->get_ref_count() == 0)
+		if (context->release())
 		{
 			context->invalidate();
 			context->unlock();
@@ -227,6 +231,25 @@ extern "C"
 					*param_value_size_ret = 0;
 			}
 			break;
+		case CL_CONTEXT_MEMORY_USAGE_FREEOCL:
+			{
+				cl_ulong bytes[CL_MEMORY_KIND_COUNT_FREEOCL];
+				context->memory.get_bytes(bytes);
+				bTooSmall = SET_VAR(bytes);
+			}
+			break;
+		case CL_CONTEXT_MEMORY_PEAK_FREEOCL:
+			{
+				const cl_ulong peak = context->memory.get_peak();
+				bTooSmall = SET_VAR(peak);
+			}
+			break;
+		case CL_CONTEXT_MEMORY_BUDGET_FREEOCL:
+			{
+				const cl_ulong budget = context->memory.get_budget();
+				bTooSmall = SET_VAR(budget);
+			}
+			break;
 		default:
 			return CL_INVALID_VALUE;
 		}
@@ -239,17 +262,35 @@ extern "C"
 }
 
 _cl_context::_cl_context()
+	: memory(&FreeOCL::process_memory_usage(), 0),
+	  buffer_cache(&memory)
 {
-	FreeOCL::global_mutex.lock();
-	FreeOCL::valid_contexts.insert(this);
-	FreeOCL::global_mutex.unlock();
+	magic = FreeOCL::MAGIC_CONTEXT;
+}
+
+bool _cl_context::reserve_memory(const cl_uint kind, const size_t size)
+{
+	if (memory.reserve(kind, size))
+		return true;
+	// Storage in the buffer cache counts too, give it back and retry
+	buffer_cache.trim(0);
+	if (memory.reserve(kind, size))
+		return true;
+	if (FreeOCL::memory_stats_enabled())
+	{
+		fprintf(stderr, "FreeOCL: an allocation of %lu bytes exceeds the memory budget\n", (unsigned long)size);
+		memory.dump("context");
+		FreeOCL::process_memory_usage().dump("process");
+	}
+	return false;
 }
 
 _cl_context::~_cl_context()
 {
-	FreeOCL::global_mutex.lock();
-	FreeOCL::valid_contexts.erase(this);
-	FreeOCL::global_mutex.unlock();
+	magic = 0;
+
+	if (FreeOCL::memory_stats_enabled())
+		memory.dump("context");
 
 	lock();
 	FreeOCL::set<FreeOCL::context_resource*> resources = this->resources;
@@ -257,19 +298,22 @@ _cl_context::~_cl_context()
 	for(FreeOCL::set<FreeOCL::context_resource*>::iterator it = resources.begin(), end = resources.end() ; it != end ; ++it)
 	{
 		FreeOCL::context_resource *ptr = *it;
-#define IMPLEMENT_FOR_TYPE(type)\
-		if (FreeOCL::is_valid(static_cast<type>(ptr)))\
+#define IMPLEMENT_FOR_TYPE(type, magic)\
+		if (ptr->resource_type == FreeOCL::magic && FreeOCL::is_valid(static_cast<type>(ptr)))\
 		{\
 			static_cast<type>(ptr)->invalidate();\
 			static_cast<type>(ptr)->unlock();\
 			delete static_cast<type>(ptr);\
 			continue;\
 		}
-		IMPLEMENT_FOR_TYPE(cl_command_queue);
-		IMPLEMENT_FOR_TYPE(cl_event);
-		IMPLEMENT_FOR_TYPE(cl_mem);
-		IMPLEMENT_FOR_TYPE(cl_program);
-		IMPLEMENT_FOR_TYPE(cl_sampler);
+		IMPLEMENT_FOR_TYPE(cl_command_buffer_khr, MAGIC_COMMAND_BUFFER);
+		IMPLEMENT_FOR_TYPE(cl_command_queue, MAGIC_COMMAND_QUEUE);
+		IMPLEMENT_FOR_TYPE(cl_event, MAGIC_EVENT);
+		IMPLEMENT_FOR_TYPE(cl_mem, MAGIC_MEM);
+		IMPLEMENT_FOR_TYPE(cl_program, MAGIC_PROGRAM);
+		IMPLEMENT_FOR_TYPE(cl_sampler, MAGIC_SAMPLER);
 #undef IMPLEMENT_FOR_TYPE
 	}
+	// Commands using them are gone with the queues
+	FreeOCL::free_usm_allocations(this);
 }
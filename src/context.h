@@ -21,12 +21,18 @@
 #include "freeocl.h"
 #include <vector>
 #include <utils/set.h>
+#include <utils/allocator.h>
+#include "usm.h"
 
 struct _cl_context : public FreeOCL::icd_table, public FreeOCL::ref_counter, public FreeOCL::mutex, public FreeOCL::valid_flag
 {
 	_cl_context();
 	~_cl_context();
 
+	// Counts size bytes of kind in memory, releasing the buffer cache if
+	// needed. Returns false if that would exceed a memory budget.
+	bool reserve_memory(const cl_uint kind, const size_t size);
+
 	std::vector<cl_device_id>	devices;
 	std::vector<cl_context_properties>	properties;
 	void (CL_CALLBACK *pfn_notify)(const char *errinfo,
@@ -36,6 +42,11 @@ struct _cl_context : public FreeOCL::icd_table, public FreeOCL::ref_counter, pub
 	void *user_data;
 
 	FreeOCL::set<FreeOCL::context_resource*> resources;
+	// Memory held by the objects of the context, see cl_freeocl_memory_stats
+	FreeOCL::memory_usage memory;
+	// Storage of released buffers, see FreeOCL::memory_cache
+	FreeOCL::memory_cache buffer_cache;
+	FreeOCL::usm_map usm_allocations;
 };
 
 #endif
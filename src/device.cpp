@@ -17,6 +17,7 @@
 */
 #include "device.h"
 #include "platform.h"
+#include "event.h"
 #include <cstring>
 #include <iostream>
 #include <time.h>
@@ -24,6 +25,7 @@
 #include <CL/cl_ext.h>
 #include <unistd.h>
 #include <utils/threadpool.h>
+#include <utils/memory_usage.h>
 #ifdef FREEOCL_OS_WINDOWS
 #include <windows.h>
 #endif
@@ -153,6 +155,57 @@ extern "C"
 			}
 			break;
 		case CL_DEVICE_BUILT_IN_KERNELS:	bTooSmall = SET_STRING("");		break;
+		case CL_DEVICE_COMMAND_BUFFER_CAPABILITIES_KHR:
+			{
+				cl_device_command_buffer_capabilities_khr caps = CL_COMMAND_BUFFER_CAPABILITY_KERNEL_PRINTF_KHR
+																 | CL_COMMAND_BUFFER_CAPABILITY_SIMULTANEOUS_USE_KHR;
+				bTooSmall = SET_VAR(caps);
+			}
+			break;
+		case CL_DEVICE_COMMAND_BUFFER_REQUIRED_QUEUE_PROPERTIES_KHR:
+			{
+				cl_command_queue_properties props = 0;
+				bTooSmall = SET_VAR(props);
+			}
+			break;
+		case CL_DEVICE_HOST_MEM_CAPABILITIES_INTEL:
+		case CL_DEVICE_DEVICE_MEM_CAPABILITIES_INTEL:
+		case CL_DEVICE_SINGLE_DEVICE_SHARED_MEM_CAPABILITIES_INTEL:
+		case CL_DEVICE_SHARED_SYSTEM_MEM_CAPABILITIES_INTEL:
+			{
+				// Kernels run on the host, in the address space of the application
+				const cl_device_unified_shared_memory_capabilities_intel caps = CL_UNIFIED_SHARED_MEMORY_ACCESS_INTEL
+																				| CL_UNIFIED_SHARED_MEMORY_ATOMIC_ACCESS_INTEL
+																				| CL_UNIFIED_SHARED_MEMORY_CONCURRENT_ACCESS_INTEL
+																				| CL_UNIFIED_SHARED_MEMORY_CONCURRENT_ATOMIC_ACCESS_INTEL;
+				bTooSmall = SET_VAR(caps);
+			}
+			break;
+		case CL_DEVICE_CROSS_DEVICE_SHARED_MEM_CAPABILITIES_INTEL:
+			{
+				const cl_device_unified_shared_memory_capabilities_intel caps = 0;
+				bTooSmall = SET_VAR(caps);
+			}
+			break;
+		case CL_DEVICE_MEMORY_USAGE_FREEOCL:
+			{
+				cl_ulong bytes[CL_MEMORY_KIND_COUNT_FREEOCL];
+				FreeOCL::process_memory_usage().get_bytes(bytes);
+				bTooSmall = SET_VAR(bytes);
+			}
+			break;
+		case CL_DEVICE_MEMORY_PEAK_FREEOCL:
+			{
+				const cl_ulong peak = FreeOCL::process_memory_usage().get_peak();
+				bTooSmall = SET_VAR(peak);
+			}
+			break;
+		case CL_DEVICE_MEMORY_BUDGET_FREEOCL:
+			{
+				const cl_ulong budget = FreeOCL::process_memory_usage().get_budget();
+				bTooSmall = SET_VAR(budget);
+			}
+			break;
 
 		default:
 			return CL_INVALID_VALUE;
@@ -302,7 +355,19 @@ _cl_device_id::_cl_device_id() :
 			   "cl_khr_fp64" SEP
 			   "cl_khr_int64_base_atomics" SEP
 			   "cl_khr_int64_extended_atomics" SEP
-			   "cl_freeocl_debug"),
+			   "cl_khr_command_buffer" SEP
+			   "cl_intel_unified_shared_memory" SEP
+			   "cl_freeocl_debug" SEP
+			   "cl_freeocl_native_ndrange" SEP
+			   "cl_freeocl_file_io" SEP
+			   "cl_freeocl_pipe" SEP
+			   "cl_freeocl_huge_pages" SEP
+			   "cl_freeocl_numa" SEP
+			   "cl_freeocl_file_buffer" SEP
+			   "cl_freeocl_buffer_clone" SEP
+			   "cl_freeocl_memory_stats" SEP
+			   "cl_freeocl_shared_buffer" SEP
+			   "cl_freeocl_tiled_images"),
 	exec_capabilities(CL_EXEC_KERNEL | CL_EXEC_NATIVE_KERNEL),
 	preferred_vector_width_char(16),
 	preferred_vector_width_short(8),
@@ -437,6 +502,7 @@ _cl_device_id::_cl_device_id() :
 
 _cl_device_id::~_cl_device_id()
 {
+	FreeOCL::stop_call_back_dispatcher();
 	delete pool;
 }
 
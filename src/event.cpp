@@ -19,6 +19,7 @@
 #include "context.h"
 #include "utils/commandqueue.h"
 #include "utils/time.h"
+#include "utils/thread.h"
 
 #define SET_VAR(X)	FreeOCL::copy_memory_within_limits(&(X), sizeof(X), param_value_size, param_value, param_value_size_ret)
 #define SET_RET(X)	if (errcode_ret)	*errcode_ret = (X)
@@ -57,8 +58,18 @@ extern "C"
 			event->unlock();
 			return CL_INVALID_OPERATION;
 		}
+		// A thread waiting for the event may release it as soon as it is
+		// complete, while change_status still uses it
+		event->retain();
 		event->change_status(execution_status);
-		event->unlock();
+		if (event->release())
+		{
+			event->invalidate();
+			event->unlock();
+			delete event;
+		}
+		else
+			event->unlock();
 		return CL_SUCCESS;
 	}
 
@@ -68,25 +79,55 @@ extern "C"
 		if (num_events == 0 || event_list == NULL)
 			return CL_INVALID_VALUE;
 
-		for(size_t i = 0 ; i < num_events ; )
+		// Check the whole list before waiting for anything
+		cl_context context = NULL;
+		for(size_t i = 0 ; i < num_events ; ++i)
 		{
 			if (!FreeOCL::is_valid(event_list[i]))
 				return CL_INVALID_EVENT;
-			if (event_list[i]->status < 0)
+			const bool b_other_context = i > 0 && event_list[i]->context != context;
+			context = event_list[i]->context;
+			event_list[i]->unlock();
+			if (b_other_context)
+				return CL_INVALID_CONTEXT;
+		}
+
+		// Register once on all pending events, then sleep until the last
+		// one completes
+		FreeOCL::wait_group group;
+		bool b_invalid = false;
+		for(size_t i = 0 ; i < num_events ; ++i)
+		{
+			// Only an event released by another thread meanwhile can fail
+			// here
+			if (!FreeOCL::is_valid(event_list[i]))
 			{
-				event_list[i]->unlock();
-				return CL_EXEC_STATUS_ERROR_FOR_EVENTS_IN_WAIT_LIST;
+				b_invalid = true;
+				continue;
 			}
-			if (event_list[i]->status == CL_COMPLETE)
+			if (event_list[i]->status < 0)
+				group.b_error = true;
+			else if (event_list[i]->status != CL_COMPLETE)
 			{
-				event_list[i]->unlock();
-				++i;
-				continue;
+				group.lock();
+				++group.counter;
+				group.unlock();
+				event_list[i]->waiters.push_back(&group);
 			}
-			event_list[i]->wait_locked();
 			event_list[i]->unlock();
 		}
 
+		// Events hold a pointer to group until they notify it
+		group.lock();
+		while(group.counter > 0)
+			group.wait_locked();
+		group.unlock();
+
+		if (b_invalid)
+			return CL_INVALID_EVENT;
+		if (group.b_error)
+			return CL_EXEC_STATUS_ERROR_FOR_EVENTS_IN_WAIT_LIST;
+
 		return CL_SUCCESS;
 	}
 
@@ -163,8 +204,7 @@ extern "C"
 		if (!FreeOCL::is_valid(event))
 			return CL_INVALID_EVENT;
 
-		event->release();
-		if (event->get_ref_count() == 0)
+		if (event->release())
 		{
 			event->invalidate();
 			event->unlock();
@@ -324,12 +364,153 @@ extern "C"
 	}
 }
 
+namespace
+{
+	// Runs event callbacks on a dedicated thread so a slow callback does not
+	// stall the command queue which completed the event. Callbacks are run in
+	// the order events reach their status.
+	class call_back_dispatcher : public FreeOCL::thread
+	{
+	private:
+		// Jobs without an event release command_queue
+		struct job
+		{
+			cl_event event;
+			cl_int status;
+			FreeOCL::event_call_back call_back;
+			cl_command_queue command_queue;
+		};
+
+	public:
+		call_back_dispatcher() : b_stop(false)	{}
+
+		// Runs the pending jobs and waits for the thread to stop
+		void stop()
+		{
+			cond.lock();
+			b_stop = true;
+			cond.wakeup();
+			cond.unlock();
+			join();
+		}
+
+		// The event must be locked, it is retained until its callbacks
+		// have been run
+		void push(cl_event event, cl_int status, const std::deque<FreeOCL::event_call_back> &call_backs)
+		{
+			cond.lock();
+			for(std::deque<FreeOCL::event_call_back>::const_iterator i = call_backs.begin() ; i != call_backs.end() ; ++i)
+			{
+				if (!i->pfn_notify)
+					continue;
+				event->retain();
+				const job j = { event, status, *i, NULL };
+				jobs.push_back(j);
+			}
+			if (!b_stop)
+			{
+				start();
+				cond.wakeup();
+			}
+			cond.unlock();
+		}
+
+		void push(cl_command_queue command_queue)
+		{
+			cond.lock();
+			const job j = { NULL, 0, FreeOCL::event_call_back(), command_queue };
+			jobs.push_back(j);
+			start();
+			cond.wakeup();
+			cond.unlock();
+		}
+
+		virtual size_t proc()
+		{
+			cond.lock();
+			while(!b_stop || !jobs.empty())
+			{
+				if (jobs.empty())
+				{
+					cond.wait_locked();
+					continue;
+				}
+				const job j = jobs.front();
+				jobs.pop_front();
+				cond.unlock();
+
+				if (!j.event)
+				{
+					j.command_queue->lock();
+					if (j.command_queue->release())
+					{
+						j.command_queue->invalidate();
+						j.command_queue->unlock();
+						delete j.command_queue;
+					}
+					else
+						j.command_queue->unlock();
+					cond.lock();
+					continue;
+				}
+
+				j.call_back.pfn_notify(j.event, j.status, j.call_back.user_data);
+
+				j.event->lock();
+				if (j.event->release())
+				{
+					j.event->invalidate();
+					j.event->unlock();
+					delete j.event;
+				}
+				else
+					j.event->unlock();
+
+				cond.lock();
+			}
+			cond.unlock();
+			return 0;
+		}
+
+	private:
+		FreeOCL::condition cond;
+		std::deque<job> jobs;
+		bool b_stop;
+	};
+
+	// Never destroyed: it is stopped by the device, before the objects
+	// callbacks may use, rather than at some point of static destruction
+	call_back_dispatcher *dispatcher = new call_back_dispatcher;
+
+	// Resolves one dependency of each successor and wakes up the command
+	// queues which have a command ready to run. Must be called without
+	// holding the event lock.
+	void notify_successors(std::deque<FreeOCL::smartptr<FreeOCL::command> > &successors, const bool b_error)
+	{
+		for(std::deque<FreeOCL::smartptr<FreeOCL::command> >::iterator i = successors.begin() ; i != successors.end() ; ++i)
+		{
+			FreeOCL::command *cmd = i->weak();
+			if (b_error)
+				cmd->b_dep_error = true;
+			if (__sync_sub_and_fetch(&cmd->pending_deps, 1) == 0)
+			{
+				// The queue clears this pointer before it is destroyed
+				cmd->queue_lock.lock();
+				if (cmd->queue)
+					cmd->queue->wakeup();
+				cmd->queue_lock.unlock();
+			}
+		}
+		successors.clear();
+	}
+}
+
 void _cl_event::change_status(cl_int new_status)
 {
 	if (status > new_status)
 	{
 		status = new_status;
-		if (command_queue->properties & CL_QUEUE_PROFILING_ENABLE)
+		if (command_queue && (command_queue->properties & CL_QUEUE_PROFILING_ENABLE))
 			switch(status)
 			{
 			case CL_QUEUED:		time_queued = FreeOCL::ns_timer();	break;
@@ -338,34 +519,74 @@ void _cl_event::change_status(cl_int new_status)
 			case CL_COMPLETE:	time_end = FreeOCL::ns_timer();	break;
 			}
 	}
-	if (command_queue)
-		command_queue->wakeup();		// If the command queue is waiting for a status change, notify it
+
+	std::deque<FreeOCL::smartptr<FreeOCL::command> > successors;
+	std::deque<FreeOCL::wait_group*> waiters;
+	if (status <= CL_COMPLETE)
+	{
+		successors.swap(this->successors);
+		waiters.swap(this->waiters);
+	}
 
 	std::deque<FreeOCL::event_call_back> call_backs;
 	call_backs.swap(this->call_backs[new_status]);
+	if (!call_backs.empty())
+		dispatcher->push(this, new_status, call_backs);
 
+	const bool b_error = status < 0;
 	unlock();
 
-	if (!call_backs.empty())
-		for(std::deque<FreeOCL::event_call_back>::const_iterator i = call_backs.begin() ; i != call_backs.end() ; ++i)
-			if (i->pfn_notify)
-				i->pfn_notify(this, new_status, i->user_data);
+	if (!successors.empty())
+		notify_successors(successors, b_error);
+
+	for(std::deque<FreeOCL::wait_group*>::const_iterator i = waiters.begin() ; i != waiters.end() ; ++i)
+		(*i)->done(b_error);
 
 	wakeup();
 	lock();
 }
 
-_cl_event::_cl_event(cl_context context) : context_resource(context)
+_cl_event::_cl_event(cl_context context) : context_resource(context, FreeOCL::MAGIC_EVENT)
 {
-	FreeOCL::global_mutex.lock();
-	FreeOCL::valid_events.insert(this);
-	FreeOCL::global_mutex.unlock();
+	magic = FreeOCL::MAGIC_EVENT;
 }
 
 _cl_event::~_cl_event()
 {
+	// Commands still waiting for this event would never run otherwise
+	if (!successors.empty())
+	{
+		std::deque<FreeOCL::smartptr<FreeOCL::command> > successors;
+		successors.swap(this->successors);
+		notify_successors(successors, true);
+	}
+	for(std::deque<FreeOCL::wait_group*>::const_iterator i = waiters.begin() ; i != waiters.end() ; ++i)
+		(*i)->done(true);
 	wakeup();
-	FreeOCL::global_mutex.lock();
-	FreeOCL::valid_events.erase(this);
-	FreeOCL::global_mutex.unlock();
+	magic = 0;
+}
+
+namespace FreeOCL
+{
+	void wait_group::done(const bool b_error)
+	{
+		// The waiter may destroy the group as soon as the counter reaches
+		// zero, so everything is done under its lock
+		lock();
+		if (b_error)
+			this->b_error = true;
+		if (--counter == 0)
+			wakeup();
+		unlock();
+	}
+
+	void release_command_queue_later(cl_command_queue command_queue)
+	{
+		dispatcher->push(command_queue);
+	}
+
+	void stop_call_back_dispatcher()
+	{
+		dispatcher->stop();
+	}
 }
@@ -20,11 +20,14 @@
 
 #include "freeocl.h"
 #include "utils/condition.h"
+#include "utils/smartptr.h"
 #include <deque>
 #include <utils/map.h>
 
 namespace FreeOCL
 {
+	struct command_common;
+
 	struct event_call_back
 	{
 		void (CL_CALLBACK *pfn_notify)(cl_event event,
@@ -32,6 +35,27 @@ namespace FreeOCL
 									   void *user_data);
 		void *user_data;
 	};
+
+	// Lets a thread wait for several events at once: each event decrements
+	// the counter when it completes and only the last one wakes the waiter.
+	struct wait_group : public condition
+	{
+		inline wait_group() : counter(0), b_error(false)	{}
+
+		void done(const bool b_error);
+
+		volatile size_t counter;
+		volatile bool b_error;
+	};
+
+	// Releases a reference to a command queue on the callback dispatcher
+	// thread, for references held by objects the thread of the queue itself
+	// may destroy
+	void release_command_queue_later(cl_command_queue command_queue);
+
+	// Runs the pending callbacks and stops the callback dispatcher thread.
+	// Called by the device before it destroys its thread pool.
+	void stop_call_back_dispatcher();
 }
 
 struct _cl_event : public FreeOCL::icd_table, public FreeOCL::ref_counter, public FreeOCL::condition, public FreeOCL::valid_flag, public FreeOCL::context_resource
@@ -48,7 +72,14 @@ struct _cl_event : public FreeOCL::icd_table, public FreeOCL::ref_counter, publi
 	cl_ulong time_end;
 
 	FreeOCL::map<cl_int, std::deque<FreeOCL::event_call_back> > call_backs;
+	// Commands waiting for this event to complete
+	std::deque<FreeOCL::smartptr<FreeOCL::command_common> > successors;
+	// Threads blocked in clWaitForEvents on this event
+	std::deque<FreeOCL::wait_group*> waiters;
 
+	// Called and returns with the event locked, but unlocks it to notify
+	// successors and waiters. Waiters may release the event then, so the
+	// caller must hold a reference to it.
 	void change_status(cl_int new_status);
 };
 
@@ -27,6 +27,7 @@
 #include "kernel.h"
 #include "program.h"
 #include "sampler.h"
+#include "commandbuffer.h"
 #include "prototypes.h"
 #include <stdexcept>
 #include <algorithm>
@@ -54,84 +55,64 @@ namespace FreeOCL
 {
 	_cl_icd_dispatch init_dispatch();
 
-	FreeOCL::set<cl_context> valid_contexts;
-	FreeOCL::set<cl_command_queue> valid_command_queues;
-	FreeOCL::set<cl_mem> valid_mems;
-	FreeOCL::set<cl_event> valid_events;
-	FreeOCL::set<cl_kernel> valid_kernels;
-	FreeOCL::set<cl_program> valid_programs;
-	FreeOCL::set<cl_sampler> valid_samplers;
-	mutex global_mutex;
 	_cl_icd_dispatch dispatch = init_dispatch();
 
+	namespace
+	{
+		// Checks the magic value of the object header and locks it. The
+		// caller owns a reference on valid handles, so the object cannot be
+		// destroyed while it is being locked.
+		template<class T>
+		inline bool check_and_lock(T obj, const cl_uint magic)
+		{
+			if (obj == NULL || obj->magic != magic || !obj->valid())
+				return false;
+			obj->lock();
+			if (obj->magic == magic && obj->valid())
+				return true;
+			obj->unlock();
+			return false;
+		}
+	}
+
 	bool is_valid(cl_context c)
 	{
-		global_mutex.lock();
-		const bool r = valid_contexts.count(c) != 0 && c->valid();
-		if (r)
-			c->lock();
-		global_mutex.unlock();
-		return r;
+		return check_and_lock(c, MAGIC_CONTEXT);
 	}
 
 	bool is_valid(cl_command_queue q)
 	{
-		global_mutex.lock();
-		const bool r = valid_command_queues.count(q) != 0 && q->valid();
-		if (r)
-			q->lock();
-		global_mutex.unlock();
-		return r;
+		return check_and_lock(q, MAGIC_COMMAND_QUEUE);
 	}
 
 	bool is_valid(cl_mem m)
 	{
-		global_mutex.lock();
-		const bool r = valid_mems.count(m) != 0 && m->valid();
-		if (r)
-			m->lock();
-		global_mutex.unlock();
-		return r;
+		return check_and_lock(m, MAGIC_MEM);
 	}
 
 	bool is_valid(cl_event e)
 	{
-		global_mutex.lock();
-		const bool r = valid_events.count(e) != 0 && e->valid();
-		if (r)
-			e->lock();
-		global_mutex.unlock();
-		return r;
+		return check_and_lock(e, MAGIC_EVENT);
 	}
 
 	bool is_valid(cl_kernel k)
 	{
-		global_mutex.lock();
-		const bool r = valid_kernels.count(k) != 0 && k->valid();
-		if (r)
-			k->lock();
-		global_mutex.unlock();
-		return r;
+		return check_and_lock(k, MAGIC_KERNEL);
 	}
 
 	bool is_valid(cl_program p)
 	{
-		global_mutex.lock();
-		const bool r = valid_programs.count(p) != 0 && p->valid();
-		if (r)
-			p->lock();
-		global_mutex.unlock();
-		return r;
+		return check_and_lock(p, MAGIC_PROGRAM);
 	}
 
 	bool is_valid(cl_sampler s)
 	{
-		global_mutex.lock();
-		const bool r = valid_samplers.count(s) != 0 && s->valid();
-		if (r)
-			s->lock();
-		global_mutex.unlock();
-		return r;
+		return check_and_lock(s, MAGIC_SAMPLER);
+	}
+
+	bool is_valid(cl_command_buffer_khr cb)
+	{
+		return check_and_lock(cb, MAGIC_COMMAND_BUFFER);
 	}
 
 	bool is_valid(cl_device_id d)
@@ -371,8 +352,9 @@ namespace FreeOCL
 		return table;
 	}
 
-	context_resource::context_resource(cl_context context)
-		: context(context)
+	context_resource::context_resource(cl_context context, cl_uint resource_type)
+		: context(context),
+		  resource_type(resource_type)
 	{
 		if (context)
 		{
@@ -389,8 +371,7 @@ namespace FreeOCL
 		{
 			context->lock();
 			context->resources.erase(this);
-			context->release();
-			if (context->get_ref_count() > 0)
+			if (!context->release())
 				context->unlock();
 			else
 			{
@@ -440,8 +421,49 @@ extern "C"
 	{
 	#define ADD(name)	if (strcmp(funcname, #name) == 0)	return (void*)name
 
+	#define ADD_FCL(name)	if (strcmp(funcname, #name) == 0)	return (void*)name##FCL
+
 		ADD(clIcdGetPlatformIDsKHR);
 
+		// cl_khr_command_buffer
+		ADD_FCL(clCreateCommandBufferKHR);
+		ADD_FCL(clFinalizeCommandBufferKHR);
+		ADD_FCL(clRetainCommandBufferKHR);
+		ADD_FCL(clReleaseCommandBufferKHR);
+		ADD_FCL(clEnqueueCommandBufferKHR);
+		ADD_FCL(clCommandBarrierWithWaitListKHR);
+		ADD_FCL(clCommandCopyBufferKHR);
+		ADD_FCL(clCommandCopyBufferRectKHR);
+		ADD_FCL(clCommandFillBufferKHR);
+		ADD_FCL(clCommandNDRangeKernelKHR);
+		ADD_FCL(clGetCommandBufferInfoKHR);
+
+		// cl_intel_unified_shared_memory
+		ADD_FCL(clHostMemAllocINTEL);
+		ADD_FCL(clDeviceMemAllocINTEL);
+		ADD_FCL(clSharedMemAllocINTEL);
+		ADD_FCL(clMemFreeINTEL);
+		ADD_FCL(clMemBlockingFreeINTEL);
+		ADD_FCL(clGetMemAllocInfoINTEL);
+		ADD_FCL(clSetKernelArgMemPointerINTEL);
+		ADD_FCL(clEnqueueMemsetINTEL);
+		ADD_FCL(clEnqueueMemFillINTEL);
+		ADD_FCL(clEnqueueMemcpyINTEL);
+		ADD_FCL(clEnqueueMigrateMemINTEL);
+		ADD_FCL(clEnqueueMemAdviseINTEL);
+
+		ADD_FCL(clEnqueueNDRangeNativeKernelFREEOCL);
+		ADD_FCL(clEnqueueReadFileFREEOCL);
+		ADD_FCL(clEnqueueWriteFileFREEOCL);
+		ADD_FCL(clCreatePipeFREEOCL);
+		ADD_FCL(clGetPipeInfoFREEOCL);
+		ADD_FCL(clCreateBufferFromFileFREEOCL);
+		ADD_FCL(clEnqueueCloneBufferFREEOCL);
+		ADD_FCL(clExportBufferFREEOCL);
+		ADD_FCL(clImportBufferFREEOCL);
+		ADD_FCL(clEnqueueSignalFenceFREEOCL);
+		ADD_FCL(clEnqueueWaitFenceFREEOCL);
+
 		return NULL;
 	}
 }
@@ -24,6 +24,8 @@
 #include "utils/set.h"
 #include "utils/mutex.h"
 #include "dispatch.h"
+#include <CL/cl_ext.h>
+#include <CL/cl_freeocl.h>
 #include <iostream>
 #include <deque>
 
@@ -39,16 +41,22 @@ namespace FreeOCL
 {
 	extern cl_platform_id platform;
 	extern cl_device_id device;
-	extern FreeOCL::set<cl_context> valid_contexts;
-	extern FreeOCL::set<cl_command_queue> valid_command_queues;
-	extern FreeOCL::set<cl_mem> valid_mems;
-	extern FreeOCL::set<cl_event> valid_events;
-	extern FreeOCL::set<cl_kernel> valid_kernels;
-	extern FreeOCL::set<cl_program> valid_programs;
-	extern FreeOCL::set<cl_sampler> valid_samplers;
-	extern mutex global_mutex;
 	extern _cl_icd_dispatch dispatch;
 
+	// Values of icd_table::magic while an object is alive, used to validate
+	// handles without a global registry
+	enum
+	{
+		MAGIC_CONTEXT = 0xF0C10001,
+		MAGIC_COMMAND_QUEUE = 0xF0C10002,
+		MAGIC_MEM = 0xF0C10003,
+		MAGIC_EVENT = 0xF0C10004,
+		MAGIC_KERNEL = 0xF0C10005,
+		MAGIC_PROGRAM = 0xF0C10006,
+		MAGIC_SAMPLER = 0xF0C10007,
+		MAGIC_COMMAND_BUFFER = 0xF0C10008
+	};
+
 	bool is_valid(cl_context);
 	bool is_valid(cl_command_queue);
 	bool is_valid(cl_mem);
@@ -58,6 +66,7 @@ namespace FreeOCL
 	bool is_valid(cl_device_id);
 	bool is_valid(cl_platform_id);
 	bool is_valid(cl_sampler);
+	bool is_valid(cl_command_buffer_khr);
 
 	bool copy_memory_within_limits(const void *src, const size_t size, const size_t maxSize, void *dst, size_t *s);
 
@@ -75,8 +84,12 @@ namespace FreeOCL
 	struct icd_table
 	{
 		struct _cl_icd_dispatch *dispatch;
+		// Set by the object constructor once it is ready to be used and
+		// cleared by its destructor
+		volatile cl_uint magic;
 
-		inline icd_table() : dispatch(&FreeOCL::dispatch)	{}
+		inline icd_table() : dispatch(&FreeOCL::dispatch), magic(0)	{}
+		inline ~icd_table()	{	magic = 0;	}
 	};
 
 	struct ref_counter
@@ -84,8 +97,22 @@ namespace FreeOCL
 		inline ref_counter() : ref_count(1)	{}		// Implicit retain
 
 		inline const cl_uint &get_ref_count() const	{	return ref_count;	}
-		inline void retain()	{	++ref_count;	}
-		inline void release()	{	--ref_count;	}
+		inline void retain()	{	__sync_add_and_fetch(&ref_count, 1);	}
+		// Returns true when the last reference has been released
+		inline bool release()	{	return __sync_sub_and_fetch(&ref_count, 1) == 0;	}
+		// Fails instead of reviving an object whose last reference is gone
+		inline bool retain_if_alive()
+		{
+			cl_uint n = __sync_add_and_fetch(&ref_count, 0);
+			while (n > 0)
+			{
+				const cl_uint prev = __sync_val_compare_and_swap(&ref_count, n, n + 1);
+				if (prev == n)
+					return true;
+				n = prev;
+			}
+			return false;
+		}
 
 	private:
 		cl_uint ref_count;
@@ -104,11 +131,13 @@ namespace FreeOCL
 
 	struct context_resource
 	{
-		context_resource(cl_context);
+		context_resource(cl_context, cl_uint resource_type);
 
 		~context_resource();
 
 		const cl_context context;
+		// Magic value of the derived object type
+		const cl_uint resource_type;
 	};
 }
 
@@ -18,13 +18,29 @@
 #include "mem.h"
 #include "context.h"
 #include "utils/commandqueue.h"
+#include "utils/allocator.h"
 #include "device.h"
+#include "utils/memops.h"
 #include <cstring>
 #include "prototypes.h"
 
 #define SET_VAR(X)	FreeOCL::copy_memory_within_limits(&(X), sizeof(X), param_value_size, param_value, param_value_size_ret)
 #define SET_RET(X)	if (errcode_ret)	*errcode_ret = (X)
 
+namespace
+{
+	// Initializes an image created with CL_MEM_COPY_HOST_PTR, whose host
+	// pointer has the pitches of the image but not necessarily its layout
+	void copy_host_image(cl_mem image, const void *host_ptr)
+	{
+		const size_t origin[3] = { 0, 0, 0 };
+		const size_t region[3] = { image->width, image->height, image->depth };
+		FreeOCL::copy_image_rect(image->ptr, image->layout, origin,
+								 host_ptr, FreeOCL::linear_layout(image->element_size, image->row_pitch, image->slice_pitch), origin,
+								 region);
+	}
+}
+
 extern "C"
 {
 	cl_mem clCreateImageCommonFCL (cl_context context,
@@ -52,7 +68,8 @@ extern "C"
 			return 0;
 		}
 
-		if ((flags & CL_MEM_USE_HOST_PTR) && (flags & (CL_MEM_ALLOC_HOST_PTR | CL_MEM_COPY_HOST_PTR)))
+		if (((flags & CL_MEM_USE_HOST_PTR) && (flags & (CL_MEM_ALLOC_HOST_PTR | CL_MEM_COPY_HOST_PTR)))
+			|| !FreeOCL::check_alloc_flags(flags))
 		{
 			SET_RET(CL_INVALID_VALUE);
 			return 0;
@@ -202,21 +219,32 @@ extern "C"
 		mem->slice_pitch = image_slice_pitch;
 		mem->element_size = element_size;
 		mem->image_format = *image_format;
+		mem->layout = FreeOCL::linear_layout(element_size, image_row_pitch, image_slice_pitch);
+		if (FreeOCL::use_tiled_layout(flags))
+		{
+			const size_t tiled_size = FreeOCL::tile_layout(mem->layout, image_width, image_height, image_depth);
+			if (tiled_size)
+				mem->size = tiled_size;
+		}
 		if (flags & CL_MEM_USE_HOST_PTR)
 			mem->ptr = host_ptr;
-#ifdef FREEOCL_OS_WINDOWS
-        else if ((mem->ptr = __mingw_aligned_malloc(size, 256)) == NULL)
-#else
-		else if (posix_memalign(&(mem->ptr), 256, size) == ENOMEM)
-#endif
+		else if (!mem->reserve_storage(CL_MEMORY_KIND_IMAGES_FREEOCL))
+		{
+			SET_RET(CL_MEM_OBJECT_ALLOCATION_FAILURE);
+			delete mem;
+			return 0;
+		}
+		else if ((mem->ptr = FreeOCL::alloc_memory(mem->size, flags, mem->mapped_size)) == NULL)
 		{
 			SET_RET(CL_OUT_OF_RESOURCES);
 			delete mem;
 			return 0;
 		}
+		else
+			mem->storage = FreeOCL::STORAGE_ALLOCATED;
 
 		if (flags & CL_MEM_COPY_HOST_PTR)
-			memcpy(mem->ptr, host_ptr, size);
+			copy_host_image(mem, host_ptr);
 
 		SET_RET(CL_SUCCESS);
 
@@ -433,11 +461,11 @@ extern "C"
 				|| image->depth < origin[2] + region[2])
 			return CL_INVALID_VALUE;
 
-		if (row_pitch == 0)	row_pitch = image->width * image->element_size;
-		if (slice_pitch == 0)	slice_pitch = image->height * image->row_pitch;
+		if (row_pitch == 0)	row_pitch = region[0] * image->element_size;
+		if (slice_pitch == 0)	slice_pitch = region[1] * row_pitch;
 
-		if (row_pitch < image->width * image->element_size
-				|| slice_pitch < image->row_pitch * image->height)
+		if (row_pitch < region[0] * image->element_size
+				|| slice_pitch < row_pitch * region[1])
 			return CL_INVALID_VALUE;
 
 		if (blocking_read == CL_TRUE)
@@ -452,13 +480,12 @@ extern "C"
 		cmd->event_wait_list = event_wait_list;
 		cmd->event = (blocking_read == CL_TRUE || event) ? new _cl_event(command_queue->context) : NULL;
 		cmd->buffer = image;
-		cmd->offset = origin[0] * image->element_size + origin[1] * image->row_pitch + origin[2] * image->slice_pitch;
-		cmd->cb[0] = region[0] * image->element_size;
-		cmd->cb[1] = region[1];
-		cmd->cb[2] = region[2];
+		for(size_t i = 0 ; i < 3 ; ++i)
+		{
+			cmd->origin[i] = origin[i];
+			cmd->region[i] = region[i];
+		}
 		cmd->ptr = ptr;
-		cmd->buffer_pitch[0] = image->row_pitch;
-		cmd->buffer_pitch[1] = image->slice_pitch;
 		cmd->host_pitch[0] = row_pitch;
 		cmd->host_pitch[1] = slice_pitch;
 
@@ -533,11 +560,11 @@ extern "C"
 				|| image->depth < origin[2] + region[2])
 			return CL_INVALID_VALUE;
 
-		if (input_row_pitch == 0)	input_row_pitch = image->width * image->element_size;
-		if (input_slice_pitch == 0)	input_slice_pitch = image->height * image->row_pitch;
+		if (input_row_pitch == 0)	input_row_pitch = region[0] * image->element_size;
+		if (input_slice_pitch == 0)	input_slice_pitch = region[1] * input_row_pitch;
 
-		if (input_row_pitch < image->width * image->element_size
-				|| input_slice_pitch < image->row_pitch * image->height)
+		if (input_row_pitch < region[0] * image->element_size
+				|| input_slice_pitch < input_row_pitch * region[1])
 			return CL_INVALID_VALUE;
 
 		if (blocking_write == CL_TRUE)
@@ -552,13 +579,12 @@ extern "C"
 		cmd->event_wait_list = event_wait_list;
 		cmd->event = (blocking_write == CL_TRUE || event) ? new _cl_event(command_queue->context) : NULL;
 		cmd->buffer = image;
-		cmd->offset = origin[0] * image->element_size + origin[1] * image->row_pitch + origin[2] * image->slice_pitch;
-		cmd->cb[0] = region[0] * image->element_size;
-		cmd->cb[1] = region[1];
-		cmd->cb[2] = region[2];
+		for(size_t i = 0 ; i < 3 ; ++i)
+		{
+			cmd->origin[i] = origin[i];
+			cmd->region[i] = region[i];
+		}
 		cmd->ptr = ptr;
-		cmd->buffer_pitch[0] = image->row_pitch;
-		cmd->buffer_pitch[1] = image->slice_pitch;
 		cmd->host_pitch[0] = input_row_pitch;
 		cmd->host_pitch[1] = input_slice_pitch;
 
@@ -661,20 +687,15 @@ extern "C"
 		cmd->event_wait_list = event_wait_list;
 		cmd->event = event ? new _cl_event(command_queue->context) : NULL;
 		cmd->src_buffer = src_image;
-		cmd->src_offset = src_origin[0] * src_image->element_size
-						  + src_origin[1] * src_image->row_pitch
-						  + src_origin[2] * src_image->slice_pitch;
+		cmd->src_offset = 0;
 		cmd->dst_buffer = dst_image;
-		cmd->dst_offset = dst_origin[0] * dst_image->element_size
-						  + dst_origin[1] * dst_image->row_pitch
-						  + dst_origin[2] * dst_image->slice_pitch;
-		cmd->cb[0] = region[0] * src_image->element_size;
-		cmd->cb[1] = region[1];
-		cmd->cb[2] = region[2];
-		cmd->src_pitch[0] = src_image->row_pitch;
-		cmd->src_pitch[1] = src_image->slice_pitch;
-		cmd->dst_pitch[0] = dst_image->row_pitch;
-		cmd->dst_pitch[1] = dst_image->slice_pitch;
+		cmd->dst_offset = 0;
+		for(size_t i = 0 ; i < 3 ; ++i)
+		{
+			cmd->src_origin[i] = src_origin[i];
+			cmd->dst_origin[i] = dst_origin[i];
+			cmd->region[i] = region[i];
+		}
 
 		if (cmd->event)
 		{
@@ -739,6 +760,10 @@ extern "C"
 		if (!FreeOCL::is_valid(dst_buffer))
 			return CL_INVALID_MEM_OBJECT;
 		unlock.handle(dst_buffer);
+		if (dst_buffer->mem_type == CL_MEM_OBJECT_PIPE_FREEOCL)
+			return CL_INVALID_MEM_OBJECT;
+		if (dst_buffer->is_read_only_file())
+			return CL_INVALID_OPERATION;
 
 		if (dst_buffer->size < dst_offset + region[0] * region[1] * region[2] * src_image->element_size)
 			return CL_INVALID_VALUE;
@@ -748,18 +773,16 @@ extern "C"
 		cmd->event_wait_list = event_wait_list;
 		cmd->event = event ? new _cl_event(command_queue->context) : NULL;
 		cmd->src_buffer = src_image;
-		cmd->src_offset = src_origin[0] * src_image->element_size
-						  + src_origin[1] * src_image->row_pitch
-						  + src_origin[2] * src_image->slice_pitch;
+		cmd->src_offset = 0;
 		cmd->dst_buffer = dst_buffer;
+		dst_buffer->mark_written();
 		cmd->dst_offset = dst_offset;
-		cmd->cb[0] = region[0] * src_image->element_size;
-		cmd->cb[1] = region[1];
-		cmd->cb[2] = region[2];
-		cmd->src_pitch[0] = src_image->row_pitch;
-		cmd->src_pitch[1] = src_image->slice_pitch;
-		cmd->dst_pitch[0] = region[0] * src_image->element_size;
-		cmd->dst_pitch[1] = region[0] * region[1] * src_image->element_size;
+		for(size_t i = 0 ; i < 3 ; ++i)
+		{
+			cmd->src_origin[i] = src_origin[i];
+			cmd->dst_origin[i] = 0;
+			cmd->region[i] = region[i];
+		}
 
 		if (cmd->event)
 		{
@@ -807,6 +830,8 @@ extern "C"
 		if (!FreeOCL::is_valid(src_buffer))
 			return CL_INVALID_MEM_OBJECT;
 		unlock.handle(src_buffer);
+		if (src_buffer->mem_type == CL_MEM_OBJECT_PIPE_FREEOCL)
+			return CL_INVALID_MEM_OBJECT;
 
 		if (!FreeOCL::is_valid(dst_image))
 			return CL_INVALID_MEM_OBJECT;
@@ -835,16 +860,13 @@ extern "C"
 		cmd->src_buffer = src_buffer;
 		cmd->src_offset = src_offset;
 		cmd->dst_buffer = dst_image;
-		cmd->dst_offset = dst_origin[0] * dst_image->element_size
-						  + dst_origin[1] * dst_image->row_pitch
-						  + dst_origin[2] * dst_image->slice_pitch;
-		cmd->cb[0] = region[0] * dst_image->element_size;
-		cmd->cb[1] = region[1];
-		cmd->cb[2] = region[2];
-		cmd->src_pitch[0] = region[0] * dst_image->element_size;
-		cmd->src_pitch[1] = region[0] * region[1] * dst_image->element_size;
-		cmd->dst_pitch[0] = dst_image->row_pitch;
-		cmd->dst_pitch[1] = dst_image->slice_pitch;
+		cmd->dst_offset = 0;
+		for(size_t i = 0 ; i < 3 ; ++i)
+		{
+			cmd->src_origin[i] = 0;
+			cmd->dst_origin[i] = dst_origin[i];
+			cmd->region[i] = region[i];
+		}
 
 		if (cmd->event)
 		{
@@ -934,15 +956,43 @@ extern "C"
 			return NULL;
 		}
 
-		*image_row_pitch = image->row_pitch;
-		if (image_slice_pitch)
-			*image_slice_pitch = (image->mem_type == CL_MEM_OBJECT_IMAGE2D) ? 0 : image->slice_pitch;
-
-		void *p = (char*)image->ptr
-				  + image->element_size * origin[0]
-				  + image->row_pitch * origin[1]
-				  + image->slice_pitch * origin[2];
-		if (num_events_in_wait_list == 0 || event_wait_list == NULL)
+		void *p;
+		if (image->layout.is_tiled())
+		{
+			// Tiled images are mapped through a linear copy of the region,
+			// loaded by the map command so that it follows previous commands
+			FreeOCL::image_mapping mapping;
+			for(size_t i = 0 ; i < 3 ; ++i)
+			{
+				mapping.origin[i] = origin[i];
+				mapping.region[i] = region[i];
+			}
+			mapping.row_pitch = region[0] * image->element_size;
+			mapping.slice_pitch = region[1] * mapping.row_pitch;
+			mapping.map_flags = map_flags;
+			p = malloc(std::max<size_t>(1, region[2] * mapping.slice_pitch));
+			if (p == NULL)
+			{
+				SET_RET(CL_OUT_OF_HOST_MEMORY);
+				return NULL;
+			}
+			image->image_mappings[p] = mapping;
+			*image_row_pitch = mapping.row_pitch;
+			if (image_slice_pitch)
+				*image_slice_pitch = (image->mem_type == CL_MEM_OBJECT_IMAGE2D) ? 0 : mapping.slice_pitch;
+		}
+		else
+		{
+			*image_row_pitch = image->row_pitch;
+			if (image_slice_pitch)
+				*image_slice_pitch = (image->mem_type == CL_MEM_OBJECT_IMAGE2D) ? 0 : image->slice_pitch;
+
+			p = (char*)image->ptr
+				+ image->element_size * origin[0]
+				+ image->row_pitch * origin[1]
+				+ image->slice_pitch * origin[2];
+		}
+		if (!image->layout.is_tiled() && (num_events_in_wait_list == 0 || event_wait_list == NULL))
 		{
 			image->mapped.insert(p);
 			if (event)
@@ -1205,7 +1255,8 @@ extern "C"
 			return 0;
 		}
 
-		if ((flags & CL_MEM_USE_HOST_PTR) && (flags & (CL_MEM_ALLOC_HOST_PTR | CL_MEM_COPY_HOST_PTR)))
+		if (((flags & CL_MEM_USE_HOST_PTR) && (flags & (CL_MEM_ALLOC_HOST_PTR | CL_MEM_COPY_HOST_PTR)))
+			|| !FreeOCL::check_alloc_flags(flags))
 		{
 			SET_RET(CL_INVALID_VALUE);
 			return 0;
@@ -1370,28 +1421,42 @@ extern "C"
 		mem->slice_pitch = image_slice_pitch;
 		mem->element_size = element_size;
 		mem->image_format = *image_format;
+		mem->layout = FreeOCL::linear_layout(element_size, image_row_pitch, image_slice_pitch);
+		if ((image_desc->image_type == CL_MEM_OBJECT_IMAGE2D || image_desc->image_type == CL_MEM_OBJECT_IMAGE3D)
+			&& FreeOCL::use_tiled_layout(flags))
+		{
+			const size_t tiled_size = FreeOCL::tile_layout(mem->layout, image_width, image_height, image_depth);
+			if (tiled_size)
+				mem->size = tiled_size;
+		}
 		if (image_desc->image_type == CL_MEM_OBJECT_IMAGE1D_BUFFER)
 		{
 			mem->ptr = image_desc->buffer->ptr;
+			// Writes to the image can't be told apart from writes to the buffer
+			image_desc->buffer->mark_written();
 		}
 		else
 		{
 			if (flags & CL_MEM_USE_HOST_PTR)
 				mem->ptr = host_ptr;
-#ifdef FREEOCL_OS_WINDOWS
-            else if ((mem->ptr = __mingw_aligned_malloc(size, 256)) == NULL)
-#else
-			else if (posix_memalign(&(mem->ptr), 256, size) == ENOMEM)
-#endif
+			else if (!mem->reserve_storage(CL_MEMORY_KIND_IMAGES_FREEOCL))
+			{
+				SET_RET(CL_MEM_OBJECT_ALLOCATION_FAILURE);
+				delete mem;
+				return 0;
+			}
+			else if ((mem->ptr = FreeOCL::alloc_memory(mem->size, flags, mem->mapped_size)) == NULL)
 			{
 				SET_RET(CL_OUT_OF_RESOURCES);
 				delete mem;
 				return 0;
 			}
+			else
+				mem->storage = FreeOCL::STORAGE_ALLOCATED;
 		}
 
 		if (flags & CL_MEM_COPY_HOST_PTR)
-			memcpy(mem->ptr, host_ptr, size);
+			copy_host_image(mem, host_ptr);
 
 		SET_RET(CL_SUCCESS);
 
@@ -1452,14 +1517,13 @@ extern "C"
 		cmd->event_wait_list = event_wait_list;
 		cmd->event = event ? new _cl_event(command_queue->context) : NULL;
 		cmd->buffer = image;
-		cmd->offset = origin[0] * image->element_size + origin[1] * image->row_pitch + origin[2] * image->slice_pitch;
-		cmd->cb[0] = region[0] * image->element_size;
-		cmd->cb[1] = region[1];
-		cmd->cb[2] = region[2];
+		for(size_t i = 0 ; i < 3 ; ++i)
+		{
+			cmd->origin[i] = origin[i];
+			cmd->region[i] = region[i];
+		}
 		cmd->fill_color = malloc(sizeof(cl_float4));
 		memcpy(cmd->fill_color, fill_color, sizeof(cl_float4));
-		cmd->buffer_pitch[0] = image->row_pitch;
-		cmd->buffer_pitch[1] = image->slice_pitch;
 
 		if (cmd->event)
 		{
@@ -1527,10 +1591,6 @@ namespace FreeOCL
 
 	void command_fill_image::process() const
 	{
-		char *dst_ptr = (char*)buffer->ptr + offset;
-		const size_t dst_row_pitch = buffer_pitch[0];
-		const size_t dst_slice_pitch = buffer_pitch[1] - dst_row_pitch * cb[1];
-
 		cl_uchar data[16];
 		memset(data, 0, sizeof(cl_uchar));
 
@@ -1626,45 +1686,49 @@ namespace FreeOCL
 			break;
 		}
 
-		const size_t n = cb[0] / buffer->element_size;
+		FreeOCL::fill_image_rect(buffer->ptr, buffer->layout, origin, region, data);
+	}
+
+	void load_image_mapping(cl_mem image, void *ptr)
+	{
+		image->lock();
+		const std::map<void*, image_mapping>::const_iterator it = image->image_mappings.find(ptr);
+		if (it == image->image_mappings.end())
+		{
+			image->unlock();
+			return;
+		}
+		const image_mapping mapping = it->second;
+		image->unlock();
+
+		if (mapping.map_flags & CL_MAP_WRITE_INVALIDATE_REGION)
+			return;
+		const size_t zero[3] = { 0, 0, 0 };
+		copy_image_rect(ptr, linear_layout(image->element_size, mapping.row_pitch, mapping.slice_pitch), zero,
+						image->ptr, image->layout, mapping.origin,
+						mapping.region);
+	}
+
+	void unload_image_mapping(cl_mem image, void *ptr)
+	{
+		image->lock();
+		const std::map<void*, image_mapping>::iterator it = image->image_mappings.find(ptr);
+		if (it == image->image_mappings.end())
+		{
+			image->unlock();
+			return;
+		}
+		const image_mapping mapping = it->second;
+		image->image_mappings.erase(it);
+		image->unlock();
 
-		switch(buffer->element_size)
+		if (mapping.map_flags & (CL_MAP_WRITE | CL_MAP_WRITE_INVALIDATE_REGION))
 		{
-		case 1:
-			for(size_t z = 0 ; z < cb[2] ; ++z, dst_ptr += dst_slice_pitch)
-				for(size_t y = 0 ; y < cb[1] ; ++y, dst_ptr += dst_row_pitch)
-					memset(dst_ptr, data[0], n);
-			break;
-		case 2:
-			for(size_t z = 0 ; z < cb[2] ; ++z, dst_ptr += dst_slice_pitch)
-				for(size_t y = 0 ; y < cb[1] ; ++y, dst_ptr += dst_row_pitch)
-					for(size_t x = 0 ; x < n ; ++x)
-						((cl_ushort*)dst_ptr)[x] = *((const cl_ushort*)data);
-			break;
-		case 4:
-			for(size_t z = 0 ; z < cb[2] ; ++z, dst_ptr += dst_slice_pitch)
-				for(size_t y = 0 ; y < cb[1] ; ++y, dst_ptr += dst_row_pitch)
-					for(size_t x = 0 ; x < n ; ++x)
-						((cl_uint*)dst_ptr)[x] = *((const cl_uint*)data);
-			break;
-		case 8:
-			for(size_t z = 0 ; z < cb[2] ; ++z, dst_ptr += dst_slice_pitch)
-				for(size_t y = 0 ; y < cb[1] ; ++y, dst_ptr += dst_row_pitch)
-					for(size_t x = 0 ; x < n ; ++x)
-						((cl_ulong*)dst_ptr)[x] = *((const cl_ulong*)data);
-			break;
-		case 16:
-			for(size_t z = 0 ; z < cb[2] ; ++z, dst_ptr += dst_slice_pitch)
-				for(size_t y = 0 ; y < cb[1] ; ++y, dst_ptr += dst_row_pitch)
-					for(size_t x = 0 ; x < n ; ++x)
-						((cl_uint4*)dst_ptr)[x] = *((const cl_uint4*)data);
-			break;
-		default:
-			for(size_t z = 0 ; z < cb[2] ; ++z, dst_ptr += dst_slice_pitch)
-				for(size_t y = 0 ; y < cb[1] ; ++y, dst_ptr += dst_row_pitch)
-					for(size_t x = 0 ; x < n ; ++x)
-						memcpy(dst_ptr + x * buffer->element_size, data, buffer->element_size);
-			break;
+			const size_t zero[3] = { 0, 0, 0 };
+			copy_image_rect(image->ptr, image->layout, mapping.origin,
+							ptr, linear_layout(image->element_size, mapping.row_pitch, mapping.slice_pitch), zero,
+							mapping.region);
 		}
+		free(ptr);
 	}
 }
@@ -25,6 +25,7 @@
 #include "sampler.h"
 #include <cstdlib>
 #include <cstring>
+#include <algorithm>
 #include <dlfcn.h>
 #include "prototypes.h"
 
@@ -39,6 +40,7 @@ namespace
 		size_t width;
 		size_t element_size;
 		void *data;
+		const void *access;	// chosen by __FCL_init
 	};
 
 	typedef image1d_t image1d_buffer_t;
@@ -51,6 +53,7 @@ namespace
 		size_t row_pitch;
 		size_t element_size;
 		void *data;
+		const void *access;	// chosen by __FCL_init
 	};
 
 	struct image2d_t
@@ -60,7 +63,9 @@ namespace
 		size_t width, height;
 		size_t row_pitch;
 		size_t element_size;
+		cl_uint tile_shift_x, tile_shift_y;
 		void *data;
+		const void *access;	// chosen by __FCL_init
 	};
 
 	struct image2d_array_t
@@ -71,6 +76,7 @@ namespace
 		size_t row_pitch, slice_pitch;
 		size_t element_size;
 		void *data;
+		const void *access;	// chosen by __FCL_init
 	};
 	struct image3d_t
 	{
@@ -79,7 +85,9 @@ namespace
 		size_t width, height, depth;
 		size_t row_pitch, slice_pitch;
 		size_t element_size;
+		cl_uint tile_shift_x, tile_shift_y, tile_shift_z;
 		void *data;
+		const void *access;	// chosen by __FCL_init
 	};
 }
 
@@ -138,17 +146,14 @@ extern "C"
 		cmd->event_wait_list = event_wait_list;
 
 		cmd->user_func = user_func;
-		cmd->args = malloc(cb_args);
-		memcpy(cmd->args, args, cb_args);
+		cmd->set_args(args, cb_args);
 		for(size_t i = 0 ; i < num_mem_objects ; ++i)
 		{
 			if (!FreeOCL::is_valid(mem_list[i]))
-			{
-				free(cmd->args);
 				return CL_INVALID_MEM_OBJECT;
-			}
 			const ptrdiff_t offset = (char*)args_mem_loc[i] - (char*)args;
 			*((void**)((char*)cmd->args + offset)) = mem_list[i]->ptr;
+			mem_list[i]->mark_written();
 			mem_list[i]->unlock();
 		}
 
@@ -167,6 +172,101 @@ extern "C"
 		return CL_SUCCESS;
 	}
 
+	cl_int clEnqueueNDRangeNativeKernelFREEOCLFCL (cl_command_queue command_queue,
+												   cl_native_ndrange_func_freeocl user_func,
+												   void *args,
+												   size_t cb_args,
+												   cl_uint num_mem_objects,
+												   const cl_mem *mem_list,
+												   const void **args_mem_loc,
+												   cl_uint work_dim,
+												   const size_t *global_work_offset,
+												   const size_t *global_work_size,
+												   const size_t *local_work_size,
+												   cl_uint num_events_in_wait_list,
+												   const cl_event *event_wait_list,
+												   cl_event *event)
+	{
+		MSG(clEnqueueNDRangeNativeKernelFREEOCLFCL);
+		if (user_func == NULL
+			|| (args == NULL && cb_args + num_mem_objects > 0)
+			|| (cb_args == 0 && args != NULL)
+			|| (num_mem_objects > 0 && (mem_list == NULL || args_mem_loc == NULL))
+			|| (num_mem_objects == 0 && (mem_list != NULL || args_mem_loc != NULL)))
+			return CL_INVALID_VALUE;
+
+		if (work_dim < 1 || work_dim > 3)
+			return CL_INVALID_WORK_DIMENSION;
+
+		if (global_work_size == NULL)
+			return CL_INVALID_GLOBAL_WORK_SIZE;
+		for(size_t i = 0 ; i < work_dim ; ++i)
+		{
+			if (global_work_size[i] == 0)
+				return CL_INVALID_GLOBAL_WORK_SIZE;
+			if (local_work_size && (local_work_size[i] == 0 || global_work_size[i] % local_work_size[i]))
+				return CL_INVALID_WORK_GROUP_SIZE;
+		}
+
+		if ((event_wait_list == NULL && num_events_in_wait_list > 0)
+			|| (event_wait_list != NULL && num_events_in_wait_list == 0))
+			return CL_INVALID_EVENT_WAIT_LIST;
+
+		FreeOCL::unlocker unlock;
+		if (!FreeOCL::is_valid(command_queue))
+			return CL_INVALID_COMMAND_QUEUE;
+		unlock.handle(command_queue);
+
+		FreeOCL::smartptr<FreeOCL::command_ndrange_native_kernel> cmd = new FreeOCL::command_ndrange_native_kernel;
+		cmd->num_events_in_wait_list = num_events_in_wait_list;
+		cmd->event_wait_list = event_wait_list;
+		cmd->user_func = user_func;
+		cmd->dim = work_dim;
+		for(size_t i = 0 ; i < 3 ; ++i)
+		{
+			cmd->global_size[i] = i < work_dim ? global_work_size[i] : 1;
+			cmd->global_offset[i] = (i < work_dim && global_work_offset) ? global_work_offset[i] : 0;
+			if (local_work_size)
+				cmd->local_size[i] = i < work_dim ? local_work_size[i] : 1;
+			else
+				cmd->local_size[i] = cmd->global_size[i];
+		}
+		if (local_work_size == NULL)
+		{
+			// Split the outermost dimension so all cores get enough
+			// work-groups, the last one may be smaller
+			const size_t nb_groups = command_queue->device->cpu_cores * 4;
+			const size_t d = work_dim - 1;
+			cmd->local_size[d] = std::max<size_t>(1, (cmd->global_size[d] + nb_groups - 1) / nb_groups);
+		}
+
+		if (cb_args > 0)
+			cmd->set_args(args, cb_args);
+		for(size_t i = 0 ; i < num_mem_objects ; ++i)
+		{
+			if (!FreeOCL::is_valid(mem_list[i]))
+				return CL_INVALID_MEM_OBJECT;
+			const ptrdiff_t offset = (char*)args_mem_loc[i] - (char*)args;
+			*((void**)((char*)cmd->args + offset)) = mem_list[i]->ptr;
+			mem_list[i]->mark_written();
+			mem_list[i]->unlock();
+		}
+
+		cmd->event = (event != NULL) ? new _cl_event(command_queue->context) : NULL;
+		if (cmd->event)
+		{
+			*event = cmd->event.weak();
+			cmd->event->command_queue = command_queue;
+			cmd->event->command_type = CL_COMMAND_NDRANGE_NATIVE_KERNEL_FREEOCL;
+			cmd->event->status = CL_SUBMITTED;
+		}
+
+		unlock.forget(command_queue);
+		command_queue->enqueue(cmd);
+
+		return CL_SUCCESS;
+	}
+
 	cl_kernel clCreateKernelFCL (cl_program program,
 							  const char *kernel_name,
 							  cl_int *errcode_ret)
@@ -231,8 +331,7 @@ extern "C"
 			offset += s;
 		}
 		kernel->args_buffer.resize(offset);
-
-		program->retain();
+		program->context->memory.add(CL_MEMORY_KIND_KERNEL_ARGS_FREEOCL, offset);
 
 		SET_RET(CL_SUCCESS);
 
@@ -295,12 +394,10 @@ extern "C"
 		MSG(clReleaseKernelFCL);
 		if (!FreeOCL::is_valid(kernel))
 			return CL_INVALID_KERNEL;
-		kernel->release();
-		if (kernel->get_ref_count() == 0)
+		if (kernel->release())
 		{
 			kernel->invalidate();
 			kernel->unlock();
-			clReleaseProgramFCL(kernel->program);
 			delete kernel;
 		}
 		else
@@ -338,6 +435,12 @@ extern "C"
 					if (!FreeOCL::is_valid(mem_object))
 						return CL_INVALID_MEM_OBJECT;
 					unlock.handle(mem_object);
+					// A pipe is only reachable through read_pipe/write_pipe
+					if (mem_object->mem_type == CL_MEM_OBJECT_PIPE_FREEOCL)
+						return CL_INVALID_MEM_OBJECT;
+					if (kernel->args_type[arg_index] == CL_KERNEL_ARG_ADDRESS_GLOBAL
+						&& !(kernel->args_qualifier[arg_index] & CL_KERNEL_ARG_TYPE_CONST))
+						mem_object->mark_written();
 					memcpy(&(kernel->args_buffer[kernel->args_offset[arg_index]]), &(mem_object->ptr), arg_size);
 				}
 			}
@@ -403,6 +506,7 @@ extern "C"
 				img.width = image->width;
 				img.element_size = image->element_size;
 				img.data = image->ptr;
+				img.access = NULL;
 
 				memcpy(&(kernel->args_buffer[kernel->args_offset[arg_index]]), &img, sizeof(img));
 			}
@@ -427,6 +531,7 @@ extern "C"
 				img.width = image->width;
 				img.element_size = image->element_size;
 				img.data = image->ptr;
+				img.access = NULL;
 
 				memcpy(&(kernel->args_buffer[kernel->args_offset[arg_index]]), &img, sizeof(img));
 			}
@@ -453,6 +558,7 @@ extern "C"
 				img.row_pitch = image->row_pitch;
 				img.element_size = image->element_size;
 				img.data = image->ptr;
+				img.access = NULL;
 
 				memcpy(&(kernel->args_buffer[kernel->args_offset[arg_index]]), &img, sizeof(img));
 			}
@@ -476,9 +582,12 @@ extern "C"
 				img.channel_order = image->image_format.image_channel_order;
 				img.width = image->width;
 				img.height = image->height;
-				img.row_pitch = image->row_pitch;
+				img.row_pitch = image->layout.row_pitch;
 				img.element_size = image->element_size;
+				img.tile_shift_x = image->layout.tile_shift[0];
+				img.tile_shift_y = image->layout.tile_shift[1];
 				img.data = image->ptr;
+				img.access = NULL;
 
 				memcpy(&(kernel->args_buffer[kernel->args_offset[arg_index]]), &img, sizeof(img));
 			}
@@ -507,6 +616,7 @@ extern "C"
 				img.slice_pitch = image->slice_pitch;
 				img.element_size = image->element_size;
 				img.data = image->ptr;
+				img.access = NULL;
 
 				memcpy(&(kernel->args_buffer[kernel->args_offset[arg_index]]), &img, sizeof(img));
 			}
@@ -531,14 +641,36 @@ extern "C"
 				img.width = image->width;
 				img.height = image->height;
 				img.depth = image->depth;
-				img.row_pitch = image->row_pitch;
-				img.slice_pitch = image->slice_pitch;
+				img.row_pitch = image->layout.row_pitch;
+				img.slice_pitch = image->layout.slice_pitch;
 				img.element_size = image->element_size;
+				img.tile_shift_x = image->layout.tile_shift[0];
+				img.tile_shift_y = image->layout.tile_shift[1];
+				img.tile_shift_z = image->layout.tile_shift[2];
 				img.data = image->ptr;
+				img.access = NULL;
 
 				memcpy(&(kernel->args_buffer[kernel->args_offset[arg_index]]), &img, sizeof(img));
 			}
 			break;
+		case CL_MEM_OBJECT_PIPE_FREEOCL:
+			if (arg_value == NULL || *(cl_mem*)arg_value == NULL)
+				return CL_INVALID_ARG_VALUE;
+			else
+			{
+				if (arg_size != sizeof(cl_mem))
+					return CL_INVALID_ARG_SIZE;
+				cl_mem pipe = *(cl_mem*)arg_value;
+				if (!FreeOCL::is_valid(pipe))
+					return CL_INVALID_MEM_OBJECT;
+				unlock.handle(pipe);
+				if (pipe->mem_type != CL_MEM_OBJECT_PIPE_FREEOCL)
+					return CL_INVALID_MEM_OBJECT;
+
+				// Kernels get a pointer to the ring header
+				memcpy(&(kernel->args_buffer[kernel->args_offset[arg_index]]), &(pipe->ptr), sizeof(void*));
+			}
+			break;
 		default:
 			if (kernel->args_size[arg_index] != arg_size)
 				return CL_INVALID_ARG_SIZE;
@@ -575,7 +707,7 @@ extern "C"
 			break;
 		case CL_KERNEL_REFERENCE_COUNT:	bTooSmall = SET_VAR(kernel->get_ref_count());	break;
 		case CL_KERNEL_CONTEXT:			bTooSmall = SET_VAR(kernel->program->context);	break;
-		case CL_KERNEL_PROGRAM:			bTooSmall = SET_VAR(kernel->program);	break;
+		case CL_KERNEL_PROGRAM:			bTooSmall = SET_VAR(kernel->program.weak());	break;
 		case CL_KERNEL_ATTRIBUTES:
 			//! \todo implement kernel attributes
 			bTooSmall = SET_VAR("");
@@ -709,13 +841,7 @@ extern "C"
 			cmd->global_offset[i] = global_work_offset ? global_work_offset[i] : 0;
 			cmd->local_size[i] = local_work_size[i];
 		}
-		if (kernel->args_buffer.empty())
-			cmd->args = NULL;
-		else
-		{
-			cmd->args = malloc(kernel->args_buffer.size());
-			memcpy(cmd->args, &(kernel->args_buffer.front()), kernel->args_buffer.size());
-		}
+		cmd->set_args();
 
 		if (event)
 		{
@@ -804,19 +930,14 @@ extern "C"
 
 _cl_kernel::_cl_kernel()
 {
-	FreeOCL::global_mutex.lock();
-	FreeOCL::valid_kernels.insert(this);
-	FreeOCL::global_mutex.unlock();
+	magic = FreeOCL::MAGIC_KERNEL;
 }
 
 _cl_kernel::~_cl_kernel()
 {
-	if (FreeOCL::is_valid(program))
-	{
-		program->kernels_attached--;
-		program->unlock();
-	}
-	FreeOCL::global_mutex.lock();
-	FreeOCL::valid_kernels.erase(this);
-	FreeOCL::global_mutex.unlock();
+	program->context->memory.release(CL_MEMORY_KIND_KERNEL_ARGS_FREEOCL, args_buffer.size());
+	program->lock();
+	program->kernels_attached--;
+	program->unlock();
+	magic = 0;
 }
@@ -19,6 +19,7 @@
 #define __FREEOCL_KERNEL_H__
 
 #include "freeocl.h"
+#include "utils/smartptr.h"
 #include <string>
 #include <vector>
 #include <ucontext.h>
@@ -29,7 +30,9 @@
 
 struct _cl_kernel : public FreeOCL::icd_table, public FreeOCL::ref_counter, public FreeOCL::mutex, public FreeOCL::valid_flag
 {
-	cl_program program;
+	// Retained by the kernel, which decrements its kernels_attached when
+	// it is destroyed
+	FreeOCL::smartptr<_cl_program> program;
 	std::string function_name;
 
 	size_t (*__FCL_info)(size_t, int*, const char **, const char **, int *, int *);
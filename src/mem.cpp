@@ -18,16 +18,168 @@
 #include "mem.h"
 #include "context.h"
 #include "utils/commandqueue.h"
+#include "utils/allocator.h"
+#include "utils/memops.h"
 #include "event.h"
 #include "device.h"
 #include <cstring>
+#include <cstdlib>
 #include <iostream>
 #include <algorithm>
+#include <cerrno>
+#ifndef FREEOCL_OS_WINDOWS
+#include <sys/stat.h>
+#include <fcntl.h>
+#endif
 #include "prototypes.h"
 
 #define SET_VAR(X)	FreeOCL::copy_memory_within_limits(&(X), sizeof(X), param_value_size, param_value, param_value_size_ret)
 #define SET_RET(X)	if (errcode_ret)	*errcode_ret = (X)
 
+namespace
+{
+	// Common part of clEnqueueReadFileFREEOCL and clEnqueueWriteFileFREEOCL
+	cl_int enqueue_file_io(const bool b_read,
+						   cl_command_queue command_queue,
+						   cl_mem buffer,
+						   cl_bool blocking,
+						   size_t offset,
+						   size_t cb,
+						   int fd,
+						   cl_ulong file_offset,
+						   cl_uint num_events_in_wait_list,
+						   const cl_event *event_wait_list,
+						   cl_event *event)
+	{
+#ifdef FREEOCL_OS_WINDOWS
+		return CL_INVALID_OPERATION;
+#else
+		FreeOCL::unlocker unlock;
+		if (fd < 0 || cb == 0)
+			return CL_INVALID_VALUE;
+
+		if (!FreeOCL::is_valid(command_queue))
+			return CL_INVALID_COMMAND_QUEUE;
+		unlock.handle(command_queue);
+
+		if (!FreeOCL::is_valid(buffer))
+			return CL_INVALID_MEM_OBJECT;
+		unlock.handle(buffer);
+		if (buffer->mem_type == CL_MEM_OBJECT_PIPE_FREEOCL)
+			return CL_INVALID_MEM_OBJECT;
+
+		if (buffer->context != command_queue->context)
+			return CL_INVALID_CONTEXT;
+
+		if (buffer->size < offset + cb)
+			return CL_INVALID_VALUE;
+
+		// Reading the file writes the buffer from the host and the other way
+		// around
+		if (buffer->flags & (CL_MEM_HOST_NO_ACCESS | (b_read ? CL_MEM_HOST_READ_ONLY : CL_MEM_HOST_WRITE_ONLY)))
+			return CL_INVALID_OPERATION;
+
+		if ((event_wait_list == NULL && num_events_in_wait_list > 0)
+			|| (event_wait_list != NULL && num_events_in_wait_list == 0))
+			return CL_INVALID_EVENT_WAIT_LIST;
+
+		FreeOCL::smartptr<FreeOCL::command_read_file> cmd = b_read ? new FreeOCL::command_read_file : new FreeOCL::command_write_file;
+		cmd->num_events_in_wait_list = num_events_in_wait_list;
+		cmd->event_wait_list = event_wait_list;
+		cmd->event = (blocking == CL_TRUE || event) ? new _cl_event(command_queue->context) : NULL;
+		cmd->buffer = buffer;
+		if (b_read)
+			buffer->mark_written();
+		cmd->offset = offset;
+		cmd->cb = cb;
+		cmd->fd = fd;
+		cmd->file_offset = file_offset;
+
+		if (cmd->event)
+		{
+			cmd->event->command_queue = command_queue;
+			cmd->event->command_type = cmd->get_type();
+			cmd->event->status = CL_QUEUED;
+		}
+
+		if (event)
+			*event = cmd->event.weak();
+
+		unlock.forget(command_queue);
+		command_queue->enqueue(cmd);
+
+		unlock.unlockall();
+
+		if (blocking == CL_TRUE)
+		{
+			const cl_int err = clWaitForEventsFCL(1, &(cmd->event.weak()));
+			const cl_int status = cmd->event->status;
+			if (event == NULL)
+				clReleaseEventFCL(cmd->event.weak());
+			// Report I/O errors of blocking calls directly
+			if (status < 0)
+				return status == CL_FILE_IO_ERROR_FREEOCL ? status : err;
+		}
+
+		return CL_SUCCESS;
+#endif
+	}
+
+	// Common part of clEnqueueSignalFenceFREEOCL and clEnqueueWaitFenceFREEOCL
+	cl_int enqueue_fence(const cl_command_type type,
+						 cl_command_queue command_queue,
+						 cl_mem buffer,
+						 cl_uint value,
+						 cl_uint num_events_in_wait_list,
+						 const cl_event *event_wait_list,
+						 cl_event *event)
+	{
+		FreeOCL::unlocker unlock;
+		if (!FreeOCL::is_valid(command_queue))
+			return CL_INVALID_COMMAND_QUEUE;
+		unlock.handle(command_queue);
+
+		if (!FreeOCL::is_valid(buffer))
+			return CL_INVALID_MEM_OBJECT;
+		unlock.handle(buffer);
+
+		if (buffer->context != command_queue->context)
+			return CL_INVALID_CONTEXT;
+
+		// Sub-buffers share the fence of their buffer
+		const cl_mem root = buffer->parent ? buffer->parent : buffer;
+		if (root->storage != FreeOCL::STORAGE_SHAREABLE)
+			return CL_INVALID_MEM_OBJECT;
+
+		if ((event_wait_list == NULL && num_events_in_wait_list > 0)
+			|| (event_wait_list != NULL && num_events_in_wait_list == 0))
+			return CL_INVALID_EVENT_WAIT_LIST;
+
+		FreeOCL::smartptr<FreeOCL::command_fence> cmd = new FreeOCL::command_fence;
+		cmd->num_events_in_wait_list = num_events_in_wait_list;
+		cmd->event_wait_list = event_wait_list;
+		cmd->event = event ? new _cl_event(command_queue->context) : NULL;
+		cmd->buffer = root;
+		cmd->value = value;
+		cmd->type = type;
+
+		if (cmd->event)
+		{
+			cmd->event->command_queue = command_queue;
+			cmd->event->command_type = type;
+			cmd->event->status = CL_QUEUED;
+		}
+
+		if (event)
+			*event = cmd->event.weak();
+
+		unlock.forget(command_queue);
+		command_queue->enqueue(cmd);
+
+		return CL_SUCCESS;
+	}
+}
+
 extern "C"
 {
 	cl_mem clCreateBufferFCL (cl_context context,
@@ -64,7 +216,8 @@ extern "C"
 		}
 
 		if (((flags & CL_MEM_HOST_NO_ACCESS) && (flags & (CL_MEM_HOST_READ_ONLY | CL_MEM_HOST_WRITE_ONLY)))
-			|| ((flags & CL_MEM_HOST_READ_ONLY) && (flags & CL_MEM_HOST_WRITE_ONLY)))
+			|| ((flags & CL_MEM_HOST_READ_ONLY) && (flags & CL_MEM_HOST_WRITE_ONLY))
+			|| !FreeOCL::check_alloc_flags(flags))
 		{
 			SET_RET(CL_INVALID_VALUE);
 			return 0;
@@ -85,25 +238,404 @@ extern "C"
 		mem->host_ptr = host_ptr;
 		mem->parent = NULL;
 		mem->offset = 0;
+		if (!(flags & CL_MEM_USE_HOST_PTR) && !mem->reserve_storage(CL_MEMORY_KIND_BUFFERS_FREEOCL))
+		{
+			SET_RET(CL_MEM_OBJECT_ALLOCATION_FAILURE);
+			delete mem;
+			return 0;
+		}
 		if (flags & CL_MEM_USE_HOST_PTR)
 			mem->ptr = host_ptr;
+		else if (flags & CL_MEM_CLONEABLE_FREEOCL)
+		{
+			if ((mem->ptr = FreeOCL::alloc_shared_file(size, mem->file, mem->mapped_size)) == NULL)
+			{
+				SET_RET(CL_OUT_OF_RESOURCES);
+				delete mem;
+				return 0;
+			}
+			mem->storage = FreeOCL::STORAGE_SHARED_FILE;
+			mem->b_zero = true;
+		}
+		else if (flags & CL_MEM_SHAREABLE_FREEOCL)
+		{
+			if ((mem->ptr = FreeOCL::alloc_shareable(size, mem->file, mem->mapped_size)) == NULL)
+			{
+				SET_RET(CL_OUT_OF_RESOURCES);
+				delete mem;
+				return 0;
+			}
+			mem->storage = FreeOCL::STORAGE_SHAREABLE;
+			mem->b_zero = true;
+		}
+		else if ((mem->ptr = FreeOCL::alloc_memory(size, flags, mem->mapped_size, &context->buffer_cache, &mem->b_zero)) == NULL)
+		{
+			SET_RET(CL_OUT_OF_RESOURCES);
+			delete mem;
+			return 0;
+		}
+		else
+			mem->storage = FreeOCL::STORAGE_ALLOCATED;
+
+		// Large copies are split across the pool, which spreads first touch over all nodes
+		if (flags & CL_MEM_COPY_HOST_PTR)
+		{
+			FreeOCL::parallel_memcpy(mem->ptr, host_ptr, size);
+			mem->b_zero = false;
+		}
+
+		SET_RET(CL_SUCCESS);
+
+		return mem;
+	}
+
+	cl_mem clCreateBufferFromFileFREEOCLFCL (cl_context context,
+											cl_mem_flags flags,
+											int fd,
+											cl_ulong file_offset,
+											size_t size,
+											cl_int *errcode_ret)
+	{
+		MSG(clCreateBufferFromFileFREEOCLFCL);
 #ifdef FREEOCL_OS_WINDOWS
-        else if ((mem->ptr = __mingw_aligned_malloc(size, 256)) == NULL)
+		SET_RET(CL_INVALID_OPERATION);
+		return 0;
 #else
-		else if (posix_memalign(&(mem->ptr), 256, size) == ENOMEM)
+		if (flags == 0)
+			flags = CL_MEM_READ_WRITE;
+
+		const cl_mem_flags allowed = CL_MEM_READ_WRITE | CL_MEM_WRITE_ONLY | CL_MEM_READ_ONLY
+									 | CL_MEM_HOST_WRITE_ONLY | CL_MEM_HOST_READ_ONLY | CL_MEM_HOST_NO_ACCESS
+									 | CL_MEM_FILE_SEQUENTIAL_FREEOCL | CL_MEM_FILE_RANDOM_FREEOCL | CL_MEM_FILE_WILLNEED_FREEOCL;
+		if (fd < 0
+			|| (flags & ~allowed)
+			|| ((flags & CL_MEM_READ_WRITE) && (flags & (CL_MEM_WRITE_ONLY | CL_MEM_READ_ONLY)))
+			|| ((flags & CL_MEM_WRITE_ONLY) && (flags & CL_MEM_READ_ONLY))
+			|| ((flags & CL_MEM_HOST_NO_ACCESS) && (flags & (CL_MEM_HOST_READ_ONLY | CL_MEM_HOST_WRITE_ONLY)))
+			|| ((flags & CL_MEM_HOST_READ_ONLY) && (flags & CL_MEM_HOST_WRITE_ONLY))
+			|| ((flags & CL_MEM_FILE_SEQUENTIAL_FREEOCL) && (flags & CL_MEM_FILE_RANDOM_FREEOCL)))
+		{
+			SET_RET(CL_INVALID_VALUE);
+			return 0;
+		}
+
+		// Read-only buffers map the page cache itself, so the host must not write them
+		const bool b_read_only = flags & CL_MEM_READ_ONLY;
+		if (b_read_only && (flags & CL_MEM_HOST_WRITE_ONLY))
+		{
+			SET_RET(CL_INVALID_VALUE);
+			return 0;
+		}
+		if (b_read_only && !(flags & CL_MEM_HOST_NO_ACCESS))
+			flags |= CL_MEM_HOST_READ_ONLY;
+
+		// Pages past the end of a file can't be accessed
+		struct stat st;
+		if (fstat(fd, &st))
+		{
+			SET_RET(CL_INVALID_VALUE);
+			return 0;
+		}
+		if (S_ISREG(st.st_mode))
+		{
+			if (file_offset > cl_ulong(st.st_size))
+			{
+				SET_RET(CL_INVALID_VALUE);
+				return 0;
+			}
+			if (size == 0)
+				size = size_t(st.st_size - file_offset);
+			if (size == 0 || file_offset + size > cl_ulong(st.st_size))
+			{
+				SET_RET(CL_INVALID_BUFFER_SIZE);
+				return 0;
+			}
+		}
+		else if (size == 0)
+		{
+			SET_RET(CL_INVALID_BUFFER_SIZE);
+			return 0;
+		}
+
+		FreeOCL::unlocker unlock;
+		if (!FreeOCL::is_valid(context))
+		{
+			SET_RET(CL_INVALID_CONTEXT);
+			return 0;
+		}
+		unlock.handle(context);
+
+		cl_mem mem = new _cl_mem(context);
+		mem->flags = flags;
+		mem->size = size;
+		mem->mem_type = CL_MEM_OBJECT_BUFFER;
+		mem->host_ptr = NULL;
+		mem->parent = NULL;
+		mem->offset = 0;
+		if (!mem->reserve_storage(CL_MEMORY_KIND_FILE_MAPPINGS_FREEOCL))
+		{
+			SET_RET(CL_MEM_OBJECT_ALLOCATION_FAILURE);
+			delete mem;
+			return 0;
+		}
+		if ((mem->ptr = FreeOCL::map_file(fd, file_offset, size, b_read_only, flags, mem->mapped_size)) == NULL)
+		{
+			SET_RET(errno == ENOMEM ? CL_OUT_OF_HOST_MEMORY : CL_INVALID_VALUE);
+			delete mem;
+			return 0;
+		}
+		mem->storage = FreeOCL::STORAGE_FILE;
+
+		SET_RET(CL_SUCCESS);
+
+		return mem;
 #endif
+	}
+
+	cl_mem clEnqueueCloneBufferFREEOCLFCL (cl_command_queue command_queue,
+										  cl_mem buffer,
+										  cl_mem_flags flags,
+										  cl_uint num_events_in_wait_list,
+										  const cl_event *event_wait_list,
+										  cl_event *event,
+										  cl_int *errcode_ret)
+	{
+		MSG(clEnqueueCloneBufferFREEOCLFCL);
+		const cl_mem_flags allowed = CL_MEM_READ_WRITE | CL_MEM_WRITE_ONLY | CL_MEM_READ_ONLY
+									 | CL_MEM_HOST_WRITE_ONLY | CL_MEM_HOST_READ_ONLY | CL_MEM_HOST_NO_ACCESS
+									 | CL_MEM_CLONEABLE_FREEOCL;
+		if ((flags & ~allowed)
+			|| ((flags & CL_MEM_READ_WRITE) && (flags & (CL_MEM_WRITE_ONLY | CL_MEM_READ_ONLY)))
+			|| ((flags & CL_MEM_WRITE_ONLY) && (flags & CL_MEM_READ_ONLY))
+			|| ((flags & CL_MEM_HOST_NO_ACCESS) && (flags & (CL_MEM_HOST_READ_ONLY | CL_MEM_HOST_WRITE_ONLY)))
+			|| ((flags & CL_MEM_HOST_READ_ONLY) && (flags & CL_MEM_HOST_WRITE_ONLY)))
+		{
+			SET_RET(CL_INVALID_VALUE);
+			return 0;
+		}
+
+		if ((event_wait_list == NULL && num_events_in_wait_list > 0)
+			|| (event_wait_list != NULL && num_events_in_wait_list == 0))
+		{
+			SET_RET(CL_INVALID_EVENT_WAIT_LIST);
+			return 0;
+		}
+
+		FreeOCL::unlocker unlock;
+		if (!FreeOCL::is_valid(command_queue))
+		{
+			SET_RET(CL_INVALID_COMMAND_QUEUE);
+			return 0;
+		}
+		unlock.handle(command_queue);
+
+		if (!FreeOCL::is_valid(buffer))
+		{
+			SET_RET(CL_INVALID_MEM_OBJECT);
+			return 0;
+		}
+		unlock.handle(buffer);
+
+		if (buffer->mem_type != CL_MEM_OBJECT_BUFFER || buffer->parent)
+		{
+			SET_RET(CL_INVALID_MEM_OBJECT);
+			return 0;
+		}
+
+		if (buffer->context != command_queue->context)
+		{
+			SET_RET(CL_INVALID_CONTEXT);
+			return 0;
+		}
+
+		if (flags == 0)
+			flags = buffer->flags & allowed;
+		const bool b_shared_file = buffer->storage == FreeOCL::STORAGE_SHARED_FILE;
+		// Clones of cloneable buffers share their pages
+		if (b_shared_file)
+			flags |= CL_MEM_CLONEABLE_FREEOCL;
+
+		cl_mem mem = new _cl_mem(buffer->context);
+		mem->flags = flags;
+		mem->size = buffer->size;
+		mem->mem_type = CL_MEM_OBJECT_BUFFER;
+		mem->host_ptr = NULL;
+		mem->parent = NULL;
+		mem->offset = 0;
+		if (!mem->reserve_storage(CL_MEMORY_KIND_BUFFERS_FREEOCL))
+		{
+			SET_RET(CL_MEM_OBJECT_ALLOCATION_FAILURE);
+			delete mem;
+			return 0;
+		}
+		if (b_shared_file)
+		{
+			if ((mem->ptr = FreeOCL::map_clone(buffer->file)) == NULL)
+			{
+				SET_RET(CL_OUT_OF_RESOURCES);
+				delete mem;
+				return 0;
+			}
+			mem->file = buffer->file;
+			mem->mapped_size = buffer->mapped_size;
+			mem->storage = FreeOCL::STORAGE_SHARED_FILE;
+		}
+		else if (flags & CL_MEM_CLONEABLE_FREEOCL)
+		{
+			if ((mem->ptr = FreeOCL::alloc_shared_file(mem->size, mem->file, mem->mapped_size)) == NULL)
+			{
+				SET_RET(CL_OUT_OF_RESOURCES);
+				delete mem;
+				return 0;
+			}
+			mem->storage = FreeOCL::STORAGE_SHARED_FILE;
+		}
+		else if ((mem->ptr = FreeOCL::alloc_memory(mem->size, flags, mem->mapped_size, &buffer->context->buffer_cache)) == NULL)
 		{
 			SET_RET(CL_OUT_OF_RESOURCES);
 			delete mem;
 			return 0;
 		}
+		else
+			mem->storage = FreeOCL::STORAGE_ALLOCATED;
+
+		FreeOCL::smartptr<FreeOCL::command_clone_buffer> cmd = new FreeOCL::command_clone_buffer;
+		cmd->num_events_in_wait_list = num_events_in_wait_list;
+		cmd->event_wait_list = event_wait_list;
+		cmd->event = event ? new _cl_event(command_queue->context) : NULL;
+		cmd->src_buffer = buffer;
+		cmd->dst_buffer = mem;
+
+		if (cmd->event)
+		{
+			cmd->event->command_queue = command_queue;
+			cmd->event->command_type = CL_COMMAND_CLONE_BUFFER_FREEOCL;
+			cmd->event->status = CL_QUEUED;
+		}
 
-		if (flags & CL_MEM_COPY_HOST_PTR)
-			memcpy(mem->ptr, host_ptr, size);
+		if (event)
+			*event = cmd->event.weak();
+
+		unlock.forget(command_queue);
+		command_queue->enqueue(cmd);
+
+		SET_RET(CL_SUCCESS);
+
+		return mem;
+	}
+
+	cl_int clExportBufferFREEOCLFCL (cl_mem buffer,
+									 int *fd)
+	{
+		MSG(clExportBufferFREEOCLFCL);
+#ifdef FREEOCL_OS_WINDOWS
+		return CL_INVALID_OPERATION;
+#else
+		if (fd == NULL)
+			return CL_INVALID_VALUE;
+
+		FreeOCL::unlocker unlock;
+		if (!FreeOCL::is_valid(buffer))
+			return CL_INVALID_MEM_OBJECT;
+		unlock.handle(buffer);
+
+		if (buffer->storage != FreeOCL::STORAGE_SHAREABLE)
+			return CL_INVALID_MEM_OBJECT;
+
+		const int new_fd = fcntl(buffer->file->fd, F_DUPFD_CLOEXEC, 0);
+		if (new_fd < 0)
+			return CL_OUT_OF_RESOURCES;
+		// Other processes may write it from now on
+		buffer->mark_written();
+		*fd = new_fd;
+
+		return CL_SUCCESS;
+#endif
+	}
+
+	cl_mem clImportBufferFREEOCLFCL (cl_context context,
+									 cl_mem_flags flags,
+									 int fd,
+									 cl_int *errcode_ret)
+	{
+		MSG(clImportBufferFREEOCLFCL);
+#ifdef FREEOCL_OS_WINDOWS
+		SET_RET(CL_INVALID_OPERATION);
+		return 0;
+#else
+		if (flags == 0)
+			flags = CL_MEM_READ_WRITE;
+
+		const cl_mem_flags allowed = CL_MEM_READ_WRITE | CL_MEM_WRITE_ONLY | CL_MEM_READ_ONLY
+									 | CL_MEM_HOST_WRITE_ONLY | CL_MEM_HOST_READ_ONLY | CL_MEM_HOST_NO_ACCESS;
+		if (fd < 0
+			|| (flags & ~allowed)
+			|| ((flags & CL_MEM_READ_WRITE) && (flags & (CL_MEM_WRITE_ONLY | CL_MEM_READ_ONLY)))
+			|| ((flags & CL_MEM_WRITE_ONLY) && (flags & CL_MEM_READ_ONLY))
+			|| ((flags & CL_MEM_HOST_NO_ACCESS) && (flags & (CL_MEM_HOST_READ_ONLY | CL_MEM_HOST_WRITE_ONLY)))
+			|| ((flags & CL_MEM_HOST_READ_ONLY) && (flags & CL_MEM_HOST_WRITE_ONLY)))
+		{
+			SET_RET(CL_INVALID_VALUE);
+			return 0;
+		}
+
+		FreeOCL::unlocker unlock;
+		if (!FreeOCL::is_valid(context))
+		{
+			SET_RET(CL_INVALID_CONTEXT);
+			return 0;
+		}
+		unlock.handle(context);
+
+		cl_mem mem = new _cl_mem(context);
+		mem->flags = flags | CL_MEM_SHAREABLE_FREEOCL;
+		mem->mem_type = CL_MEM_OBJECT_BUFFER;
+		mem->host_ptr = NULL;
+		mem->parent = NULL;
+		mem->offset = 0;
+		if ((mem->ptr = FreeOCL::import_shareable(fd, mem->file, mem->size, mem->mapped_size)) == NULL)
+		{
+			SET_RET(errno == ENOMEM ? CL_OUT_OF_HOST_MEMORY : CL_INVALID_VALUE);
+			delete mem;
+			return 0;
+		}
+		mem->storage = FreeOCL::STORAGE_SHAREABLE;
+		// The exporting process counts the pages
+		if (!mem->reserve_storage(CL_MEMORY_KIND_FILE_MAPPINGS_FREEOCL))
+		{
+			SET_RET(CL_MEM_OBJECT_ALLOCATION_FAILURE);
+			delete mem;
+			return 0;
+		}
 
 		SET_RET(CL_SUCCESS);
 
 		return mem;
+#endif
+	}
+
+	cl_int clEnqueueSignalFenceFREEOCLFCL (cl_command_queue command_queue,
+										   cl_mem buffer,
+										   cl_uint value,
+										   cl_uint num_events_in_wait_list,
+										   const cl_event *event_wait_list,
+										   cl_event *event)
+	{
+		MSG(clEnqueueSignalFenceFREEOCLFCL);
+		return enqueue_fence(CL_COMMAND_SIGNAL_FENCE_FREEOCL, command_queue, buffer, value,
+							 num_events_in_wait_list, event_wait_list, event);
+	}
+
+	cl_int clEnqueueWaitFenceFREEOCLFCL (cl_command_queue command_queue,
+										 cl_mem buffer,
+										 cl_uint value,
+										 cl_uint num_events_in_wait_list,
+										 const cl_event *event_wait_list,
+										 cl_event *event)
+	{
+		MSG(clEnqueueWaitFenceFREEOCLFCL);
+		return enqueue_fence(CL_COMMAND_WAIT_FENCE_FREEOCL, command_queue, buffer, value,
+							 num_events_in_wait_list, event_wait_list, event);
 	}
 
 	cl_mem clCreateSubBufferFCL (cl_mem buffer,
@@ -203,8 +735,7 @@ extern "C"
 		if (!FreeOCL::is_valid(memobj))
 			return CL_INVALID_MEM_OBJECT;
 
-		memobj->release();
-		if (memobj->get_ref_count() == 0)
+		if (memobj->release())
 		{
 			memobj->invalidate();
 			memobj->unlock();
@@ -263,6 +794,15 @@ extern "C"
 		case CL_MEM_CONTEXT:				bTooSmall = SET_VAR(memobj->context);	break;
 		case CL_MEM_ASSOCIATED_MEMOBJECT:	bTooSmall = SET_VAR(memobj->parent);	break;
 		case CL_MEM_OFFSET:					bTooSmall = SET_VAR(memobj->offset);	break;
+		case CL_MEM_FENCE_VALUE_FREEOCL:
+			{
+				const cl_mem root = memobj->parent ? memobj->parent : memobj;
+				if (root->storage != FreeOCL::STORAGE_SHAREABLE)
+					return CL_INVALID_MEM_OBJECT;
+				const cl_uint value = FreeOCL::get_fence(root->file);
+				bTooSmall = SET_VAR(value);
+			}
+			break;
 		default:
 			return CL_INVALID_VALUE;
 		}
@@ -299,6 +839,8 @@ extern "C"
 		if (!FreeOCL::is_valid(buffer))
 			return CL_INVALID_MEM_OBJECT;
 		unlock.handle(buffer);
+		if (buffer->mem_type == CL_MEM_OBJECT_PIPE_FREEOCL)
+			return CL_INVALID_MEM_OBJECT;
 
 		if (!FreeOCL::is_valid(buffer->context))
 			return CL_INVALID_CONTEXT;
@@ -393,6 +935,8 @@ extern "C"
 		if (!FreeOCL::is_valid(buffer))
 			return CL_INVALID_MEM_OBJECT;
 		unlock.handle(buffer);
+		if (buffer->mem_type == CL_MEM_OBJECT_PIPE_FREEOCL)
+			return CL_INVALID_MEM_OBJECT;
 
 		if (!FreeOCL::is_valid(buffer->context))
 			return CL_INVALID_CONTEXT;
@@ -432,6 +976,7 @@ extern "C"
 		cmd->event_wait_list = event_wait_list;
 		cmd->event = (blocking_write == CL_TRUE || event) ? new _cl_event(command_queue->context) : NULL;
 		cmd->buffer = buffer;
+		buffer->mark_written();
 		cmd->offset = offset;
 		cmd->cb = cb;
 		cmd->ptr = ptr;
@@ -461,6 +1006,38 @@ extern "C"
 		return CL_SUCCESS;
 	}
 
+	cl_int clEnqueueReadFileFREEOCLFCL (cl_command_queue command_queue,
+										cl_mem buffer,
+										cl_bool blocking_read,
+										size_t offset,
+										size_t cb,
+										int fd,
+										cl_ulong file_offset,
+										cl_uint num_events_in_wait_list,
+										const cl_event *event_wait_list,
+										cl_event *event)
+	{
+		MSG(clEnqueueReadFileFREEOCLFCL);
+		return enqueue_file_io(true, command_queue, buffer, blocking_read, offset, cb, fd, file_offset,
+							   num_events_in_wait_list, event_wait_list, event);
+	}
+
+	cl_int clEnqueueWriteFileFREEOCLFCL (cl_command_queue command_queue,
+										 cl_mem buffer,
+										 cl_bool blocking_write,
+										 size_t offset,
+										 size_t cb,
+										 int fd,
+										 cl_ulong file_offset,
+										 cl_uint num_events_in_wait_list,
+										 const cl_event *event_wait_list,
+										 cl_event *event)
+	{
+		MSG(clEnqueueWriteFileFREEOCLFCL);
+		return enqueue_file_io(false, command_queue, buffer, blocking_write, offset, cb, fd, file_offset,
+							   num_events_in_wait_list, event_wait_list, event);
+	}
+
 	cl_int clEnqueueCopyBufferFCL (cl_command_queue command_queue,
 								cl_mem src_buffer,
 								cl_mem dst_buffer,
@@ -484,6 +1061,8 @@ extern "C"
 		if (!FreeOCL::is_valid(src_buffer))
 			return CL_INVALID_MEM_OBJECT;
 		unlock.handle(src_buffer);
+		if (src_buffer->mem_type == CL_MEM_OBJECT_PIPE_FREEOCL)
+			return CL_INVALID_MEM_OBJECT;
 		if (src_buffer->size < src_offset + cb)
 			return CL_INVALID_VALUE;
 
@@ -492,10 +1071,15 @@ extern "C"
 			if (!FreeOCL::is_valid(dst_buffer))
 				return CL_INVALID_MEM_OBJECT;
 			unlock.handle(dst_buffer);
+			if (dst_buffer->mem_type == CL_MEM_OBJECT_PIPE_FREEOCL)
+				return CL_INVALID_MEM_OBJECT;
 			if (dst_buffer->size < dst_offset + cb)
 				return CL_INVALID_VALUE;
 		}
 
+		if (dst_buffer->is_read_only_file())
+			return CL_INVALID_OPERATION;
+
 		if (src_buffer == dst_buffer
 			&& std::max(src_offset, dst_offset) - std::min(src_offset, dst_offset) < cb)
 			return CL_MEM_COPY_OVERLAP;
@@ -507,6 +1091,7 @@ extern "C"
 		cmd->src_buffer = src_buffer;
 		cmd->src_offset = src_offset;
 		cmd->dst_buffer = dst_buffer;
+		dst_buffer->mark_written();
 		cmd->dst_offset = dst_offset;
 		cmd->cb = cb;
 
@@ -564,6 +1149,11 @@ extern "C"
 			return NULL;
 		}
 		unlock.handle(buffer);
+		if (buffer->mem_type == CL_MEM_OBJECT_PIPE_FREEOCL)
+		{
+			SET_RET(CL_INVALID_MEM_OBJECT);
+			return NULL;
+		}
 
 		if (buffer->size < offset + cb)
 		{
@@ -571,6 +1161,17 @@ extern "C"
 			return NULL;
 		}
 
+		if ((buffer->flags & CL_MEM_HOST_NO_ACCESS)
+			|| ((buffer->flags & CL_MEM_HOST_READ_ONLY) && (map_flags & (CL_MAP_WRITE | CL_MAP_WRITE_INVALIDATE_REGION)))
+			|| ((buffer->flags & CL_MEM_HOST_WRITE_ONLY) && (map_flags & CL_MAP_READ)))
+		{
+			SET_RET(CL_INVALID_OPERATION);
+			return NULL;
+		}
+		// Even a read mapping may reach a kernel as a raw pointer argument
+		// (cl_intel_unified_shared_memory) which writes through it
+		buffer->mark_written();
+
 		void *p = (char*)buffer->ptr + offset;
 		if ((num_events_in_wait_list == 0 || event_wait_list == NULL) && blocking_map == CL_FALSE)
 		{
@@ -703,10 +1304,16 @@ extern "C"
 		if (!FreeOCL::is_valid(src_buffer))
 			return CL_INVALID_MEM_OBJECT;
 		unlock.handle(src_buffer);
+		if (src_buffer->mem_type == CL_MEM_OBJECT_PIPE_FREEOCL)
+			return CL_INVALID_MEM_OBJECT;
 
 		if (!FreeOCL::is_valid(dst_buffer))
 			return CL_INVALID_MEM_OBJECT;
 		unlock.handle(dst_buffer);
+		if (dst_buffer->mem_type == CL_MEM_OBJECT_PIPE_FREEOCL)
+			return CL_INVALID_MEM_OBJECT;
+		if (dst_buffer->is_read_only_file())
+			return CL_INVALID_OPERATION;
 
 		if (src_buffer->size < src_origin[0] + (region[0]-1)
 		    + (src_origin[1] + (region[1]-1)) * src_row_pitch
@@ -734,6 +1341,7 @@ extern "C"
 		cmd->src_buffer = src_buffer;
 		cmd->src_offset = src_origin[0] + src_origin[1] * src_row_pitch + src_origin[2] * src_slice_pitch;
 		cmd->dst_buffer = dst_buffer;
+		dst_buffer->mark_written();
 		cmd->dst_offset = dst_origin[0] + dst_origin[1] * dst_row_pitch + dst_origin[2] * dst_slice_pitch;
 		cmd->cb[0] = region[0];
 		cmd->cb[1] = region[1];
@@ -805,6 +1413,10 @@ extern "C"
 		if (!FreeOCL::is_valid(buffer))
 			return CL_INVALID_MEM_OBJECT;
 		unlock.handle(buffer);
+		if (buffer->mem_type == CL_MEM_OBJECT_PIPE_FREEOCL)
+			return CL_INVALID_MEM_OBJECT;
+		if (buffer->is_read_only_file())
+			return CL_INVALID_OPERATION;
 
 		if (buffer->size < buffer_origin[0] + region[0]
 							+ (buffer_origin[1] + region[1]) * buffer_row_pitch
@@ -823,6 +1435,7 @@ extern "C"
 		cmd->event_wait_list = event_wait_list;
 		cmd->event = (blocking_write == CL_TRUE || event) ? new _cl_event(command_queue->context) : NULL;
 		cmd->buffer = buffer;
+		buffer->mark_written();
 		cmd->offset = buffer_origin[0] + buffer_origin[1] * buffer_row_pitch + buffer_origin[2] * buffer_slice_pitch;
 		cmd->cb[0] = region[0];
 		cmd->cb[1] = region[1];
@@ -902,6 +1515,8 @@ extern "C"
 		if (!FreeOCL::is_valid(buffer))
 			return CL_INVALID_MEM_OBJECT;
 		unlock.handle(buffer);
+		if (buffer->mem_type == CL_MEM_OBJECT_PIPE_FREEOCL)
+			return CL_INVALID_MEM_OBJECT;
 
 		if (buffer->size < buffer_origin[0] + region[0]
 							+ (buffer_origin[1] + region[1]) * buffer_row_pitch
@@ -984,6 +1599,10 @@ extern "C"
 		if (!FreeOCL::is_valid(buffer))
 			return CL_INVALID_MEM_OBJECT;
 		unlock.handle(buffer);
+		if (buffer->mem_type == CL_MEM_OBJECT_PIPE_FREEOCL)
+			return CL_INVALID_MEM_OBJECT;
+		if (buffer->is_read_only_file())
+			return CL_INVALID_OPERATION;
 
 		if (buffer->context != command_queue->context)
 			return CL_INVALID_CONTEXT;
@@ -996,6 +1615,8 @@ extern "C"
 		cmd->event_wait_list = event_wait_list;
 		cmd->event = event ? new _cl_event(command_queue->context) : NULL;
 		cmd->buffer = buffer;
+		if (!FreeOCL::is_zero(pattern, pattern_size))
+			buffer->mark_written();
 		cmd->offset = offset;
 		cmd->size = size;
 		cmd->pattern_size = pattern_size;
@@ -1031,46 +1652,120 @@ extern "C"
 		if (num_mem_objects == 0 || mem_objects == NULL)
 			return CL_INVALID_VALUE;
 
-		if ((num_events_in_wait_list > 0 && mem_objects == NULL)
-				|| (num_events_in_wait_list == 0 && mem_objects != NULL))
+		if ((num_events_in_wait_list > 0 && event_wait_list == NULL)
+				|| (num_events_in_wait_list == 0 && event_wait_list != NULL))
 			return CL_INVALID_EVENT_WAIT_LIST;
 
 		if (flags & ~ (CL_MIGRATE_MEM_OBJECT_HOST | CL_MIGRATE_MEM_OBJECT_CONTENT_UNDEFINED))
 			return CL_INVALID_VALUE;
 
+		FreeOCL::unlocker unlock;
 		if (!FreeOCL::is_valid(command_queue))
 			return CL_INVALID_COMMAND_QUEUE;
+		unlock.handle(command_queue);
 
-		// We have nothing to do except when an event is requested
-		if (event)
+		FreeOCL::smartptr<FreeOCL::command_migrate_mem_objects> cmd = new FreeOCL::command_migrate_mem_objects;
+		cmd->mem_objects.reserve(num_mem_objects);
+		for(size_t i = 0 ; i < num_mem_objects ; ++i)
 		{
-			FreeOCL::smartptr<FreeOCL::command_marker> cmd = new FreeOCL::command_marker;
-			cmd->num_events_in_wait_list = num_events_in_wait_list;
-			cmd->event_wait_list = event_wait_list;
-			if (event)
-			{
-				cmd->event = *event = new _cl_event(command_queue->context);
-				cmd->event->command_queue = command_queue;
-				cmd->event->command_type = CL_COMMAND_MIGRATE_MEM_OBJECTS;
-				cmd->event->status = CL_SUBMITTED;
-			}
-			else
-				cmd->event = NULL;
+			if (!FreeOCL::is_valid(mem_objects[i]))
+				return CL_INVALID_MEM_OBJECT;
+			unlock.handle(mem_objects[i]);
+			if (mem_objects[i]->context != command_queue->context)
+				return CL_INVALID_CONTEXT;
+			// Discarded pages needn't read back as zero
+			if (flags & CL_MIGRATE_MEM_OBJECT_CONTENT_UNDEFINED)
+				mem_objects[i]->mark_written();
+			cmd->mem_objects.push_back(mem_objects[i]);
+		}
 
-			command_queue->enqueue(cmd);
+		cmd->num_events_in_wait_list = num_events_in_wait_list;
+		cmd->event_wait_list = event_wait_list;
+		cmd->event = event ? new _cl_event(command_queue->context) : NULL;
+		cmd->flags = flags;
+
+		if (cmd->event)
+		{
+			cmd->event->command_queue = command_queue;
+			cmd->event->command_type = CL_COMMAND_MIGRATE_MEM_OBJECTS;
+			cmd->event->status = CL_QUEUED;
 		}
-		else
-			command_queue->unlock();
+
+		if (event)
+			*event = cmd->event.weak();
+
+		unlock.forget(command_queue);
+		command_queue->enqueue(cmd);
 
 		return CL_SUCCESS;
 	}
 }
 
-_cl_mem::_cl_mem(cl_context context) : context_resource(context)
+namespace FreeOCL
+{
+	void migrate_mem_object(cl_mem mem, const cl_mem_migration_flags flags)
+	{
+		const cl_mem root = mem->parent ? mem->parent : mem;
+		// Only private pages can be discarded, writing anonymous pages to
+		// fault them in doesn't break copy-on-write sharing
+		bool b_private = false;
+		bool b_anonymous = false;
+		switch(root->storage)
+		{
+		case STORAGE_ALLOCATED:
+			b_private = b_anonymous = true;
+			break;
+		case STORAGE_FILE:
+			b_private = !(root->flags & CL_MEM_READ_ONLY);
+			break;
+		case STORAGE_SHARED_FILE:
+			b_private = is_private_mapping(root->file, root->ptr);
+			break;
+		case STORAGE_SHAREABLE:		// other processes may read it
+		case STORAGE_NONE:
+			break;
+		}
+		// The ring header and sequence numbers of a pipe share its pages
+		// with the packets, zeroing them would break the ring
+		if (root->mem_type == CL_MEM_OBJECT_PIPE_FREEOCL)
+			b_private = false;
+
+		if (flags & CL_MIGRATE_MEM_OBJECT_CONTENT_UNDEFINED)
+		{
+			if (b_private)
+				discard_memory(mem->ptr, mem->size, b_anonymous);
+			return;
+		}
+		// The host and the device share the same memory
+		if (flags & CL_MIGRATE_MEM_OBJECT_HOST)
+			return;
+
+		prefault_memory(mem->ptr, mem->size,
+						b_anonymous ? numa_policy(root->size, root->flags) : 0,
+						b_anonymous && !(root->flags & CL_MEM_READ_ONLY));
+	}
+}
+
+_cl_mem::_cl_mem(cl_context context) : context_resource(context, FreeOCL::MAGIC_MEM)
+{
+	magic = FreeOCL::MAGIC_MEM;
+	ptr = NULL;
+	mapped_size = 0;
+	storage = FreeOCL::STORAGE_NONE;
+	file = NULL;
+	b_zero = false;
+	memory_kind = 0;
+	accounted_size = 0;
+	layout = FreeOCL::linear_layout(0, 0, 0);
+}
+
+bool _cl_mem::reserve_storage(const cl_uint kind)
 {
-	FreeOCL::global_mutex.lock();
-	FreeOCL::valid_mems.insert(this);
-	FreeOCL::global_mutex.unlock();
+	if (!context->reserve_memory(kind, size))
+		return false;
+	memory_kind = kind;
+	accounted_size = size;
+	return true;
 }
 
 _cl_mem::~_cl_mem()
@@ -1082,17 +1777,33 @@ _cl_mem::~_cl_mem()
 	for(std::deque<FreeOCL::mem_call_back>::const_iterator i = call_backs.begin() ; i != call_backs.end() ; ++i)
 		i->pfn_notify(this, i->user_data);
 
-	FreeOCL::global_mutex.lock();
-	FreeOCL::valid_mems.erase(this);
-	FreeOCL::global_mutex.unlock();
+	magic = 0;
+
+	// Mappings of tiled images which were never unmapped
+	for(std::map<void*, FreeOCL::image_mapping>::const_iterator i = image_mappings.begin() ; i != image_mappings.end() ; ++i)
+		free(i->first);
+
+	// Before the storage goes to the buffer cache, which counts it again
+	context->memory.release(memory_kind, accounted_size);
 
-	if (ptr && !parent && !(flags & CL_MEM_USE_HOST_PTR) && mem_type != CL_MEM_OBJECT_IMAGE1D_BUFFER)
+	switch(storage)
 	{
-#ifdef FREEOCL_OS_WINDOWS
-        __mingw_aligned_free(ptr);
-#else
-		free(ptr);
-#endif
-		ptr = NULL;
+	case FreeOCL::STORAGE_ALLOCATED:
+		// Buffers are the objects applications create and release in loops
+		FreeOCL::free_memory(ptr, size, flags, mapped_size,
+							 mem_type == CL_MEM_OBJECT_BUFFER ? &context->buffer_cache : NULL);
+		break;
+	case FreeOCL::STORAGE_FILE:
+		FreeOCL::unmap_file(ptr, mapped_size);
+		break;
+	case FreeOCL::STORAGE_SHARED_FILE:
+		FreeOCL::release_shared_file(file, ptr);
+		break;
+	case FreeOCL::STORAGE_SHAREABLE:
+		FreeOCL::release_shareable(file);
+		break;
+	case FreeOCL::STORAGE_NONE:
+		break;
 	}
+	ptr = NULL;
 }
@@ -19,8 +19,11 @@
 #define __FREEOCL_MEM_H__
 
 #include "freeocl.h"
+#include "utils/allocator.h"
+#include "utils/image_layout.h"
 #include <deque>
 #include <set>
+#include <map>
 
 namespace FreeOCL
 {
@@ -30,6 +33,50 @@ namespace FreeOCL
 									   void *user_data);
 		void *user_data;
 	};
+
+	// Where the storage of a memory object comes from
+	enum mem_storage
+	{
+		STORAGE_NONE,		// not owned: host_ptr, parent buffer or NULL
+		STORAGE_ALLOCATED,	// FreeOCL::alloc_memory
+		STORAGE_FILE,		// FreeOCL::map_file
+		STORAGE_SHARED_FILE,	// FreeOCL::alloc_shared_file or map_clone
+		STORAGE_SHAREABLE	// FreeOCL::alloc_shareable or import_shareable
+	};
+
+	// Executes a migration of clEnqueueMigrateMemObjects for one memory object
+	void migrate_mem_object(cl_mem mem, const cl_mem_migration_flags flags);
+
+	// Linear copy of a region of a tiled image returned by clEnqueueMapImage
+	struct image_mapping
+	{
+		size_t origin[3];
+		size_t region[3];
+		size_t row_pitch, slice_pitch;
+		cl_map_flags map_flags;
+	};
+
+	// Copies the region of a tiled image mapped at ptr into the mapping,
+	// unless it is mapped with CL_MAP_WRITE_INVALIDATE_REGION. Does nothing
+	// for other mappings.
+	void load_image_mapping(cl_mem image, void *ptr);
+	// Copies a mapping of a tiled image back into the image if it was mapped
+	// for writing, and frees it
+	void unload_image_mapping(cl_mem image, void *ptr);
+
+	// Header of the ring buffer backing a pipe, it must match struct __pipe
+	// from include/FreeOCL/pipe.h which kernels use to access it.
+	struct pipe_header
+	{
+		volatile cl_uint write_index;
+		cl_uint pad0[15];
+		volatile cl_uint read_index;
+		cl_uint pad1[15];
+		cl_uint packet_size;
+		cl_uint max_packets;
+		cl_uint capacity;
+		cl_uint pad2[13];
+	};
 }
 
 struct _cl_mem : public FreeOCL::icd_table, public FreeOCL::ref_counter, public FreeOCL::mutex, public FreeOCL::valid_flag, public FreeOCL::context_resource
@@ -39,6 +86,27 @@ struct _cl_mem : public FreeOCL::icd_table, public FreeOCL::ref_counter, public
 
 	void *ptr;
 	size_t size;
+	size_t mapped_size;	// storage allocated with FreeOCL::alloc_memory or map_file
+	FreeOCL::mem_storage storage;
+	FreeOCL::shared_file *file;	// memfd of STORAGE_SHARED_FILE and STORAGE_SHAREABLE
+	// Set while the storage is known to hold zeros, so that zero fills can
+	// be skipped. It is cleared when a command which may write the object is
+	// enqueued, which is always before the command runs.
+	volatile bool b_zero;
+
+	inline void mark_written()	{	(parent ? parent : this)->b_zero = false;	}
+	// Buffers mapping a file with CL_MEM_READ_ONLY are mapped PROT_READ, so
+	// commands must not write them
+	inline bool is_read_only_file() const
+	{
+		const _cl_mem *mem = parent ? parent : this;
+		return mem->storage == FreeOCL::STORAGE_FILE && (mem->flags & CL_MEM_READ_ONLY);
+	}
+	// Counts the storage in the memory usage of the context before it is
+	// allocated. Returns false if that would exceed a memory budget.
+	bool reserve_storage(const cl_uint kind);
+	cl_uint memory_kind;
+	size_t accounted_size;	// bytes counted by reserve_storage
 	cl_mem_flags flags;
 	cl_mem_object_type mem_type;
 	cl_mem parent;
@@ -51,6 +119,8 @@ struct _cl_mem : public FreeOCL::icd_table, public FreeOCL::ref_counter, public
 	size_t slice_pitch;
 	size_t element_size;
 	_cl_image_format image_format;
+	FreeOCL::image_layout layout;	// of the storage of images
+	std::map<void*, FreeOCL::image_mapping> image_mappings;	// of tiled images
 };
 
 #endif
@@ -5,6 +5,7 @@
 #include "overloaded_builtin.h"
 #include "var.h"
 #include "printf.h"
+#include "pipe_builtin.h"
 
 namespace FreeOCL
 {
@@ -163,6 +164,7 @@ namespace FreeOCL
 #define REGISTER_OVERLOADED(signature, gentype)		do { overloaded_builtin *n = new overloaded_builtin(signature, gentype);	symbols->insert(n->get_name(), n);	} while(false)
 #define REGISTER_OVERLOADED_REDIRECT(cl_name, signature, gentype)		do { overloaded_builtin *n = new overloaded_builtin(signature, gentype);	symbols->insert(#cl_name, n);	} while(false)
 #define REGISTER_VAR(type, name)					symbols->insert(#name, new var(#name, native_type::t_##type))
+#define REGISTER_PIPE(type, name, num, alt_num)		symbols->insert(#name, new pipe_builtin(native_type::t_##type, #name, num, alt_num))
 
 		// Printf
 		symbols->insert("printf", new printf);
@@ -490,6 +492,17 @@ namespace FreeOCL
 		REGISTER_OVERLOADED("int2 get_image_dim(image2d_t)", gentype_single);
 		REGISTER_OVERLOADED("int4 get_image_dim(image3d_t)", gentype_single);
 
+		// Pipe functions
+		REGISTER_PIPE(int, read_pipe, 2, 4);
+		REGISTER_PIPE(int, write_pipe, 2, 4);
+		REGISTER_PIPE(reserve_id_t, reserve_read_pipe, 2, 0);
+		REGISTER_PIPE(reserve_id_t, reserve_write_pipe, 2, 0);
+		REGISTER_PIPE(void, commit_read_pipe, 2, 0);
+		REGISTER_PIPE(void, commit_write_pipe, 2, 0);
+		REGISTER_PIPE(uint, get_pipe_num_packets, 1, 0);
+		REGISTER_PIPE(uint, get_pipe_max_packets, 1, 0);
+		REGISTER_OVERLOADED("bool is_valid_reserve_id(reserve_id_t)", gentype_single);
+
 		// as_type(n) functions
 		REGISTER_OVERLOADED("char as_char(gentype)", gentype_size1);
 		REGISTER_OVERLOADED("uchar as_uchar(gentype)", gentype_size1);
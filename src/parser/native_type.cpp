@@ -26,6 +26,8 @@ namespace FreeOCL
 	smartptr<type> native_type::t_image2d_t(new native_type(native_type::IMAGE2D_T, true, type::CONSTANT));
 	smartptr<type> native_type::t_image2d_array_t(new native_type(native_type::IMAGE2D_ARRAY_T, true, type::CONSTANT));
 	smartptr<type> native_type::t_image3d_t(new native_type(native_type::IMAGE3D_T, true, type::CONSTANT));
+	smartptr<type> native_type::t_pipe_t(new native_type(native_type::PIPE_T, true, type::CONSTANT));
+	smartptr<type> native_type::t_reserve_id_t(new native_type(native_type::RESERVE_ID_T, true, type::CONSTANT));
 	smartptr<type> native_type::t_sampler_t(new native_type(native_type::SAMPLER_T, true, type::CONSTANT));
 	smartptr<type> native_type::t_event_t(new native_type(native_type::EVENT_T, true, type::CONSTANT));
 	smartptr<type> native_type::t_void(new native_type(native_type::VOID, true, type::CONSTANT));
@@ -125,7 +127,7 @@ namespace FreeOCL
 	{
 		static const char *type_name[] = {
 			"void", "bool", "half", "size_t", "sampler_t", "event_t",
-			"image1d_t", "image1d_buffer_t", "image1d_array_t", "image2d_t", "image2d_array_t", "image3d_t",
+			"image1d_t", "image1d_buffer_t", "image1d_array_t", "image2d_t", "image2d_array_t", "image3d_t", "pipe", "reserve_id_t",
 			"char", "short", "int", "long", "uchar", "ushort", "uint", "ulong", "float", "double",
 			"char2", "short2", "int2", "long2", "uchar2", "ushort2", "uint2", "ulong2", "float2", "double2",
 			"char3", "short3", "int3", "long3", "uchar3", "ushort3", "uint3", "ulong3", "float3", "double3",
@@ -151,7 +153,7 @@ namespace FreeOCL
 	{
 		static const char *type_name[] = {
 			"void", "__bool", "__half", "__size_t", "sampler_t", "event_t",
-			"image1d_t", "image1d_buffer_t", "image1d_array_t", "image2d_t", "image2d_array_t", "image3d_t",
+			"image1d_t", "image1d_buffer_t", "image1d_array_t", "image2d_t", "image2d_array_t", "image3d_t", "pipe_t", "reserve_id_t",
 			"__char", "__short", "__int", "__long", "__uchar", "__ushort", "__uint", "__ulong", "__float", "__double",
 			"__char2", "__short2", "__int2", "__long2", "__uchar2", "__ushort2", "__uint2", "__ulong2", "__float2", "__double2",
 			"__char3", "__short3", "__int3", "__long3", "__uchar3", "__ushort3", "__uint3", "__ulong3", "__float3", "__double3",
@@ -186,7 +188,7 @@ namespace FreeOCL
 	size_t native_type::get_dim_for(int id)
 	{
 		static size_t type_dim[] = {
-			0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+			0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
 			1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
 			2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
 			3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
@@ -275,12 +277,30 @@ namespace FreeOCL
         case IMAGE2D_ARRAY_T:
         case IMAGE2D_T:
         case IMAGE3D_T:
+        case PIPE_T:
+        case RESERVE_ID_T:
             return true;
         default:
             return false;
         }
     }
 
+	bool native_type::is_image() const
+	{
+		switch(id)
+		{
+		case IMAGE1D_ARRAY_T:
+		case IMAGE1D_BUFFER_T:
+		case IMAGE1D_T:
+		case IMAGE2D_ARRAY_T:
+		case IMAGE2D_T:
+		case IMAGE3D_T:
+			return true;
+		default:
+			return false;
+		}
+	}
+
 	bool native_type::is_floatting() const
 	{
 		switch(id)
@@ -654,6 +674,7 @@ namespace FreeOCL
         static const size_t type_size[] =  {
             1, 1, 2, sizeof(size_t), sizeof(void*), sizeof(void*),
             sizeof(void*), sizeof(void*), sizeof(void*), sizeof(void*), sizeof(void*), sizeof(void*),
+            sizeof(void*), 8,
             1, 2, 4, 8, 1, 2, 4, 8, 4, 8,
             2, 4, 8, 16, 2, 4, 8, 16, 8, 16,
             4, 8, 16, 32, 4, 8, 16, 32, 16, 32,
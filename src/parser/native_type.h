@@ -27,7 +27,7 @@ namespace FreeOCL
 	public:
 		enum type_id {
 			VOID, BOOL, HALF, SIZE_T, SAMPLER_T, EVENT_T,
-			IMAGE1D_T, IMAGE1D_BUFFER_T, IMAGE1D_ARRAY_T, IMAGE2D_T, IMAGE2D_ARRAY_T, IMAGE3D_T,
+			IMAGE1D_T, IMAGE1D_BUFFER_T, IMAGE1D_ARRAY_T, IMAGE2D_T, IMAGE2D_ARRAY_T, IMAGE3D_T, PIPE_T, RESERVE_ID_T,
 			CHAR, SHORT, INT, LONG, UCHAR, USHORT, UINT, ULONG, FLOAT, DOUBLE,
 			CHAR2, SHORT2, INT2, LONG2, UCHAR2, USHORT2, UINT2, ULONG2, FLOAT2, DOUBLE2,
 			CHAR3, SHORT3, INT3, LONG3, UCHAR3, USHORT3, UINT3, ULONG3, FLOAT3, DOUBLE3,
@@ -50,6 +50,7 @@ namespace FreeOCL
 		bool is_vector() const	{	return get_dim() > 1;	}
 		bool is_scalar() const	{	return get_dim() == 1;	}
         bool is_special() const;
+		bool is_image() const;
         bool is_integer() const;
 		bool is_floatting() const;
 		bool is_half() const;
@@ -74,6 +75,8 @@ namespace FreeOCL
 		static smartptr<type> t_image2d_t;
 		static smartptr<type> t_image2d_array_t;
 		static smartptr<type> t_image3d_t;
+		static smartptr<type> t_pipe_t;
+		static smartptr<type> t_reserve_id_t;
 		static smartptr<type> t_void;
 		static smartptr<type> t_bool;
 		static smartptr<type> t_half;
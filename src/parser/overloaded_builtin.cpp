@@ -57,6 +57,7 @@ namespace FreeOCL
 				m_types["image2d_t"] = native_type::IMAGE2D_T;
 				m_types["image2d_array_t"] = native_type::IMAGE2D_ARRAY_T;
 				m_types["image3d_t"] = native_type::IMAGE3D_T;
+				m_types["reserve_id_t"] = native_type::RESERVE_ID_T;
 				m_types["size_t"] = native_type::SIZE_T;
 				m_types["char"] = native_type::CHAR;
 				m_types["short"] = native_type::SHORT;
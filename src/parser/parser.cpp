@@ -749,6 +749,25 @@ namespace FreeOCL
 		case IMAGE2D_ARRAY_T:	d_val__ = new native_type(native_type::IMAGE2D_ARRAY_T, false, type::PRIVATE);	return 1;
 		case IMAGE3D_T:	d_val__ = new native_type(native_type::IMAGE3D_T, false, type::PRIVATE);	return 1;
 		case EVENT_T:	d_val__ = new native_type(native_type::EVENT_T, false, type::PRIVATE);	return 1;
+		case IDENTIFIER:
+			// pipe and reserve_id_t are not keywords in OpenCL C 1.2, so they
+			// are only types where nothing else could follow them
+			if (d_val__.as<token>()->get_string() == "pipe")
+			{
+				// The packet type only matters to the host which gives the packet size
+				// when creating the pipe, so it is parsed and dropped.
+				if (__type_specifier())
+				{
+					d_val__ = new native_type(native_type::PIPE_T, false, type::PRIVATE);
+					return 1;
+				}
+			}
+			else if (d_val__.as<token>()->get_string() == "reserve_id_t" && peek_token() == IDENTIFIER)
+			{
+				d_val__ = new native_type(native_type::RESERVE_ID_T, false, type::PRIVATE);
+				return 1;
+			}
+			break;
 
 		case SIGNED:
 			switch (peek_token())
@@ -0,0 +1,83 @@
+/*
+	FreeOCL - a free OpenCL implementation for CPU
+	Copyright (C) 2011  Roland Brochard
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include "pipe_builtin.h"
+#include "native_type.h"
+#include "typedef.h"
+
+namespace FreeOCL
+{
+	pipe_builtin::pipe_builtin(const smartptr<type> &return_type, const std::string &name, const size_t num_params, const size_t alt_num_params)
+		: return_type(return_type),
+		name(name),
+		num_params(num_params),
+		alt_num_params(alt_num_params)
+	{
+	}
+
+	pipe_builtin::~pipe_builtin()
+	{
+	}
+
+	void pipe_builtin::write(std::ostream &out) const
+	{
+		out << name << ' ';
+	}
+
+	smartptr<type> pipe_builtin::get_return_type(const std::deque<smartptr<type> > &arg_types) const
+	{
+		if (arg_types.empty())
+			return (type*)NULL;
+		smartptr<type> p_type = arg_types.front();
+		if (p_type.as<type_def>())
+			p_type = p_type.as<type_def>()->get_type();
+		const smartptr<native_type> native = p_type.as<native_type>();
+		if (!native || native->get_type_id() != native_type::PIPE_T)
+			return (type*)NULL;
+		return return_type;
+	}
+
+	const std::string &pipe_builtin::get_name() const
+	{
+		return name;
+	}
+
+	size_t pipe_builtin::get_num_params() const
+	{
+		return num_params;
+	}
+
+	bool pipe_builtin::check_num_params(const size_t n) const
+	{
+		return n == num_params || (alt_num_params && n == alt_num_params);
+	}
+
+	bool pipe_builtin::has_references_to(const std::string &function_name) const
+	{
+		return name == function_name;
+	}
+
+    const char *pipe_builtin::get_node_type() const
+    {
+        return "pipe_builtin";
+    }
+
+    std::deque<smartptr<type> > pipe_builtin::get_arg_types(const std::deque<smartptr<type> > &/*param_types*/) const
+    {
+        return std::deque<smartptr<type> >();
+    }
+}
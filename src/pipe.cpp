@@ -0,0 +1,142 @@
+/*
+	FreeOCL - a free OpenCL implementation for CPU
+	Copyright (C) 2011  Roland Brochard
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include "mem.h"
+#include "context.h"
+#include <cstring>
+#include "utils/allocator.h"
+#include "prototypes.h"
+
+#define SET_VAR(X)	FreeOCL::copy_memory_within_limits(&(X), sizeof(X), param_value_size, param_value, param_value_size_ret)
+#define SET_RET(X)	if (errcode_ret)	*errcode_ret = (X)
+
+extern "C"
+{
+	cl_mem clCreatePipeFREEOCLFCL(cl_context context,
+								cl_mem_flags flags,
+								cl_uint pipe_packet_size,
+								cl_uint pipe_max_packets,
+								const cl_mem_flags *properties,
+								cl_int *errcode_ret)
+	{
+		MSG(clCreatePipeFREEOCLFCL);
+		if (flags == 0)
+			flags = CL_MEM_READ_WRITE;
+		if ((flags & ~(CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS)) || properties != NULL)
+		{
+			SET_RET(CL_INVALID_VALUE);
+			return 0;
+		}
+		// The host never touches the ring directly
+		flags |= CL_MEM_HOST_NO_ACCESS;
+		// Sequence numbers are compared modulo 2^32 so the ring must stay well below that
+		if (pipe_packet_size == 0 || pipe_max_packets == 0 || pipe_max_packets > (1U << 30))
+		{
+			SET_RET(CL_INVALID_PIPE_SIZE_FREEOCL);
+			return 0;
+		}
+
+		FreeOCL::unlocker unlock;
+		if (!FreeOCL::is_valid(context))
+		{
+			SET_RET(CL_INVALID_CONTEXT);
+			return 0;
+		}
+		unlock.handle(context);
+
+		// Round the ring up to a power of two so indexes wrap with a mask
+		cl_uint capacity = 1;
+		while(capacity < pipe_max_packets)
+			capacity <<= 1;
+		const size_t seq_size = (capacity * sizeof(cl_uint) + 63) & ~size_t(63);
+		if ((~size_t(0) - sizeof(FreeOCL::pipe_header) - seq_size) / capacity < pipe_packet_size)
+		{
+			SET_RET(CL_INVALID_PIPE_SIZE_FREEOCL);
+			return 0;
+		}
+		const size_t size = sizeof(FreeOCL::pipe_header) + seq_size + size_t(capacity) * pipe_packet_size;
+
+		cl_mem mem = new _cl_mem(context);
+		mem->flags = flags;
+		mem->size = size;
+		mem->mem_type = CL_MEM_OBJECT_PIPE_FREEOCL;
+		mem->host_ptr = NULL;
+		mem->parent = NULL;
+		mem->offset = 0;
+		mem->width = pipe_max_packets;
+		mem->element_size = pipe_packet_size;
+		if (!mem->reserve_storage(CL_MEMORY_KIND_PIPES_FREEOCL))
+		{
+			SET_RET(CL_MEM_OBJECT_ALLOCATION_FAILURE);
+			delete mem;
+			return 0;
+		}
+		if ((mem->ptr = FreeOCL::alloc_memory(size, flags, mem->mapped_size)) == NULL)
+		{
+			SET_RET(CL_OUT_OF_RESOURCES);
+			delete mem;
+			return 0;
+		}
+		mem->storage = FreeOCL::STORAGE_ALLOCATED;
+
+		FreeOCL::pipe_header *header = (FreeOCL::pipe_header*)mem->ptr;
+		memset(header, 0, sizeof(FreeOCL::pipe_header));
+		header->packet_size = pipe_packet_size;
+		header->max_packets = pipe_max_packets;
+		header->capacity = capacity;
+		// Slot i is free for the first lap
+		cl_uint *seq = (cl_uint*)(header + 1);
+		for(cl_uint i = 0 ; i < capacity ; ++i)
+			seq[i] = i;
+
+		SET_RET(CL_SUCCESS);
+
+		return mem;
+	}
+
+	cl_int clGetPipeInfoFREEOCLFCL(cl_mem pipe,
+								 cl_pipe_info_freeocl param_name,
+								 size_t param_value_size,
+								 void *param_value,
+								 size_t *param_value_size_ret)
+	{
+		MSG(clGetPipeInfoFREEOCLFCL);
+		FreeOCL::unlocker unlock;
+		if (!FreeOCL::is_valid(pipe))
+			return CL_INVALID_MEM_OBJECT;
+		unlock.handle(pipe);
+
+		if (pipe->mem_type != CL_MEM_OBJECT_PIPE_FREEOCL)
+			return CL_INVALID_MEM_OBJECT;
+
+		const cl_uint packet_size = cl_uint(pipe->element_size);
+		const cl_uint max_packets = cl_uint(pipe->width);
+		bool bTooSmall = false;
+		switch(param_name)
+		{
+		case CL_PIPE_PACKET_SIZE_FREEOCL:	bTooSmall = SET_VAR(packet_size);	break;
+		case CL_PIPE_MAX_PACKETS_FREEOCL:	bTooSmall = SET_VAR(max_packets);	break;
+		default:
+			return CL_INVALID_VALUE;
+		}
+
+		if (bTooSmall && param_value != NULL)
+			return CL_INVALID_VALUE;
+
+		return CL_SUCCESS;
+	}
+}
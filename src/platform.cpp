@@ -31,7 +31,7 @@ namespace
 	const char *version = "OpenCL 1.2 FreeOCL-" FREEOCL_VERSION_STRING;
 	const char *name = "FreeOCL";
 	const char *vendor = FREEOCL_VENDOR;
-	const char *extensions = "cl_khr_icd cl_freeocl_debug";
+	const char *extensions = "cl_khr_icd cl_freeocl_debug cl_freeocl_native_ndrange cl_freeocl_file_io cl_freeocl_pipe cl_freeocl_huge_pages cl_freeocl_numa cl_freeocl_file_buffer cl_freeocl_buffer_clone cl_freeocl_memory_stats cl_freeocl_shared_buffer cl_freeocl_tiled_images";
 	const char *vendor_suffix = "FCL";
 }
 
@@ -33,6 +33,29 @@
 														param_value_size_ret)
 #define SET_RET(X)	if (errcode_ret)	*errcode_ret = (X)
 
+namespace
+{
+	// Loaded binaries count in the memory usage of their context
+	void *load_binary(cl_program program)
+	{
+		void *handle = dlopen(program->binary_file.c_str(), RTLD_NOW | RTLD_LOCAL);
+		if (handle)
+		{
+			struct stat file_stat;
+			program->binary_size = stat(program->binary_file.c_str(), &file_stat) == 0 ? file_stat.st_size : 0;
+			program->context->memory.add(CL_MEMORY_KIND_PROGRAMS_FREEOCL, program->binary_size);
+		}
+		return handle;
+	}
+
+	void unload_binary(cl_program program)
+	{
+		dlclose(program->handle);
+		program->context->memory.release(CL_MEMORY_KIND_PROGRAMS_FREEOCL, program->binary_size);
+		program->binary_size = 0;
+	}
+}
+
 extern "C"
 {
 	cl_program clCreateProgramWithSourceFCL (cl_context context,
@@ -182,7 +205,7 @@ extern "C"
 
 		if (program->binary_type == CL_PROGRAM_BINARY_TYPE_EXECUTABLE)
 		{
-			program->handle = dlopen(program->binary_file.c_str(), RTLD_NOW | RTLD_LOCAL);
+			program->handle = load_binary(program);
 			if (!program->handle)
 			{
 				remove(program->binary_file.c_str());
@@ -211,8 +234,7 @@ extern "C"
 		MSG(clReleaseProgramFCL);
 		if (!FreeOCL::is_valid(program))
 			return CL_INVALID_PROGRAM;
-		program->release();
-		if (program->get_ref_count() == 0)
+		if (program->release())
 		{
 			program->invalidate();
 			program->unlock();
@@ -258,7 +280,7 @@ extern "C"
 		const std::string &source_code = program->source_code;
 
 		if (program->handle)
-			dlclose(program->handle);
+			unload_binary(program);
 		if (!program->binary_file.empty())
 			remove(program->binary_file.c_str());
 		program->handle = NULL;
@@ -303,7 +325,7 @@ extern "C"
 			return CL_BUILD_PROGRAM_FAILURE;
 		}
 
-		program->handle = dlopen(binary_file.c_str(), RTLD_NOW | RTLD_LOCAL);
+		program->handle = load_binary(program);
 		if (!program->handle)
 		{
 			// In case of error do not delete temporary code file
@@ -611,7 +633,7 @@ extern "C"
 		program->build_status = CL_BUILD_IN_PROGRESS;
 
 		if (program->handle)
-			dlclose(program->handle);
+			unload_binary(program);
 		if (!program->binary_file.empty())
 			remove(program->binary_file.c_str());
 		program->handle = NULL;
@@ -763,7 +785,7 @@ extern "C"
 
 		if (program->binary_type == CL_PROGRAM_BINARY_TYPE_EXECUTABLE)
 		{
-			program->handle = dlopen(program->binary_file.c_str(), RTLD_NOW | RTLD_LOCAL);
+			program->handle = load_binary(program);
 			if (!program->handle)
 			{
 				delete program;
@@ -784,25 +806,22 @@ extern "C"
 }
 
 _cl_program::_cl_program(cl_context context)
-	: context_resource(context),
+	: context_resource(context, FreeOCL::MAGIC_PROGRAM),
 	  binary_type(CL_PROGRAM_BINARY_TYPE_NONE),
 	  handle(NULL),
+	  binary_size(0),
 	  build_status(CL_BUILD_NONE),
 	  kernels_attached(0)
 {
-	FreeOCL::global_mutex.lock();
-	FreeOCL::valid_programs.insert(this);
-	FreeOCL::global_mutex.unlock();
+	magic = FreeOCL::MAGIC_PROGRAM;
 }
 
 _cl_program::~_cl_program()
 {
-	FreeOCL::global_mutex.lock();
-	FreeOCL::valid_programs.erase(this);
-	FreeOCL::global_mutex.unlock();
+	magic = 0;
 
 	if (handle && !binary_file.empty())
-		dlclose(handle);
+		unload_binary(this);
 	if (!binary_file.empty() && !getenv("FREEOCL_DEBUG"))
 		remove(binary_file.c_str());
 	if (!temporary_file.empty() && !getenv("FREEOCL_DEBUG"))
@@ -651,6 +651,257 @@ extern "C"
 																				const char *   /* func_name */) CL_API_SUFFIX__VERSION_1_2;
 
 	void* clGetExtensionFunctionAddressFCL (const char * /*funcname*/);
+
+	/* cl_khr_command_buffer */
+	cl_command_buffer_khr clCreateCommandBufferKHRFCL(cl_uint                                  /* num_queues */,
+													  const cl_command_queue *                 /* queues */,
+													  const cl_command_buffer_properties_khr * /* properties */,
+													  cl_int *                                 /* errcode_ret */);
+
+	cl_int clFinalizeCommandBufferKHRFCL(cl_command_buffer_khr /* command_buffer */);
+
+	cl_int clRetainCommandBufferKHRFCL(cl_command_buffer_khr /* command_buffer */);
+
+	cl_int clReleaseCommandBufferKHRFCL(cl_command_buffer_khr /* command_buffer */);
+
+	cl_int clEnqueueCommandBufferKHRFCL(cl_uint               /* num_queues */,
+										cl_command_queue *    /* queues */,
+										cl_command_buffer_khr /* command_buffer */,
+										cl_uint               /* num_events_in_wait_list */,
+										const cl_event *      /* event_wait_list */,
+										cl_event *            /* event */);
+
+	cl_int clCommandBarrierWithWaitListKHRFCL(cl_command_buffer_khr     /* command_buffer */,
+											  cl_command_queue          /* command_queue */,
+											  cl_uint                   /* num_sync_points_in_wait_list */,
+											  const cl_sync_point_khr * /* sync_point_wait_list */,
+											  cl_sync_point_khr *       /* sync_point */,
+											  cl_mutable_command_khr *  /* mutable_handle */);
+
+	cl_int clCommandCopyBufferKHRFCL(cl_command_buffer_khr     /* command_buffer */,
+									 cl_command_queue          /* command_queue */,
+									 cl_mem                    /* src_buffer */,
+									 cl_mem                    /* dst_buffer */,
+									 size_t                    /* src_offset */,
+									 size_t                    /* dst_offset */,
+									 size_t                    /* size */,
+									 cl_uint                   /* num_sync_points_in_wait_list */,
+									 const cl_sync_point_khr * /* sync_point_wait_list */,
+									 cl_sync_point_khr *       /* sync_point */,
+									 cl_mutable_command_khr *  /* mutable_handle */);
+
+	cl_int clCommandCopyBufferRectKHRFCL(cl_command_buffer_khr     /* command_buffer */,
+										 cl_command_queue          /* command_queue */,
+										 cl_mem                    /* src_buffer */,
+										 cl_mem                    /* dst_buffer */,
+										 const size_t *            /* src_origin */,
+										 const size_t *            /* dst_origin */,
+										 const size_t *            /* region */,
+										 size_t                    /* src_row_pitch */,
+										 size_t                    /* src_slice_pitch */,
+										 size_t                    /* dst_row_pitch */,
+										 size_t                    /* dst_slice_pitch */,
+										 cl_uint                   /* num_sync_points_in_wait_list */,
+										 const cl_sync_point_khr * /* sync_point_wait_list */,
+										 cl_sync_point_khr *       /* sync_point */,
+										 cl_mutable_command_khr *  /* mutable_handle */);
+
+	cl_int clCommandFillBufferKHRFCL(cl_command_buffer_khr     /* command_buffer */,
+									 cl_command_queue          /* command_queue */,
+									 cl_mem                    /* buffer */,
+									 const void *              /* pattern */,
+									 size_t                    /* pattern_size */,
+									 size_t                    /* offset */,
+									 size_t                    /* size */,
+									 cl_uint                   /* num_sync_points_in_wait_list */,
+									 const cl_sync_point_khr * /* sync_point_wait_list */,
+									 cl_sync_point_khr *       /* sync_point */,
+									 cl_mutable_command_khr *  /* mutable_handle */);
+
+	cl_int clCommandNDRangeKernelKHRFCL(cl_command_buffer_khr                            /* command_buffer */,
+										cl_command_queue                                 /* command_queue */,
+										const cl_ndrange_kernel_command_properties_khr * /* properties */,
+										cl_kernel                                        /* kernel */,
+										cl_uint                                          /* work_dim */,
+										const size_t *                                   /* global_work_offset */,
+										const size_t *                                   /* global_work_size */,
+										const size_t *                                   /* local_work_size */,
+										cl_uint                                          /* num_sync_points_in_wait_list */,
+										const cl_sync_point_khr *                        /* sync_point_wait_list */,
+										cl_sync_point_khr *                              /* sync_point */,
+										cl_mutable_command_khr *                         /* mutable_handle */);
+
+	cl_int clGetCommandBufferInfoKHRFCL(cl_command_buffer_khr      /* command_buffer */,
+										cl_command_buffer_info_khr /* param_name */,
+										size_t                     /* param_value_size */,
+										void *                     /* param_value */,
+										size_t *                   /* param_value_size_ret */);
+
+	cl_int clEnqueueNDRangeNativeKernelFREEOCLFCL(cl_command_queue               /* command_queue */,
+												  cl_native_ndrange_func_freeocl /* user_func */,
+												  void *                         /* args */,
+												  size_t                         /* cb_args */,
+												  cl_uint                        /* num_mem_objects */,
+												  const cl_mem *                 /* mem_list */,
+												  const void **                  /* args_mem_loc */,
+												  cl_uint                        /* work_dim */,
+												  const size_t *                 /* global_work_offset */,
+												  const size_t *                 /* global_work_size */,
+												  const size_t *                 /* local_work_size */,
+												  cl_uint                        /* num_events_in_wait_list */,
+												  const cl_event *               /* event_wait_list */,
+												  cl_event *                     /* event */);
+
+	cl_int clEnqueueReadFileFREEOCLFCL(cl_command_queue /* command_queue */,
+									 cl_mem           /* buffer */,
+									 cl_bool          /* blocking */,
+									 size_t           /* offset */,
+									 size_t           /* cb */,
+									 int              /* fd */,
+									 cl_ulong         /* file_offset */,
+									 cl_uint          /* num_events_in_wait_list */,
+									 const cl_event * /* event_wait_list */,
+									 cl_event *       /* event */);
+
+	cl_int clEnqueueWriteFileFREEOCLFCL(cl_command_queue /* command_queue */,
+									  cl_mem           /* buffer */,
+									  cl_bool          /* blocking */,
+									  size_t           /* offset */,
+									  size_t           /* cb */,
+									  int              /* fd */,
+									  cl_ulong         /* file_offset */,
+									  cl_uint          /* num_events_in_wait_list */,
+									  const cl_event * /* event_wait_list */,
+									  cl_event *       /* event */);
+
+	cl_mem clCreatePipeFREEOCLFCL(cl_context           /* context */,
+								cl_mem_flags         /* flags */,
+								cl_uint              /* pipe_packet_size */,
+								cl_uint              /* pipe_max_packets */,
+								const cl_mem_flags * /* properties */,
+								cl_int *             /* errcode_ret */);
+
+	cl_int clGetPipeInfoFREEOCLFCL(cl_mem               /* pipe */,
+								 cl_pipe_info_freeocl /* param_name */,
+								 size_t               /* param_value_size */,
+								 void *               /* param_value */,
+								 size_t *             /* param_value_size_ret */);
+
+	cl_mem clCreateBufferFromFileFREEOCLFCL(cl_context   /* context */,
+										  cl_mem_flags /* flags */,
+										  int          /* fd */,
+										  cl_ulong     /* file_offset */,
+										  size_t       /* size */,
+										  cl_int *     /* errcode_ret */);
+
+	cl_mem clEnqueueCloneBufferFREEOCLFCL(cl_command_queue /* command_queue */,
+										cl_mem           /* buffer */,
+										cl_mem_flags     /* flags */,
+										cl_uint          /* num_events_in_wait_list */,
+										const cl_event * /* event_wait_list */,
+										cl_event *       /* event */,
+										cl_int *         /* errcode_ret */);
+
+	void *clHostMemAllocINTELFCL(cl_context                      /* context */,
+								 const cl_mem_properties_intel * /* properties */,
+								 size_t                          /* size */,
+								 cl_uint                         /* alignment */,
+								 cl_int *                        /* errcode_ret */);
+
+	void *clDeviceMemAllocINTELFCL(cl_context                      /* context */,
+								   cl_device_id                    /* device */,
+								   const cl_mem_properties_intel * /* properties */,
+								   size_t                          /* size */,
+								   cl_uint                         /* alignment */,
+								   cl_int *                        /* errcode_ret */);
+
+	void *clSharedMemAllocINTELFCL(cl_context                      /* context */,
+								   cl_device_id                    /* device */,
+								   const cl_mem_properties_intel * /* properties */,
+								   size_t                          /* size */,
+								   cl_uint                         /* alignment */,
+								   cl_int *                        /* errcode_ret */);
+
+	cl_int clMemFreeINTELFCL(cl_context /* context */,
+							 void *     /* ptr */);
+
+	cl_int clMemBlockingFreeINTELFCL(cl_context /* context */,
+									 void *     /* ptr */);
+
+	cl_int clGetMemAllocInfoINTELFCL(cl_context        /* context */,
+									 const void *      /* ptr */,
+									 cl_mem_info_intel /* param_name */,
+									 size_t            /* param_value_size */,
+									 void *            /* param_value */,
+									 size_t *          /* param_value_size_ret */);
+
+	cl_int clSetKernelArgMemPointerINTELFCL(cl_kernel    /* kernel */,
+											cl_uint      /* arg_index */,
+											const void * /* arg_value */);
+
+	cl_int clEnqueueMemsetINTELFCL(cl_command_queue /* command_queue */,
+								   void *           /* dst_ptr */,
+								   cl_int           /* value */,
+								   size_t           /* size */,
+								   cl_uint          /* num_events_in_wait_list */,
+								   const cl_event * /* event_wait_list */,
+								   cl_event *       /* event */);
+
+	cl_int clEnqueueMemFillINTELFCL(cl_command_queue /* command_queue */,
+									void *           /* dst_ptr */,
+									const void *     /* pattern */,
+									size_t           /* pattern_size */,
+									size_t           /* size */,
+									cl_uint          /* num_events_in_wait_list */,
+									const cl_event * /* event_wait_list */,
+									cl_event *       /* event */);
+
+	cl_int clEnqueueMemcpyINTELFCL(cl_command_queue /* command_queue */,
+								   cl_bool          /* blocking */,
+								   void *           /* dst_ptr */,
+								   const void *     /* src_ptr */,
+								   size_t           /* size */,
+								   cl_uint          /* num_events_in_wait_list */,
+								   const cl_event * /* event_wait_list */,
+								   cl_event *       /* event */);
+
+	cl_int clEnqueueMigrateMemINTELFCL(cl_command_queue       /* command_queue */,
+									   const void *           /* ptr */,
+									   size_t                 /* size */,
+									   cl_mem_migration_flags /* flags */,
+									   cl_uint                /* num_events_in_wait_list */,
+									   const cl_event *       /* event_wait_list */,
+									   cl_event *             /* event */);
+
+	cl_int clEnqueueMemAdviseINTELFCL(cl_command_queue    /* command_queue */,
+									  const void *        /* ptr */,
+									  size_t              /* size */,
+									  cl_mem_advice_intel /* advice */,
+									  cl_uint             /* num_events_in_wait_list */,
+									  const cl_event *    /* event_wait_list */,
+									  cl_event *          /* event */);
+
+	cl_int clExportBufferFREEOCLFCL(cl_mem /* buffer */,
+									int *  /* fd */);
+
+	cl_mem clImportBufferFREEOCLFCL(cl_context   /* context */,
+									cl_mem_flags /* flags */,
+									int          /* fd */,
+									cl_int *     /* errcode_ret */);
+
+	cl_int clEnqueueSignalFenceFREEOCLFCL(cl_command_queue /* command_queue */,
+										  cl_mem           /* buffer */,
+										  cl_uint          /* value */,
+										  cl_uint          /* num_events_in_wait_list */,
+										  const cl_event * /* event_wait_list */,
+										  cl_event *       /* event */);
+
+	cl_int clEnqueueWaitFenceFREEOCLFCL(cl_command_queue /* command_queue */,
+										cl_mem           /* buffer */,
+										cl_uint          /* value */,
+										cl_uint          /* num_events_in_wait_list */,
+										const cl_event * /* event_wait_list */,
+										cl_event *       /* event */);
 }
 
 #endif
@@ -66,8 +66,7 @@ extern "C"
 		if (!FreeOCL::is_valid(sampler))
 			return CL_INVALID_SAMPLER;
 
-		sampler->release();
-		if (sampler->get_ref_count() == 0)
+		if (sampler->release())
 		{
 			sampler->invalidate();
 			sampler->unlock();
@@ -108,16 +107,12 @@ extern "C"
 	}
 }
 
-_cl_sampler::_cl_sampler(cl_context context) : context_resource(context)
+_cl_sampler::_cl_sampler(cl_context context) : context_resource(context, FreeOCL::MAGIC_SAMPLER)
 {
-	FreeOCL::global_mutex.lock();
-	FreeOCL::valid_samplers.insert(this);
-	FreeOCL::global_mutex.unlock();
+	magic = FreeOCL::MAGIC_SAMPLER;
 }
 
 _cl_sampler::~_cl_sampler()
 {
-	FreeOCL::global_mutex.lock();
-	FreeOCL::valid_samplers.erase(this);
-	FreeOCL::global_mutex.unlock();
+	magic = 0;
 }
@@ -0,0 +1,523 @@
+/*
+	FreeOCL - a free OpenCL implementation for CPU
+	Copyright (C) 2011  Roland Brochard
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include "usm.h"
+#include "context.h"
+#include "device.h"
+#include "kernel.h"
+#include "event.h"
+#include "utils/commandqueue.h"
+#include "utils/allocator.h"
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+#include "prototypes.h"
+
+#define SET_VAR(X)	FreeOCL::copy_memory_within_limits(&(X), sizeof(X), param_value_size, param_value, param_value_size_ret)
+#define SET_RET(X)	if (errcode_ret)	*errcode_ret = (X)
+
+namespace
+{
+	// Smallest page size of the supported systems
+	const cl_uint max_alignment = 4096;
+
+	const cl_mem_alloc_flags_intel valid_alloc_flags = CL_MEM_ALLOC_WRITE_COMBINED_INTEL
+													   | CL_MEM_ALLOC_INITIAL_PLACEMENT_DEVICE_INTEL
+													   | CL_MEM_ALLOC_INITIAL_PLACEMENT_HOST_INTEL;
+
+	void *alloc_usm(cl_context context,
+					cl_device_id device,
+					const cl_mem_properties_intel *properties,
+					size_t size,
+					cl_uint alignment,
+					const cl_unified_shared_memory_type_intel type,
+					cl_int *errcode_ret)
+	{
+		FreeOCL::unlocker unlock;
+		if (!FreeOCL::is_valid(context))
+		{
+			SET_RET(CL_INVALID_CONTEXT);
+			return NULL;
+		}
+		unlock.handle(context);
+
+		if (type != CL_MEM_TYPE_HOST_INTEL && device != FreeOCL::device)
+		{
+			SET_RET(CL_INVALID_DEVICE);
+			return NULL;
+		}
+
+		cl_mem_alloc_flags_intel flags = 0;
+		if (properties)
+		{
+			for(; *properties != 0 ; properties += 2)
+			{
+				if (properties[0] != CL_MEM_ALLOC_FLAGS_INTEL || (properties[1] & ~valid_alloc_flags))
+				{
+					SET_RET(CL_INVALID_PROPERTY);
+					return NULL;
+				}
+				flags = properties[1];
+			}
+		}
+
+		if (size == 0 || size > FreeOCL::device->freememsize)
+		{
+			SET_RET(CL_INVALID_BUFFER_SIZE);
+			return NULL;
+		}
+
+		if ((alignment & (alignment - 1)) || alignment > max_alignment)
+		{
+			SET_RET(CL_INVALID_VALUE);
+			return NULL;
+		}
+
+		if (!context->reserve_memory(CL_MEMORY_KIND_USM_FREEOCL, size))
+		{
+			SET_RET(CL_MEM_OBJECT_ALLOCATION_FAILURE);
+			return NULL;
+		}
+
+		FreeOCL::usm_allocation allocation;
+		allocation.size = size;
+		allocation.type = type;
+		allocation.device = type == CL_MEM_TYPE_HOST_INTEL ? NULL : device;
+		allocation.flags = flags;
+		char *ptr = (char*)FreeOCL::alloc_aligned_memory(size, alignment, allocation.mapped_size, &context->buffer_cache);
+		if (ptr == NULL)
+		{
+			context->memory.release(CL_MEMORY_KIND_USM_FREEOCL, size);
+			SET_RET(CL_OUT_OF_HOST_MEMORY);
+			return NULL;
+		}
+		context->usm_allocations[ptr] = allocation;
+
+		SET_RET(CL_SUCCESS);
+		return ptr;
+	}
+
+	// Returns the allocation holding ptr, or NULL. context must be locked.
+	const FreeOCL::usm_map::value_type *find_allocation(cl_context context, const void *ptr)
+	{
+		FreeOCL::usm_map::const_iterator it = context->usm_allocations.upper_bound((const char*)ptr);
+		if (it == context->usm_allocations.begin())
+			return NULL;
+		--it;
+		if ((const char*)ptr >= it->first + it->second.size)
+			return NULL;
+		return &*it;
+	}
+
+	// Returns the size of the allocation of context holding [ptr, ptr + size[,
+	// or 0 if there is none
+	size_t find_allocation_size(cl_context context, const void *ptr, const size_t size)
+	{
+		context->lock();
+		const FreeOCL::usm_map::value_type *allocation = find_allocation(context, ptr);
+		const size_t allocation_size = allocation && (const char*)ptr + size <= allocation->first + allocation->second.size
+									   ? allocation->second.size : 0;
+		context->unlock();
+		return allocation_size;
+	}
+
+	void free_allocation(cl_context context, FreeOCL::usm_map::iterator it)
+	{
+		FreeOCL::free_memory((void*)it->first, it->second.size, 0, it->second.mapped_size, &context->buffer_cache);
+		context->memory.release(CL_MEMORY_KIND_USM_FREEOCL, it->second.size);
+		context->usm_allocations.erase(it);
+	}
+
+	cl_int free_usm(cl_context context, void *ptr, const bool b_blocking)
+	{
+		FreeOCL::unlocker unlock;
+		if (!FreeOCL::is_valid(context))
+			return CL_INVALID_CONTEXT;
+		unlock.handle(context);
+
+		if (ptr == NULL)
+			return CL_SUCCESS;
+
+		FreeOCL::usm_map::iterator it = context->usm_allocations.find((const char*)ptr);
+		if (it == context->usm_allocations.end())
+			return CL_INVALID_VALUE;
+
+		if (b_blocking)
+		{
+			// Commands are only known to the queues of the context
+			std::vector<cl_command_queue> queues;
+			for(FreeOCL::set<FreeOCL::context_resource*>::const_iterator i = context->resources.begin() ; i != context->resources.end() ; ++i)
+			{
+				if ((*i)->resource_type != FreeOCL::MAGIC_COMMAND_QUEUE)
+					continue;
+				// A queue being destroyed stays listed until its context_resource
+				// destructor runs, it must not be revived. Its memory is kept by
+				// the context lock, but locking it here would invert the queue ->
+				// context order of the enqueue functions.
+				cl_command_queue command_queue = static_cast<cl_command_queue>(*i);
+				if (command_queue->magic != FreeOCL::MAGIC_COMMAND_QUEUE || !command_queue->valid())
+					continue;
+				if (command_queue->retain_if_alive())
+					queues.push_back(command_queue);
+			}
+			unlock.unlockall();
+			for(size_t i = 0 ; i < queues.size() ; ++i)
+			{
+				clFinishFCL(queues[i]);
+				clReleaseCommandQueueFCL(queues[i]);
+			}
+			if (!FreeOCL::is_valid(context))
+				return CL_INVALID_CONTEXT;
+			unlock.handle(context);
+			it = context->usm_allocations.find((const char*)ptr);
+			if (it == context->usm_allocations.end())
+				return CL_INVALID_VALUE;
+		}
+
+		free_allocation(context, it);
+		return CL_SUCCESS;
+	}
+
+	// Checks the queue and the wait list of a command, they are left locked
+	cl_int check_command(FreeOCL::unlocker &unlock,
+						 cl_command_queue command_queue,
+						 cl_uint num_events_in_wait_list,
+						 const cl_event *event_wait_list,
+						 const bool b_blocking)
+	{
+		if (!FreeOCL::is_valid(command_queue))
+			return CL_INVALID_COMMAND_QUEUE;
+		unlock.handle(command_queue);
+
+		if ((event_wait_list == NULL) != (num_events_in_wait_list == 0))
+			return CL_INVALID_EVENT_WAIT_LIST;
+
+		for(size_t i = 0 ; i < num_events_in_wait_list ; ++i)
+		{
+			if (!FreeOCL::is_valid(event_wait_list[i]))
+				return CL_INVALID_EVENT_WAIT_LIST;
+			unlock.handle(event_wait_list[i]);
+			if (b_blocking && event_wait_list[i]->status < 0)
+				return CL_EXEC_STATUS_ERROR_FOR_EVENTS_IN_WAIT_LIST;
+		}
+		return CL_SUCCESS;
+	}
+
+	cl_int enqueue(FreeOCL::unlocker &unlock,
+				   cl_command_queue command_queue,
+				   FreeOCL::smartptr<FreeOCL::command> cmd,
+				   cl_uint num_events_in_wait_list,
+				   const cl_event *event_wait_list,
+				   cl_event *event,
+				   const bool b_blocking)
+	{
+		cmd->num_events_in_wait_list = num_events_in_wait_list;
+		cmd->event_wait_list = event_wait_list;
+		cmd->event = (b_blocking || event) ? new _cl_event(command_queue->context) : NULL;
+
+		if (cmd->event)
+		{
+			cmd->event->command_queue = command_queue;
+			cmd->event->command_type = cmd->get_type();
+			cmd->event->status = CL_QUEUED;
+		}
+
+		if (event)
+			*event = cmd->event.weak();
+
+		unlock.forget(command_queue);
+		command_queue->enqueue(cmd);
+
+		unlock.unlockall();
+
+		if (b_blocking)
+		{
+			clWaitForEventsFCL(1, &(cmd->event.weak()));
+			if (event == NULL)
+				clReleaseEventFCL(cmd->event.weak());
+		}
+
+		return CL_SUCCESS;
+	}
+}
+
+namespace FreeOCL
+{
+	void free_usm_allocations(cl_context context)
+	{
+		while(!context->usm_allocations.empty())
+			free_allocation(context, context->usm_allocations.begin());
+	}
+}
+
+extern "C"
+{
+	void *clHostMemAllocINTELFCL(cl_context context,
+								 const cl_mem_properties_intel *properties,
+								 size_t size,
+								 cl_uint alignment,
+								 cl_int *errcode_ret)
+	{
+		MSG(clHostMemAllocINTELFCL);
+		return alloc_usm(context, NULL, properties, size, alignment, CL_MEM_TYPE_HOST_INTEL, errcode_ret);
+	}
+
+	void *clDeviceMemAllocINTELFCL(cl_context context,
+								   cl_device_id device,
+								   const cl_mem_properties_intel *properties,
+								   size_t size,
+								   cl_uint alignment,
+								   cl_int *errcode_ret)
+	{
+		MSG(clDeviceMemAllocINTELFCL);
+		return alloc_usm(context, device, properties, size, alignment, CL_MEM_TYPE_DEVICE_INTEL, errcode_ret);
+	}
+
+	void *clSharedMemAllocINTELFCL(cl_context context,
+								   cl_device_id device,
+								   const cl_mem_properties_intel *properties,
+								   size_t size,
+								   cl_uint alignment,
+								   cl_int *errcode_ret)
+	{
+		MSG(clSharedMemAllocINTELFCL);
+		// Shared allocations needn't be tied to a device
+		if (device == NULL)
+			device = FreeOCL::device;
+		return alloc_usm(context, device, properties, size, alignment, CL_MEM_TYPE_SHARED_INTEL, errcode_ret);
+	}
+
+	cl_int clMemFreeINTELFCL(cl_context context,
+							 void *ptr)
+	{
+		MSG(clMemFreeINTELFCL);
+		return free_usm(context, ptr, false);
+	}
+
+	cl_int clMemBlockingFreeINTELFCL(cl_context context,
+									 void *ptr)
+	{
+		MSG(clMemBlockingFreeINTELFCL);
+		return free_usm(context, ptr, true);
+	}
+
+	cl_int clGetMemAllocInfoINTELFCL(cl_context context,
+									 const void *ptr,
+									 cl_mem_info_intel param_name,
+									 size_t param_value_size,
+									 void *param_value,
+									 size_t *param_value_size_ret)
+	{
+		MSG(clGetMemAllocInfoINTELFCL);
+		FreeOCL::unlocker unlock;
+		if (!FreeOCL::is_valid(context))
+			return CL_INVALID_CONTEXT;
+		unlock.handle(context);
+
+		// Pointers which aren't in an allocation have an unknown type
+		const FreeOCL::usm_map::value_type *allocation = find_allocation(context, ptr);
+		bool bTooSmall = false;
+		switch(param_name)
+		{
+		case CL_MEM_ALLOC_TYPE_INTEL:
+			{
+				const cl_unified_shared_memory_type_intel type = allocation ? allocation->second.type : CL_MEM_TYPE_UNKNOWN_INTEL;
+				bTooSmall = SET_VAR(type);
+			}
+			break;
+		case CL_MEM_ALLOC_BASE_PTR_INTEL:
+			{
+				const void *base = allocation ? allocation->first : NULL;
+				bTooSmall = SET_VAR(base);
+			}
+			break;
+		case CL_MEM_ALLOC_SIZE_INTEL:
+			{
+				const size_t size = allocation ? allocation->second.size : 0;
+				bTooSmall = SET_VAR(size);
+			}
+			break;
+		case CL_MEM_ALLOC_DEVICE_INTEL:
+			{
+				const cl_device_id device = allocation ? allocation->second.device : NULL;
+				bTooSmall = SET_VAR(device);
+			}
+			break;
+		case CL_MEM_ALLOC_FLAGS_INTEL:
+			{
+				const cl_mem_alloc_flags_intel flags = allocation ? allocation->second.flags : 0;
+				bTooSmall = SET_VAR(flags);
+			}
+			break;
+		default:
+			return CL_INVALID_VALUE;
+		}
+
+		if (bTooSmall && param_value != NULL)
+			return CL_INVALID_VALUE;
+
+		return CL_SUCCESS;
+	}
+
+	cl_int clSetKernelArgMemPointerINTELFCL(cl_kernel kernel,
+											cl_uint arg_index,
+											const void *arg_value)
+	{
+		MSG(clSetKernelArgMemPointerINTELFCL);
+		FreeOCL::unlocker unlock;
+		if (!FreeOCL::is_valid(kernel))
+			return CL_INVALID_KERNEL;
+		unlock.handle(kernel);
+		if (kernel->args_size.size() <= arg_index)
+			return CL_INVALID_ARG_INDEX;
+		if (kernel->args_type[arg_index] != CL_KERNEL_ARG_ADDRESS_GLOBAL
+			&& kernel->args_type[arg_index] != CL_KERNEL_ARG_ADDRESS_CONSTANT)
+			return CL_INVALID_ARG_VALUE;
+		// Any host pointer is valid since kernels run in the address space of
+		// the application
+		memcpy(&(kernel->args_buffer[kernel->args_offset[arg_index]]), &arg_value, sizeof(void*));
+		return CL_SUCCESS;
+	}
+
+	cl_int clEnqueueMemFillINTELFCL(cl_command_queue command_queue,
+									void *dst_ptr,
+									const void *pattern,
+									size_t pattern_size,
+									size_t size,
+									cl_uint num_events_in_wait_list,
+									const cl_event *event_wait_list,
+									cl_event *event)
+	{
+		MSG(clEnqueueMemFillINTELFCL);
+		if (dst_ptr == NULL
+			|| pattern == NULL
+			|| pattern_size == 0
+			|| pattern_size > 128
+			|| (pattern_size & (pattern_size - 1))
+			|| size % pattern_size
+			|| size_t(dst_ptr) % pattern_size)
+			return CL_INVALID_VALUE;
+
+		FreeOCL::unlocker unlock;
+		const cl_int err = check_command(unlock, command_queue, num_events_in_wait_list, event_wait_list, false);
+		if (err != CL_SUCCESS)
+			return err;
+
+		FreeOCL::smartptr<FreeOCL::command_usm_fill> cmd = new FreeOCL::command_usm_fill;
+		cmd->ptr = dst_ptr;
+		cmd->size = size;
+		cmd->pattern = malloc(pattern_size);
+		memcpy(cmd->pattern, pattern, pattern_size);
+		cmd->pattern_size = pattern_size;
+		cmd->b_discard = find_allocation_size(command_queue->context, dst_ptr, size) != 0;
+
+		return enqueue(unlock, command_queue, cmd, num_events_in_wait_list, event_wait_list, event, false);
+	}
+
+	cl_int clEnqueueMemsetINTELFCL(cl_command_queue command_queue,
+								   void *dst_ptr,
+								   cl_int value,
+								   size_t size,
+								   cl_uint num_events_in_wait_list,
+								   const cl_event *event_wait_list,
+								   cl_event *event)
+	{
+		MSG(clEnqueueMemsetINTELFCL);
+		const cl_uchar pattern = cl_uchar(value);
+		return clEnqueueMemFillINTELFCL(command_queue, dst_ptr, &pattern, sizeof(pattern), size,
+										num_events_in_wait_list, event_wait_list, event);
+	}
+
+	cl_int clEnqueueMemcpyINTELFCL(cl_command_queue command_queue,
+								   cl_bool blocking,
+								   void *dst_ptr,
+								   const void *src_ptr,
+								   size_t size,
+								   cl_uint num_events_in_wait_list,
+								   const cl_event *event_wait_list,
+								   cl_event *event)
+	{
+		MSG(clEnqueueMemcpyINTELFCL);
+		if (dst_ptr == NULL || src_ptr == NULL)
+			return CL_INVALID_VALUE;
+		if ((const char*)dst_ptr < (const char*)src_ptr + size
+			&& (const char*)src_ptr < (const char*)dst_ptr + size)
+			return CL_MEM_COPY_OVERLAP;
+
+		FreeOCL::unlocker unlock;
+		const cl_int err = check_command(unlock, command_queue, num_events_in_wait_list, event_wait_list, blocking == CL_TRUE);
+		if (err != CL_SUCCESS)
+			return err;
+
+		FreeOCL::smartptr<FreeOCL::command_usm_copy> cmd = new FreeOCL::command_usm_copy;
+		cmd->dst_ptr = dst_ptr;
+		cmd->src_ptr = src_ptr;
+		cmd->size = size;
+
+		return enqueue(unlock, command_queue, cmd, num_events_in_wait_list, event_wait_list, event, blocking == CL_TRUE);
+	}
+
+	cl_int clEnqueueMigrateMemINTELFCL(cl_command_queue command_queue,
+									   const void *ptr,
+									   size_t size,
+									   cl_mem_migration_flags flags,
+									   cl_uint num_events_in_wait_list,
+									   const cl_event *event_wait_list,
+									   cl_event *event)
+	{
+		MSG(clEnqueueMigrateMemINTELFCL);
+		if (ptr == NULL
+			|| (flags & ~(CL_MIGRATE_MEM_OBJECT_HOST | CL_MIGRATE_MEM_OBJECT_CONTENT_UNDEFINED)))
+			return CL_INVALID_VALUE;
+
+		FreeOCL::unlocker unlock;
+		const cl_int err = check_command(unlock, command_queue, num_events_in_wait_list, event_wait_list, false);
+		if (err != CL_SUCCESS)
+			return err;
+
+		FreeOCL::smartptr<FreeOCL::command_usm_migrate> cmd = new FreeOCL::command_usm_migrate;
+		cmd->ptr = const_cast<void*>(ptr);
+		cmd->size = size;
+		cmd->flags = flags;
+		// Only storage FreeOCL owns may be faulted writable or discarded
+		const size_t allocation_size = find_allocation_size(command_queue->context, ptr, size);
+		cmd->b_anonymous = allocation_size != 0;
+		cmd->numa_policy = FreeOCL::numa_policy(allocation_size, 0);
+
+		return enqueue(unlock, command_queue, cmd, num_events_in_wait_list, event_wait_list, event, false);
+	}
+
+	cl_int clEnqueueMemAdviseINTELFCL(cl_command_queue command_queue,
+									  const void *ptr,
+									  size_t size,
+									  cl_mem_advice_intel advice,
+									  cl_uint num_events_in_wait_list,
+									  const cl_event *event_wait_list,
+									  cl_event *event)
+	{
+		MSG(clEnqueueMemAdviseINTELFCL);
+		(void)command_queue;
+		(void)ptr;
+		(void)size;
+		(void)advice;
+		(void)num_events_in_wait_list;
+		(void)event_wait_list;
+		(void)event;
+		// The extension defines no advice yet
+		return CL_INVALID_VALUE;
+	}
+}
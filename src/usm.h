@@ -0,0 +1,46 @@
+/*
+	FreeOCL - a free OpenCL implementation for CPU
+	Copyright (C) 2011  Roland Brochard
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#ifndef __FREEOCL_USM_H__
+#define __FREEOCL_USM_H__
+
+#include "freeocl.h"
+#include <CL/cl_ext.h>
+#include <map>
+
+namespace FreeOCL
+{
+	// Allocation of cl_intel_unified_shared_memory. Host, device and shared
+	// allocations are all host memory on a CPU device, they only differ by
+	// the type clGetMemAllocInfoINTEL reports.
+	struct usm_allocation
+	{
+		size_t size;
+		size_t mapped_size;	// see FreeOCL::alloc_memory
+		cl_unified_shared_memory_type_intel type;
+		cl_device_id device;
+		cl_mem_alloc_flags_intel flags;
+	};
+
+	// Allocations of a context by base address
+	typedef std::map<const char*, usm_allocation> usm_map;
+
+	// Frees the allocations a context still holds when it is destroyed
+	void free_usm_allocations(cl_context context);
+}
+
+#endif
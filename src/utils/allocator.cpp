@@ -0,0 +1,921 @@
+/*
+	FreeOCL - a free OpenCL implementation for CPU
+	Copyright (C) 2011  Roland Brochard
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include "allocator.h"
+#include "memops.h"
+#include "time.h"
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <climits>
+#include <ctime>
+#include <algorithm>
+#ifndef FREEOCL_OS_WINDOWS
+#include <sys/mman.h>
+#endif
+#ifdef FREEOCL_OS_LINUX
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT	26
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB	(30 << MAP_HUGE_SHIFT)
+#endif
+
+namespace
+{
+	const size_t huge_page_size = 0x200000;
+	const size_t gigantic_page_size = 0x40000000;
+	// Alignment of heap allocations
+	const size_t heap_alignment = 256;
+	// Identifies the header of shareable storage, "FOCL"
+	const cl_uint shareable_magic = 0x4C434F46;
+	const cl_uint shareable_version = 1;
+
+	enum huge_page_mode
+	{
+		HUGE_PAGES_OFF,		// never use huge pages
+		HUGE_PAGES_THP,		// transparent huge pages (default)
+		HUGE_PAGES_2M,		// 2MB pages from the hugetlb pool
+		HUGE_PAGES_1G		// 1GB pages from the hugetlb pool for buffers of at least 1GB
+	};
+
+	huge_page_mode read_huge_page_mode()
+	{
+		const char *env = getenv("FREEOCL_HUGE_PAGES");
+		if (!env)
+			return HUGE_PAGES_THP;
+		if (!strcmp(env, "0") || !strcmp(env, "off"))
+			return HUGE_PAGES_OFF;
+		if (!strcmp(env, "2m") || !strcmp(env, "2M"))
+			return HUGE_PAGES_2M;
+		if (!strcmp(env, "1g") || !strcmp(env, "1G"))
+			return HUGE_PAGES_1G;
+		return HUGE_PAGES_THP;
+	}
+
+	inline huge_page_mode get_huge_page_mode()
+	{
+		static const huge_page_mode mode = read_huge_page_mode();
+		return mode;
+	}
+
+	inline size_t round_up(const size_t size, const size_t alignment)
+	{
+		return (size + alignment - 1) & ~(alignment - 1);
+	}
+
+	// Rounds the size of huge page mappings up to a size class: 4 classes per
+	// power of 2, so that released storage can serve requests of slightly
+	// different sizes while wasting at most 25%
+	size_t size_class(const size_t size)
+	{
+		const size_t len = round_up(size, huge_page_size);
+		size_t top = huge_page_size;
+		while(top <= len / 2)
+			top <<= 1;
+		const size_t step = top / 4 > huge_page_size ? top / 4 : huge_page_size;
+		return round_up(len, step);
+	}
+
+	// Cached storage unused for longer than this is unmapped (in ns)
+	const size_t cache_max_age = 2000000000UL;
+
+	size_t read_cache_size()
+	{
+		const char *env = getenv("FREEOCL_BUFFER_CACHE");
+		if (!env)
+			return 256UL << 20;
+		char *end;
+		const long size = strtol(env, &end, 10);
+		if (end == env || *end || size < 0)
+			return 256UL << 20;
+		return size_t(size) << 20;
+	}
+
+	inline size_t get_cache_size()
+	{
+		static const size_t size = read_cache_size();
+		return size;
+	}
+
+	const cl_mem_flags numa_flags = CL_MEM_NUMA_INTERLEAVE_FREEOCL
+									| CL_MEM_NUMA_FIRST_TOUCH_FREEOCL
+									| CL_MEM_NUMA_BIND_FREEOCL;
+
+	// Default NUMA policy of memory objects of at least huge_page_size bytes
+	cl_mem_flags read_numa_policy()
+	{
+		const char *env = getenv("FREEOCL_NUMA");
+		if (!env)
+			return 0;
+		if (!strcmp(env, "interleave"))
+			return CL_MEM_NUMA_INTERLEAVE_FREEOCL;
+		if (!strcmp(env, "first_touch"))
+			return CL_MEM_NUMA_FIRST_TOUCH_FREEOCL;
+		char *end;
+		const long node = strtol(env, &end, 10);
+		if (end != env && *end == 0 && node >= 0 && node < 256)
+			return CL_MEM_NUMA_NODE_FREEOCL(node);
+		return 0;
+	}
+
+	inline cl_mem_flags get_numa_policy(const size_t size, const cl_mem_flags flags)
+	{
+		static const cl_mem_flags policy = read_numa_policy();
+		if (flags & numa_flags)
+			return flags & (numa_flags | CL_MEM_NUMA_NODE_FREEOCL(0xFF));
+		return size >= huge_page_size ? policy : 0;
+	}
+
+	// Policies that storage must have been allocated with to be reused
+	inline cl_mem_flags alloc_key(const size_t size, const cl_mem_flags flags)
+	{
+		return get_numa_policy(size, flags) | (flags & CL_MEM_HUGE_PAGES_1GB_FREEOCL);
+	}
+
+#ifdef FREEOCL_OS_LINUX
+	// Number of possible NUMA nodes, 1 when the system doesn't know about NUMA
+	size_t read_numa_nodes()
+	{
+		FILE *file = fopen("/sys/devices/system/node/possible", "r");
+		if (!file)
+			return 1;
+		// The file holds a list of ranges ("0-1" or "0,2-3"): the last number is the highest node
+		unsigned int first = 0, last = 0;
+		char sep;
+		size_t n = 1;
+		while(fscanf(file, "%u", &first) == 1)
+		{
+			last = first;
+			if (fscanf(file, "%c", &sep) == 1 && sep == '-' && fscanf(file, "%u", &last) == 1)
+				fscanf(file, "%c", &sep);
+			n = last + 1;
+		}
+		fclose(file);
+		return n;
+	}
+
+	// Sets the NUMA policy of a range. When b_move is set, pages already
+	// allocated move to follow it, and first touch pages move to the node of
+	// the calling thread.
+	void apply_numa_policy(void *ptr, const size_t size, const cl_mem_flags policy, const bool b_move = false)
+	{
+#ifdef SYS_mbind
+		static const size_t nb_nodes = read_numa_nodes();
+		// Values from <numaif.h>, which needs libnuma
+		const int mpol_preferred = 1;
+		const int mpol_interleave = 3;
+		const unsigned int mpol_mf_move = 1 << 1;
+
+		if (nb_nodes <= 1)
+			return;
+
+		unsigned long mask[256 / (8 * sizeof(unsigned long))];
+		memset(mask, 0, sizeof(mask));
+		int mode;
+		if (policy & CL_MEM_NUMA_INTERLEAVE_FREEOCL)
+		{
+			mode = mpol_interleave;
+			for(size_t i = 0 ; i < nb_nodes && i < 256 ; ++i)
+				mask[i / (8 * sizeof(unsigned long))] |= 1UL << (i % (8 * sizeof(unsigned long)));
+		}
+		else if (policy & CL_MEM_NUMA_BIND_FREEOCL)
+		{
+			// Preferred rather than bound so that allocation falls back to
+			// other nodes instead of failing when the node is full
+			const size_t node = (policy >> 40) & 0xFF;
+			if (node >= nb_nodes)
+				return;
+			mode = mpol_preferred;
+			mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+		}
+		else if ((policy & CL_MEM_NUMA_FIRST_TOUCH_FREEOCL) && b_move)
+		{
+			unsigned int cpu = 0, node = 0;
+#ifdef SYS_getcpu
+			if (syscall(SYS_getcpu, &cpu, &node, NULL))
+				return;
+#endif
+			if (node >= nb_nodes || node >= 256)
+				return;
+			mode = mpol_preferred;
+			mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+		}
+		else
+			return;
+		syscall(SYS_mbind, ptr, size, mode, mask, 256, b_move ? mpol_mf_move : 0);
+#else
+		(void)ptr;
+		(void)size;
+		(void)policy;
+		(void)b_move;
+#endif
+	}
+#endif
+
+#ifndef FREEOCL_OS_WINDOWS
+#ifndef MADV_POPULATE_READ
+#define MADV_POPULATE_READ	22
+#endif
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE	23
+#endif
+
+	struct prefault_job
+	{
+		cl_mem_flags numa_policy;
+		bool b_write;
+	};
+
+	// Run by the workers of the pool on the chunks they are likely to
+	// process in kernels
+	void prefault_chunk(char *begin, const size_t size, void *data)
+	{
+		const prefault_job *job = (const prefault_job*)data;
+#ifdef FREEOCL_OS_LINUX
+		apply_numa_policy(begin, size, job->numa_policy, true);
+#endif
+		// Kernels older than 5.14 don't know MADV_POPULATE_*, read-ahead is
+		// the best they can do
+		if (madvise(begin, size, job->b_write ? MADV_POPULATE_WRITE : MADV_POPULATE_READ))
+			madvise(begin, size, MADV_WILLNEED);
+	}
+#endif
+
+#ifndef FREEOCL_OS_WINDOWS
+	// Maps pages from the hugetlb pool, fails if the pool is too small
+	void *map_hugetlb(const size_t size, const size_t page_size, size_t &mapped_size)
+	{
+#ifdef MAP_HUGETLB
+		const size_t len = round_up(size, page_size);
+		const int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB
+						  | (page_size == gigantic_page_size ? MAP_HUGE_1GB : 0);
+		void *ptr = mmap(NULL, len, PROT_READ | PROT_WRITE, flags, -1, 0);
+		if (ptr == MAP_FAILED)
+			return NULL;
+		mapped_size = len;
+		return ptr;
+#else
+		(void)size;
+		(void)page_size;
+		(void)mapped_size;
+		return NULL;
+#endif
+	}
+
+	// Maps regular pages aligned on a huge page boundary and lets the kernel
+	// back them with transparent huge pages
+	void *map_thp(const size_t size, size_t &mapped_size)
+	{
+		const size_t len = round_up(size, huge_page_size);
+		char *base = (char*)mmap(NULL, len + huge_page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (base == MAP_FAILED)
+			return NULL;
+		// Trim the mapping to an aligned range
+		char *ptr = (char*)round_up(size_t(base), huge_page_size);
+		const size_t head = ptr - base;
+		if (head)
+			munmap(base, head);
+		munmap(ptr + len, huge_page_size - head);
+#ifdef MADV_HUGEPAGE
+		madvise(ptr, len, MADV_HUGEPAGE);
+#endif
+		mapped_size = len;
+		return ptr;
+	}
+
+	// Maps regular pages, used for small memory objects with a NUMA policy
+	void *map_pages(const size_t size, size_t &mapped_size)
+	{
+		const size_t len = round_up(size, sysconf(_SC_PAGESIZE));
+		void *ptr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (ptr == MAP_FAILED)
+			return NULL;
+		mapped_size = len;
+		return ptr;
+	}
+#endif
+
+#ifdef FREEOCL_OS_LINUX
+	// Copies the pages of the private mapping src which have been written,
+	// i.e. which no longer map the file. They are found in /proc/self/pagemap
+	// (bit 63: present, bit 62: swapped, bit 61: file page). Copies
+	// everything if pagemap can't be read.
+	void copy_private_pages(void *dst, const void *src, const size_t size)
+	{
+		const size_t page_size = sysconf(_SC_PAGESIZE);
+		const int fd = open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+		{
+			FreeOCL::parallel_memcpy(dst, src, size);
+			return;
+		}
+		const size_t nb_pages = size / page_size;
+		const size_t first_page = size_t(src) / page_size;
+		cl_ulong entries[4096];
+		// Consecutive written pages are copied together
+		size_t run_start = 0, run_length = 0;
+		for(size_t i = 0 ; i < nb_pages ; )
+		{
+			const size_t n = std::min<size_t>(nb_pages - i, sizeof(entries) / sizeof(entries[0]));
+			const ssize_t len = pread(fd, entries, n * sizeof(cl_ulong), off_t((first_page + i) * sizeof(cl_ulong)));
+			if (len != ssize_t(n * sizeof(cl_ulong)))
+			{
+				close(fd);
+				FreeOCL::parallel_memcpy((char*)dst + i * page_size, (const char*)src + i * page_size, size - i * page_size);
+				return;
+			}
+			for(size_t j = 0 ; j < n ; ++j, ++i)
+			{
+				const cl_ulong e = entries[j];
+				const bool b_written = (e & (1ULL << 62)) || ((e & (1ULL << 63)) && !(e & (1ULL << 61)));
+				if (b_written)
+				{
+					if (run_length == 0)
+						run_start = i;
+					++run_length;
+					continue;
+				}
+				if (run_length)
+					FreeOCL::parallel_memcpy((char*)dst + run_start * page_size, (const char*)src + run_start * page_size, run_length * page_size);
+				run_length = 0;
+			}
+		}
+		if (run_length)
+			FreeOCL::parallel_memcpy((char*)dst + run_start * page_size, (const char*)src + run_start * page_size, run_length * page_size);
+		close(fd);
+	}
+#endif
+}
+
+namespace FreeOCL
+{
+	void *alloc_memory(const size_t size, const cl_mem_flags flags, size_t &mapped_size, memory_cache *cache, volatile bool *b_zero)
+	{
+		mapped_size = 0;
+		if (b_zero)
+			*b_zero = false;
+#ifndef FREEOCL_OS_WINDOWS
+		const huge_page_mode mode = get_huge_page_mode();
+		const cl_mem_flags numa_policy = get_numa_policy(size, flags);
+		const bool b_large = size >= huge_page_size;
+		const bool b_huge_pages = b_large && mode != HUGE_PAGES_OFF;
+		const bool b_gigantic = b_huge_pages
+								&& ((flags & CL_MEM_HUGE_PAGES_1GB_FREEOCL)
+									|| (mode == HUGE_PAGES_1G && size >= gigantic_page_size));
+		void *ptr = NULL;
+		if (cache && (b_large || numa_policy))
+		{
+			// Cached storage already follows its NUMA policy
+			const size_t len = b_gigantic ? round_up(size, gigantic_page_size)
+										  : b_large ? size_class(size)
+													: round_up(size, sysconf(_SC_PAGESIZE));
+			ptr = cache->get(len, alloc_key(size, flags));
+			if (ptr)
+			{
+				mapped_size = len;
+				return ptr;
+			}
+		}
+
+		if (b_huge_pages)
+		{
+			if (b_gigantic)
+				ptr = map_hugetlb(size, gigantic_page_size, mapped_size);
+			if (!ptr && (mode == HUGE_PAGES_2M || mode == HUGE_PAGES_1G))
+				ptr = map_hugetlb(size_class(size), huge_page_size, mapped_size);
+			if (!ptr)
+				ptr = map_thp(size_class(size), mapped_size);
+		}
+		else if (b_large)
+			ptr = map_pages(size_class(size), mapped_size);
+		else if (numa_policy)
+			ptr = map_pages(size, mapped_size);
+
+		if (ptr)
+		{
+			// The policy must be set before pages are touched
+#ifdef FREEOCL_OS_LINUX
+			apply_numa_policy(ptr, mapped_size, numa_policy);
+#endif
+			// Each worker of the pool touches the chunks it will most likely
+			// process so that pages land on its node
+			if (numa_policy & CL_MEM_NUMA_FIRST_TOUCH_FREEOCL)
+			{
+				const char zero = 0;
+				parallel_fill(ptr, mapped_size, &zero, 1, false);
+			}
+			if (b_zero)
+				*b_zero = true;
+			return ptr;
+		}
+		mapped_size = 0;
+
+		if (posix_memalign(&ptr, heap_alignment, size))
+			return NULL;
+		return ptr;
+#else
+		(void)flags;
+		(void)cache;
+		return __mingw_aligned_malloc(size, heap_alignment);
+#endif
+	}
+
+	void *alloc_aligned_memory(const size_t size, const size_t alignment, size_t &mapped_size, memory_cache *cache)
+	{
+		// Mappings are at least page aligned
+		if (alignment <= heap_alignment || size >= huge_page_size || get_numa_policy(size, 0))
+			return alloc_memory(size, 0, mapped_size, cache);
+		mapped_size = 0;
+#ifndef FREEOCL_OS_WINDOWS
+		void *ptr = NULL;
+		if (posix_memalign(&ptr, alignment, size))
+			return NULL;
+		return ptr;
+#else
+		return __mingw_aligned_malloc(size, alignment);
+#endif
+	}
+
+	cl_mem_flags numa_policy(const size_t size, const cl_mem_flags flags)
+	{
+		return get_numa_policy(size, flags);
+	}
+
+	void prefault_memory(void *ptr, const size_t size, const cl_mem_flags numa_policy, const bool b_write)
+	{
+#ifndef FREEOCL_OS_WINDOWS
+		prefault_job job;
+		job.numa_policy = numa_policy;
+		job.b_write = b_write;
+		parallel_pages(ptr, size, prefault_chunk, &job);
+#else
+		(void)ptr;
+		(void)size;
+		(void)numa_policy;
+		(void)b_write;
+#endif
+	}
+
+	void discard_memory(void *ptr, const size_t size, const bool b_anonymous)
+	{
+#ifndef FREEOCL_OS_WINDOWS
+		// Only whole pages can be discarded
+		const size_t page_size = sysconf(_SC_PAGESIZE);
+		char *begin = (char*)round_up(size_t(ptr), page_size);
+		char *end = (char*)((size_t(ptr) + size) & ~(page_size - 1));
+		if (end <= begin)
+			return;
+#ifdef MADV_FREE
+		// Lazily freed pages cost nothing unless memory runs short
+		if (b_anonymous && !madvise(begin, end - begin, MADV_FREE))
+			return;
+#else
+		(void)b_anonymous;
+#endif
+		madvise(begin, end - begin, MADV_DONTNEED);
+#else
+		(void)ptr;
+		(void)size;
+		(void)b_anonymous;
+#endif
+	}
+
+	bool is_private_mapping(shared_file *file, const void *ptr)
+	{
+		file->lock();
+		const bool b_private = file->shared_mapping != ptr;
+		file->unlock();
+		return b_private;
+	}
+
+	bool check_alloc_flags(const cl_mem_flags flags)
+	{
+		const cl_mem_flags policy = flags & (CL_MEM_NUMA_INTERLEAVE_FREEOCL | CL_MEM_NUMA_FIRST_TOUCH_FREEOCL | CL_MEM_NUMA_BIND_FREEOCL);
+		// At most one NUMA policy, and a node only with CL_MEM_NUMA_BIND_FREEOCL
+		if (policy & (policy - 1))
+			return false;
+		if ((flags & CL_MEM_NUMA_NODE_FREEOCL(0xFF) & ~CL_MEM_NUMA_BIND_FREEOCL) && policy != CL_MEM_NUMA_BIND_FREEOCL)
+			return false;
+		// Cloneable storage is a memfd mapped with regular pages
+		if ((flags & CL_MEM_CLONEABLE_FREEOCL)
+			&& (policy || (flags & (CL_MEM_HUGE_PAGES_1GB_FREEOCL | CL_MEM_USE_HOST_PTR))))
+			return false;
+		// Shareable storage stays shared, it can't become copy-on-write
+		if ((flags & CL_MEM_SHAREABLE_FREEOCL)
+			&& (policy || (flags & (CL_MEM_HUGE_PAGES_1GB_FREEOCL | CL_MEM_USE_HOST_PTR | CL_MEM_CLONEABLE_FREEOCL))))
+			return false;
+		// A host pointer has the linear layout of the application
+		if ((flags & CL_MEM_TILED_FREEOCL) && (flags & CL_MEM_USE_HOST_PTR))
+			return false;
+		return true;
+	}
+
+	void free_memory(void *ptr, const size_t size, const cl_mem_flags flags, const size_t mapped_size, memory_cache *cache)
+	{
+#ifndef FREEOCL_OS_WINDOWS
+		if (mapped_size)
+		{
+			if (!cache || !cache->put(ptr, mapped_size, alloc_key(size, flags)))
+				munmap(ptr, mapped_size);
+		}
+		else
+			free(ptr);
+#else
+		(void)size;
+		(void)flags;
+		(void)mapped_size;
+		(void)cache;
+		__mingw_aligned_free(ptr);
+#endif
+	}
+
+	void *map_file(const int fd, const cl_ulong file_offset, const size_t size, const bool b_read_only, const cl_mem_flags flags, size_t &mapped_size)
+	{
+		mapped_size = 0;
+#ifndef FREEOCL_OS_WINDOWS
+		const size_t page_size = sysconf(_SC_PAGESIZE);
+		const size_t head = file_offset & (page_size - 1);
+		const size_t len = round_up(head + size, page_size);
+		char *base = (char*)mmap(NULL, len,
+								 b_read_only ? PROT_READ : PROT_READ | PROT_WRITE,
+								 b_read_only ? MAP_SHARED : MAP_PRIVATE,
+								 fd, off_t(file_offset - head));
+		if (base == MAP_FAILED)
+			return NULL;
+		if (flags & CL_MEM_FILE_SEQUENTIAL_FREEOCL)
+			madvise(base, len, MADV_SEQUENTIAL);
+		else if (flags & CL_MEM_FILE_RANDOM_FREEOCL)
+			madvise(base, len, MADV_RANDOM);
+		// Starts asynchronous read-ahead of the whole range
+		if (flags & CL_MEM_FILE_WILLNEED_FREEOCL)
+			madvise(base, len, MADV_WILLNEED);
+		mapped_size = len;
+		return base + head;
+#else
+		(void)fd;
+		(void)file_offset;
+		(void)size;
+		(void)b_read_only;
+		(void)flags;
+		return NULL;
+#endif
+	}
+
+	void unmap_file(void *ptr, const size_t mapped_size)
+	{
+#ifndef FREEOCL_OS_WINDOWS
+		// The mapping starts at the page holding ptr
+		const size_t page_size = sysconf(_SC_PAGESIZE);
+		munmap((void*)(size_t(ptr) & ~(page_size - 1)), mapped_size);
+#else
+		(void)ptr;
+		(void)mapped_size;
+#endif
+	}
+
+	void *alloc_shared_file(const size_t size, shared_file *&file, size_t &mapped_size)
+	{
+		file = NULL;
+		mapped_size = 0;
+#if defined(FREEOCL_OS_LINUX) && defined(SYS_memfd_create)
+		const size_t len = round_up(size, sysconf(_SC_PAGESIZE));
+		const int fd = syscall(SYS_memfd_create, "freeocl-buffer", 1U /* MFD_CLOEXEC */);
+		if (fd < 0)
+			return NULL;
+		if (ftruncate(fd, off_t(len)))
+		{
+			close(fd);
+			return NULL;
+		}
+		void *ptr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (ptr == MAP_FAILED)
+		{
+			close(fd);
+			return NULL;
+		}
+		file = new shared_file;
+		file->fd = fd;
+		file->size = len;
+		file->ref_count = 1;
+		file->shared_mapping = ptr;
+		mapped_size = len;
+		return ptr;
+#else
+		(void)size;
+		return NULL;
+#endif
+	}
+
+	void *map_clone(shared_file *file)
+	{
+#ifdef FREEOCL_OS_LINUX
+		void *ptr = mmap(NULL, file->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file->fd, 0);
+		if (ptr == MAP_FAILED)
+			return NULL;
+		file->lock();
+		++file->ref_count;
+		file->unlock();
+		return ptr;
+#else
+		(void)file;
+		return NULL;
+#endif
+	}
+
+	bool clone_shared_file(shared_file *file, const void *src, void *dst)
+	{
+#ifdef FREEOCL_OS_LINUX
+		file->lock();
+		// Replace the shared mapping with a private one: its pages are
+		// still those of the file, but its next writes won't reach it
+		if (file->shared_mapping)
+		{
+			if (mmap(file->shared_mapping, file->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, file->fd, 0) == MAP_FAILED)
+			{
+				file->unlock();
+				return false;
+			}
+			const bool b_shared_src = file->shared_mapping == src;
+			file->shared_mapping = NULL;
+			if (b_shared_src)
+			{
+				file->unlock();
+				return true;
+			}
+		}
+		file->unlock();
+		copy_private_pages(dst, src, file->size);
+		return true;
+#else
+		(void)file;
+		(void)src;
+		(void)dst;
+		return false;
+#endif
+	}
+
+	void release_shared_file(shared_file *file, void *ptr)
+	{
+#ifdef FREEOCL_OS_LINUX
+		munmap(ptr, file->size);
+		file->lock();
+		if (file->shared_mapping == ptr)
+			file->shared_mapping = NULL;
+		const bool b_last = --file->ref_count == 0;
+		file->unlock();
+		if (b_last)
+		{
+			close(file->fd);
+			delete file;
+		}
+#else
+		(void)file;
+		(void)ptr;
+#endif
+	}
+
+	void *alloc_shareable(const size_t size, shared_file *&file, size_t &mapped_size)
+	{
+		file = NULL;
+		mapped_size = 0;
+#if defined(FREEOCL_OS_LINUX) && defined(SYS_memfd_create)
+		const size_t page_size = sysconf(_SC_PAGESIZE);
+		const size_t len = page_size + round_up(size, page_size);
+		const int fd = syscall(SYS_memfd_create, "freeocl-shareable", 1U /* MFD_CLOEXEC */);
+		if (fd < 0)
+			return NULL;
+		if (ftruncate(fd, off_t(len)))
+		{
+			close(fd);
+			return NULL;
+		}
+		char *base = (char*)mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (base == MAP_FAILED)
+		{
+			close(fd);
+			return NULL;
+		}
+		shareable_header *header = (shareable_header*)base;
+		header->magic = shareable_magic;
+		header->version = shareable_version;
+		header->size = size;
+		header->fence = 0;
+		file = new shared_file;
+		file->fd = fd;
+		file->size = len;
+		file->ref_count = 1;
+		file->shared_mapping = base;
+		mapped_size = len;
+		return base + page_size;
+#else
+		(void)size;
+		return NULL;
+#endif
+	}
+
+	void *import_shareable(const int fd, shared_file *&file, size_t &size, size_t &mapped_size)
+	{
+		file = NULL;
+		size = 0;
+		mapped_size = 0;
+#ifdef FREEOCL_OS_LINUX
+		const size_t page_size = sysconf(_SC_PAGESIZE);
+		struct stat st;
+		if (fstat(fd, &st))
+			return NULL;
+		if (!S_ISREG(st.st_mode) || size_t(st.st_size) <= page_size)
+		{
+			errno = EINVAL;
+			return NULL;
+		}
+		const size_t len = size_t(st.st_size);
+		char *base = (char*)mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (base == MAP_FAILED)
+			return NULL;
+		const shareable_header *header = (const shareable_header*)base;
+		if (header->magic != shareable_magic
+			|| header->version != shareable_version
+			|| header->size == 0
+			|| header->size > len - page_size)
+		{
+			munmap(base, len);
+			errno = EINVAL;
+			return NULL;
+		}
+		// Keeps the storage exportable from this process too
+		const int dup_fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+		if (dup_fd < 0)
+		{
+			munmap(base, len);
+			return NULL;
+		}
+		file = new shared_file;
+		file->fd = dup_fd;
+		file->size = len;
+		file->ref_count = 1;
+		file->shared_mapping = base;
+		size = size_t(header->size);
+		mapped_size = len;
+		return base + page_size;
+#else
+		(void)fd;
+		return NULL;
+#endif
+	}
+
+	void release_shareable(shared_file *file)
+	{
+#ifdef FREEOCL_OS_LINUX
+		munmap(file->shared_mapping, file->size);
+		close(file->fd);
+		delete file;
+#else
+		(void)file;
+#endif
+	}
+
+	void signal_fence(shared_file *file, const cl_uint value)
+	{
+		shareable_header *header = (shareable_header*)file->shared_mapping;
+		// Everything written to the buffer before is visible once the fence is
+		__sync_synchronize();
+		header->fence = value;
+		__sync_synchronize();
+#ifdef FREEOCL_OS_LINUX
+		// Not FUTEX_PRIVATE_FLAG: waiters may be in other processes
+		syscall(SYS_futex, &header->fence, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#endif
+	}
+
+	bool wait_fence(shared_file *file, const cl_uint value, const size_t timeout_ns)
+	{
+		shareable_header *header = (shareable_header*)file->shared_mapping;
+		const size_t start = ns_timer();
+		for(;;)
+		{
+			const cl_uint current = header->fence;
+			if (cl_int(current - value) >= 0)
+			{
+				__sync_synchronize();
+				return true;
+			}
+			const size_t elapsed = ns_timer() - start;
+			if (elapsed >= timeout_ns)
+				return false;
+#ifdef FREEOCL_OS_LINUX
+			const size_t remaining = timeout_ns - elapsed;
+			struct timespec ts;
+			ts.tv_sec = remaining / 1000000000U;
+			ts.tv_nsec = remaining % 1000000000U;
+			// Returns at once if the fence isn't current anymore
+			syscall(SYS_futex, &header->fence, FUTEX_WAIT, current, &ts, NULL, 0);
+#endif
+		}
+	}
+
+	cl_uint get_fence(shared_file *file)
+	{
+		const cl_uint value = ((const shareable_header*)file->shared_mapping)->fence;
+		__sync_synchronize();
+		return value;
+	}
+
+	memory_cache::memory_cache(memory_usage *usage) : total(0), usage(usage)
+	{
+	}
+
+	memory_cache::~memory_cache()
+	{
+		trim(0);
+	}
+
+	void *memory_cache::get(const size_t mapped_size, const cl_mem_flags key)
+	{
+		lock();
+		const size_t now = ns_timer();
+		trim(get_cache_size(), now);
+		void *ptr = NULL;
+		// Take the most recently released storage, its pages are more likely to be resident
+		for(std::deque<entry>::iterator it = entries.begin() ; it != entries.end() ; ++it)
+		{
+			if (it->mapped_size == mapped_size && it->key == key)
+			{
+				ptr = it->ptr;
+				total -= mapped_size;
+				usage->release(CL_MEMORY_KIND_BUFFER_CACHE_FREEOCL, mapped_size);
+				entries.erase(it);
+				break;
+			}
+		}
+		unlock();
+		return ptr;
+	}
+
+	bool memory_cache::put(void *ptr, const size_t mapped_size, const cl_mem_flags key)
+	{
+		const size_t max_total = get_cache_size();
+		if (mapped_size > max_total)
+			return false;
+		lock();
+		const size_t now = ns_timer();
+		trim(max_total - mapped_size, now);
+		if (!usage->reserve(CL_MEMORY_KIND_BUFFER_CACHE_FREEOCL, mapped_size))
+		{
+			unlock();
+			return false;
+		}
+		const entry e = { ptr, mapped_size, key, now };
+		entries.push_front(e);
+		total += mapped_size;
+		unlock();
+		return true;
+	}
+
+	void memory_cache::trim(const size_t max_total)
+	{
+		lock();
+		trim(max_total, ns_timer());
+		unlock();
+	}
+
+	void memory_cache::trim(const size_t max_total, const size_t now)
+	{
+#ifndef FREEOCL_OS_WINDOWS
+		// Oldest entries are at the back
+		while(!entries.empty()
+			  && (total > max_total || now - entries.back().release_time > cache_max_age))
+		{
+			munmap(entries.back().ptr, entries.back().mapped_size);
+			total -= entries.back().mapped_size;
+			usage->release(CL_MEMORY_KIND_BUFFER_CACHE_FREEOCL, entries.back().mapped_size);
+			entries.pop_back();
+		}
+#else
+		(void)max_total;
+		(void)now;
+#endif
+	}
+}
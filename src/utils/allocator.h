@@ -0,0 +1,175 @@
+/*
+	FreeOCL - a free OpenCL implementation for CPU
+	Copyright (C) 2011  Roland Brochard
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#ifndef __FREEOCL_UTILS_ALLOCATOR_H__
+#define __FREEOCL_UTILS_ALLOCATOR_H__
+
+#include <cstddef>
+#include <deque>
+#include <CL/cl_freeocl.h>
+#include "mutex.h"
+#include "memory_usage.h"
+
+namespace FreeOCL
+{
+	// Keeps the mapped storage of released buffers so that buffers created
+	// and released at a high rate don't pay for mmap, page faults and munmap
+	// every time. Storage is sorted in size classes and matched on size class
+	// and allocation policy. The cache holds at most FREEOCL_BUFFER_CACHE MB
+	// (256 by default, 0 disables it): least recently released storage is
+	// unmapped first, and storage unused for a few seconds is unmapped when
+	// the cache is next used. Cached storage is counted in usage, and isn't
+	// cached if that would exceed its budget.
+	class memory_cache : public mutex
+	{
+	public:
+		memory_cache(memory_usage *usage);
+		~memory_cache();
+
+		// Returns storage of mapped_size bytes cached with key, or NULL
+		void *get(const size_t mapped_size, const cl_mem_flags key);
+		// Takes ownership of ptr, returns false if the cache doesn't want it
+		bool put(void *ptr, const size_t mapped_size, const cl_mem_flags key);
+		// Unmaps storage until at most max_total bytes remain
+		void trim(const size_t max_total);
+
+	private:
+		void trim(const size_t max_total, const size_t now);
+
+	private:
+		struct entry
+		{
+			void *ptr;
+			size_t mapped_size;
+			cl_mem_flags key;
+			size_t release_time;
+		};
+		std::deque<entry> entries;	// last released first
+		size_t total;
+		memory_usage *usage;
+	};
+
+	// Allocates the storage of a memory object. Large allocations are mapped,
+	// so their pages are only committed when first touched, 2MB aligned and
+	// backed by huge pages according to flags and to the FREEOCL_HUGE_PAGES
+	// environment variable (see cl_freeocl_huge_pages).
+	// Mapped storage follows the NUMA policy given by flags or by FREEOCL_NUMA
+	// (see cl_freeocl_numa). mapped_size receives the value to pass to
+	// free_memory. When a cache is given, storage is taken from it if possible
+	// and the caller must not rely on its content. b_zero, if given, is set
+	// when the storage is a new mapping, whose pages read as zero until they
+	// are written. Returns NULL if memory is exhausted.
+	void *alloc_memory(const size_t size, const cl_mem_flags flags, size_t &mapped_size, memory_cache *cache = NULL, volatile bool *b_zero = NULL);
+
+	// Allocates like alloc_memory with no flags, aligned on at least
+	// alignment bytes, which must be a power of two no larger than a page.
+	void *alloc_aligned_memory(const size_t size, const size_t alignment, size_t &mapped_size, memory_cache *cache = NULL);
+
+	// size and flags must be those given to alloc_memory. Mapped storage goes
+	// to cache when one is given.
+	void free_memory(void *ptr, const size_t size, const cl_mem_flags flags, const size_t mapped_size, memory_cache *cache = NULL);
+
+	// Maps size bytes of the file fd from file_offset, which needn't be page
+	// aligned. Read-only mappings share the page cache, writable ones are
+	// private copy-on-write copies. flags gives the CL_MEM_FILE_* access
+	// hints. Returns NULL and leaves errno set on failure.
+	void *map_file(const int fd, const cl_ulong file_offset, const size_t size, const bool b_read_only, const cl_mem_flags flags, size_t &mapped_size);
+
+	void unmap_file(void *ptr, const size_t mapped_size);
+
+	// memfd holding the storage of a cloneable buffer and of its clones. While
+	// the buffer is the only one to map it, its mapping is shared. The first
+	// clone makes all mappings private copy-on-write so the file content
+	// never changes again and clones only pay for the pages they write.
+	struct shared_file : public mutex
+	{
+		int fd;
+		size_t size;
+		size_t ref_count;		// number of mappings
+		void *shared_mapping;	// NULL once all mappings are private
+	};
+
+	// Creates a memfd of size bytes and maps it shared. Returns NULL if
+	// memory is exhausted or if the system has no memfd.
+	void *alloc_shared_file(const size_t size, shared_file *&file, size_t &mapped_size);
+
+	// Maps file private copy-on-write for a clone. The mapping has the
+	// content of the cloned buffer once clone_shared_file has been called.
+	void *map_clone(shared_file *file);
+
+	// Gives dst, returned by map_clone, the content of the buffer mapped at
+	// src. Only the pages written through src since they were mapped are
+	// copied.
+	bool clone_shared_file(shared_file *file, const void *src, void *dst);
+
+	void release_shared_file(shared_file *file, void *ptr);
+
+	// Returns false if ptr, mapped from file, is the shared mapping
+	bool is_private_mapping(shared_file *file, const void *ptr);
+
+	// Storage of a shareable buffer: a memfd other processes map through a
+	// file descriptor. Its first page holds this header, followed by the
+	// content of the buffer. The fence is a futex word, its value is only
+	// changed by signal_fence.
+	struct shareable_header
+	{
+		cl_uint magic;
+		cl_uint version;
+		cl_ulong size;
+		volatile cl_uint fence;
+	};
+
+	// Creates a memfd for size bytes and maps it shared. file->shared_mapping
+	// is the header. Returns NULL if memory is exhausted or if the system has
+	// no memfd.
+	void *alloc_shareable(const size_t size, shared_file *&file, size_t &mapped_size);
+
+	// Maps the shareable storage fd refers to, fd is duplicated and stays
+	// owned by the caller. Returns NULL and leaves errno set if fd isn't
+	// shareable storage or can't be mapped.
+	void *import_shareable(const int fd, shared_file *&file, size_t &size, size_t &mapped_size);
+
+	void release_shareable(shared_file *file);
+
+	// Stores value into a fence and wakes its waiters in all processes
+	void signal_fence(shared_file *file, const cl_uint value);
+
+	// Waits for a fence to reach value or to pass it, values wrapping
+	// around. Returns false if timeout_ns elapses first.
+	bool wait_fence(shared_file *file, const cl_uint value, const size_t timeout_ns);
+
+	cl_uint get_fence(shared_file *file);
+
+	// NUMA policy of storage allocated for size bytes with flags
+	cl_mem_flags numa_policy(const size_t size, const cl_mem_flags flags);
+
+	// Faults in the pages of a range from the workers of the device thread
+	// pool so that kernels don't take page faults. Pages first move to follow
+	// numa_policy. b_write faults them writable, which breaks copy-on-write
+	// sharing: it is only meant for anonymous memory.
+	void prefault_memory(void *ptr, const size_t size, const cl_mem_flags numa_policy, const bool b_write);
+
+	// Returns the whole pages of a private range to the system. Their content
+	// becomes undefined: zero or old data for anonymous memory, the file
+	// content for private file mappings.
+	void discard_memory(void *ptr, const size_t size, const bool b_anonymous);
+
+	// Returns false if flags hold conflicting allocation policies
+	bool check_alloc_flags(const cl_mem_flags flags);
+}
+
+#endif
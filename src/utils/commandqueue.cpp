@@ -22,11 +22,16 @@
 #include "mem.h"
 #include "context.h"
 #include "kernel.h"
+#include "commandbuffer.h"
+#include "program.h"
+#include "memory_usage.h"
 #include <cstring>
 #include <iostream>
 #include <cstdlib>
+#include <algorithm>
 #include "prototypes.h"
 #include "threadpool.h"
+#include "memops.h"
 #include "device.h"
 
 #define SET_VAR(X)	FreeOCL::copy_memory_within_limits(&(X), sizeof(X), param_value_size, param_value, param_value_size_ret)
@@ -45,14 +50,108 @@ namespace FreeOCL
 	cl_command_type command_read_buffer::get_type() const	{	return CL_COMMAND_READ_BUFFER;	}
 	cl_command_type command_write_buffer::get_type() const	{	return CL_COMMAND_WRITE_BUFFER;	}
 	cl_command_type command_copy_buffer::get_type() const	{	return CL_COMMAND_COPY_BUFFER;	}
+	cl_command_type command_clone_buffer::get_type() const	{	return CL_COMMAND_CLONE_BUFFER_FREEOCL;	}
+	cl_command_type command_fence::get_type() const			{	return type;	}
+	cl_command_type command_read_file::get_type() const	{	return CL_COMMAND_READ_FILE_FREEOCL;	}
+	cl_command_type command_write_file::get_type() const	{	return CL_COMMAND_WRITE_FILE_FREEOCL;	}
 	cl_command_type command_fill_buffer::get_type() const	{	return CL_COMMAND_FILL_BUFFER;	}
 	cl_command_type command_fill_image::get_type() const	{	return CL_COMMAND_FILL_IMAGE;	}
 	cl_command_type command_map_buffer::get_type() const		{	return CL_COMMAND_MAP_BUFFER;	}
 	cl_command_type command_map_image::get_type() const		{	return CL_COMMAND_MAP_IMAGE;	}
 	cl_command_type command_unmap_buffer::get_type() const	{	return CL_COMMAND_UNMAP_MEM_OBJECT;	}
+	cl_command_type command_migrate_mem_objects::get_type() const	{	return CL_COMMAND_MIGRATE_MEM_OBJECTS;	}
+	cl_command_type command_usm_fill::get_type() const		{	return CL_COMMAND_MEMFILL_INTEL;	}
+	cl_command_type command_usm_copy::get_type() const		{	return CL_COMMAND_MEMCPY_INTEL;	}
+	cl_command_type command_usm_migrate::get_type() const	{	return CL_COMMAND_MIGRATEMEM_INTEL;	}
 	cl_command_type command_marker::get_type() const			{	return CL_COMMAND_MARKER;	}
 	cl_command_type command_native_kernel::get_type() const	{	return CL_COMMAND_NATIVE_KERNEL;	}
 	cl_command_type command_ndrange_kernel::get_type() const	{	return CL_COMMAND_NDRANGE_KERNEL;	}
+	cl_command_type command_ndrange_native_kernel::get_type() const	{	return CL_COMMAND_NDRANGE_NATIVE_KERNEL_FREEOCL;	}
+	cl_command_type command_command_buffer::get_type() const	{	return CL_COMMAND_COMMAND_BUFFER_KHR;	}
+
+	// Commands own their argument blocks so that recorded commands can be
+	// executed several times
+	command_fill_buffer::command_fill_buffer() : pattern(NULL)	{}
+	command_fill_buffer::~command_fill_buffer()	{	free(pattern);	}
+	command_usm_fill::command_usm_fill() : pattern(NULL)	{}
+	command_usm_fill::~command_usm_fill()	{	free(pattern);	}
+	command_fill_image::command_fill_image() : fill_color(NULL)	{}
+	command_fill_image::~command_fill_image()	{	free(fill_color);	}
+	command_native_kernel::command_native_kernel() : args(NULL), args_size(0)	{}
+	command_native_kernel::~command_native_kernel()
+	{
+		free(args);
+		process_memory_usage().release(CL_MEMORY_KIND_KERNEL_ARGS_FREEOCL, args_size);
+	}
+	command_ndrange_kernel::command_ndrange_kernel() : args(NULL), args_size(0)	{}
+	command_ndrange_kernel::~command_ndrange_kernel()
+	{
+		free(args);
+		// The kernel holds its program which holds the context
+		if (args_size)
+			kernel->program->context->memory.release(CL_MEMORY_KIND_KERNEL_ARGS_FREEOCL, args_size);
+	}
+	command_ndrange_native_kernel::command_ndrange_native_kernel() : args(NULL), args_size(0)	{}
+	command_ndrange_native_kernel::~command_ndrange_native_kernel()
+	{
+		free(args);
+		process_memory_usage().release(CL_MEMORY_KIND_KERNEL_ARGS_FREEOCL, args_size);
+	}
+
+	void command_native_kernel::set_args(const void *data, const size_t size)
+	{
+		args = malloc(size);
+		memcpy(args, data, size);
+		args_size = size;
+		process_memory_usage().add(CL_MEMORY_KIND_KERNEL_ARGS_FREEOCL, size);
+	}
+
+	void command_ndrange_kernel::set_args()
+	{
+		if (kernel->args_buffer.empty())
+			return;
+		args_size = kernel->args_buffer.size();
+		args = malloc(args_size);
+		memcpy(args, &(kernel->args_buffer.front()), args_size);
+		kernel->program->context->memory.add(CL_MEMORY_KIND_KERNEL_ARGS_FREEOCL, args_size);
+	}
+
+	void command_ndrange_native_kernel::set_args(const void *data, const size_t size)
+	{
+		args = malloc(size);
+		memcpy(args, data, size);
+		args_size = size;
+		process_memory_usage().add(CL_MEMORY_KIND_KERNEL_ARGS_FREEOCL, size);
+	}
+}
+
+namespace
+{
+	struct native_ndrange_job
+	{
+		const FreeOCL::command_ndrange_native_kernel *cmd;
+		size_t num_groups[3];
+	};
+
+	// Calls the native function for the work-group of linear index idx
+	void native_ndrange_group(void *data, const size_t idx)
+	{
+		const native_ndrange_job *job = static_cast<const native_ndrange_job*>(data);
+		const FreeOCL::command_ndrange_native_kernel *cmd = job->cmd;
+		cl_native_work_group_freeocl wg;
+		wg.work_dim = cmd->dim;
+		size_t r = idx;
+		for(size_t i = 0 ; i < 3 ; ++i)
+		{
+			wg.num_groups[i] = job->num_groups[i];
+			wg.group_id[i] = r % job->num_groups[i];
+			r /= job->num_groups[i];
+			const size_t first = wg.group_id[i] * cmd->local_size[i];
+			wg.global_offset[i] = cmd->global_offset[i] + first;
+			wg.local_size[i] = std::min(cmd->local_size[i], cmd->global_size[i] - first);
+		}
+		cmd->user_func(cmd->args, &wg);
+	}
 }
 
 extern "C"
@@ -109,8 +208,7 @@ extern "C"
 		if (!FreeOCL::is_valid(command_queue))
 			return CL_INVALID_COMMAND_QUEUE;
 
-		command_queue->release();
-		if (command_queue->get_ref_count() == 0)
+		if (command_queue->release())
 		{
 			command_queue->invalidate();
 			command_queue->unlock();
@@ -207,31 +305,62 @@ extern "C"
 }
 
 _cl_command_queue::_cl_command_queue(cl_context context)
-	: context_resource(context),
+	: context_resource(context, FreeOCL::MAGIC_COMMAND_QUEUE),
 	  q_thread(this),
 	  b_stop(false),
 	  b_working(false)
 {
-	FreeOCL::global_mutex.lock();
-	FreeOCL::valid_command_queues.insert(this);
-	FreeOCL::global_mutex.unlock();
+	magic = FreeOCL::MAGIC_COMMAND_QUEUE;
 }
 
 _cl_command_queue::~_cl_command_queue()
 {
 	b_stop = true;
-	FreeOCL::global_mutex.lock();
-	FreeOCL::valid_command_queues.erase(this);
-	FreeOCL::global_mutex.unlock();
+	magic = 0;
 
 	while(q_thread.running())
 		wakeup();
 	b_working = false;
+
+	// Events may still reference commands which will never run
+	for(std::deque<FreeOCL::smartptr<FreeOCL::command> >::iterator i = queue.begin() ; i != queue.end() ; ++i)
+	{
+		(*i)->queue_lock.lock();
+		(*i)->queue = NULL;
+		(*i)->queue_lock.unlock();
+	}
 }
 
 void _cl_command_queue::enqueue(const FreeOCL::smartptr<FreeOCL::command> &cmd)
 {
+	// Register the command as a successor of the events it waits for. The
+	// extra dependency prevents it from being seen as ready while this loop
+	// runs.
+	FreeOCL::command *ptr = const_cast<FreeOCL::command*>(cmd.weak());
+	ptr->queue = this;
+	ptr->pending_deps = 1;
 	queue.push_back(cmd);
+	for(size_t i = 0 ; i < cmd->num_events_in_wait_list ; ++i)
+	{
+		const cl_event e = cmd->event_wait_list[i];
+		if (!FreeOCL::is_valid(e))
+		{
+			ptr->b_dep_error = true;
+			continue;
+		}
+		if (e->status < 0)
+			ptr->b_dep_error = true;
+		else if (e->status != CL_COMPLETE)
+		{
+			e->successors.push_back(cmd);
+			__sync_add_and_fetch(&ptr->pending_deps, 1);
+		}
+		e->unlock();
+	}
+	// The wait list belongs to the caller, it must not be used anymore
+	ptr->num_events_in_wait_list = 0;
+	ptr->event_wait_list = NULL;
+	__sync_sub_and_fetch(&ptr->pending_deps, 1);
 	if (cmd->event)
 	{
 		cmd->event->lock();
@@ -266,37 +395,6 @@ bool _cl_command_queue::done()
 	return b;
 }
 
-bool is_command_ready_to_process(const FreeOCL::smartptr<FreeOCL::command> &cmd)
-{
-	if (cmd->event_wait_list == NULL)
-		return true;
-
-	const cl_event *events = cmd->event_wait_list;
-	bool b_error = false;
-	bool b_ready = true;
-	for(size_t i = 0 ; i < cmd->num_events_in_wait_list && !b_error && b_ready ; ++i)
-	{
-		if (!FreeOCL::is_valid(events[i]))
-		{
-			b_error = true;
-			break;
-		}
-		b_ready = (events[i]->status == CL_COMPLETE);
-		events[i]->unlock();
-	}
-	if (b_error)
-	{
-		if (cmd->event)
-		{
-			cmd->event->lock();
-			cmd->event.weak()->change_status(CL_INVALID_EVENT_WAIT_LIST);
-			cmd->event->unlock();
-		}
-		throw 0;
-	}
-	return b_ready;
-}
-
 size_t _cl_command_queue::proc()
 {
 	while(!b_stop)
@@ -314,60 +412,62 @@ size_t _cl_command_queue::proc()
 		}
 
 		FreeOCL::smartptr<FreeOCL::command> cmd = queue.front();
+		if (cmd->pending_deps && (properties & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE))
+		{
+			// Find something else to process, markers and barriers can't be
+			// overtaken
+			std::deque<FreeOCL::smartptr<FreeOCL::command> >::iterator i = queue.begin();
+			for(++i ; i != queue.end() && (*i)->get_type() != CL_COMMAND_MARKER && (*i)->pending_deps ; ++i)	{}
+
+			if (i == queue.end() || (*i)->get_type() == CL_COMMAND_MARKER)
+			{
+				// No choice, we must wait for an event to complete or for a
+				// new command
+				wait_locked();
+				unlock();
+				continue;
+			}
+			cmd = *i;
+			queue.erase(i);
+		}
+		else
+			queue.pop_front();
 		b_working = true;
-		queue.pop_front();
+
+		// Wait for events (those events are likely to come from another
+		// command queue or are user events). Their completion wakes us up.
+		while(cmd->pending_deps && !b_stop)
+			wait_locked();
 		unlock();
 
 		if (b_stop)
+		{
+			// The queue is being destroyed: like the commands left in the
+			// queue, this one must not be woken up by its events anymore
+			cmd->queue_lock.lock();
+			cmd->queue = NULL;
+			cmd->queue_lock.unlock();
 			break;
+		}
 
-		if (!is_command_ready_to_process(cmd))
+		if (cmd->b_dep_error)
 		{
-			if (properties & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE)
+			// Don't run commands whose dependencies failed
+			if (cmd->get_type() == CL_COMMAND_COMMAND_BUFFER_KHR)
 			{
-				// Find something else to process
-				std::deque<FreeOCL::smartptr<FreeOCL::command> > waiting_queue;
-				waiting_queue.push_front(cmd);
-
-				bool b_found = false;
-
-				lock();
-				while(!queue.empty() && !b_found)
-				{
-					cmd = queue.front();
-					queue.pop_front();
-					unlock();
-
-					if (cmd->get_type() == CL_COMMAND_MARKER)
-					{
-						lock();
-						queue.push_front(cmd);
-						break;
-					}
-
-					b_found = is_command_ready_to_process(cmd);
-					if (!b_found)
-						waiting_queue.push_front(cmd);
-
-					lock();
-				}
-
-				for(std::deque<FreeOCL::smartptr<FreeOCL::command> >::const_iterator i = waiting_queue.begin() ; i != waiting_queue.end() ; ++i)
-					queue.push_front(*i);
-
-				if (!b_found)		// No choice, we must try later
-				{
-					wait_locked();
-					unlock();
-					continue;
-				}
-				unlock();
+				cl_command_buffer_khr command_buffer = cmd.as<FreeOCL::command_command_buffer>()->command_buffer.weak();
+				command_buffer->lock();
+				if (--command_buffer->pending == 0)
+					command_buffer->state = CL_COMMAND_BUFFER_STATE_EXECUTABLE_KHR;
+				command_buffer->unlock();
 			}
-			else
+			if (cmd->event)
 			{
-				// Wait for events (those events are likely to come from another command queue or are user events)
-				clWaitForEventsFCL(cmd->num_events_in_wait_list, cmd->event_wait_list);
+				cmd->event->lock();
+				cmd->event->change_status(CL_EXEC_STATUS_ERROR_FOR_EVENTS_IN_WAIT_LIST);
+				cmd->event->unlock();
 			}
+			continue;
 		}
 
 		if (cmd->event)
@@ -377,200 +477,248 @@ size_t _cl_command_queue::proc()
 			cmd->event->unlock();
 		}
 
-		switch(cmd->get_type())
+		const cl_int status = process(cmd);
+
+		if (cmd->event)
 		{
-		case CL_COMMAND_READ_IMAGE:
-		case CL_COMMAND_READ_BUFFER_RECT:
-			{
-				char *dst_ptr = (char*)cmd.as<FreeOCL::command_read_buffer_rect>()->ptr;
-				const char *src_ptr = (const char*)cmd.as<FreeOCL::command_read_buffer_rect>()->buffer->ptr
-						+ cmd.as<FreeOCL::command_read_buffer_rect>()->offset;
-				const size_t src_row_pitch = cmd.as<FreeOCL::command_read_buffer_rect>()->buffer_pitch[0];
-				const size_t dst_row_pitch = cmd.as<FreeOCL::command_read_buffer_rect>()->host_pitch[0];
-				const size_t cb[3] = { cmd.as<FreeOCL::command_read_buffer_rect>()->cb[0],
-									   cmd.as<FreeOCL::command_read_buffer_rect>()->cb[1],
-									   cmd.as<FreeOCL::command_read_buffer_rect>()->cb[2] };
-				const size_t src_slice_pitch = cmd.as<FreeOCL::command_read_buffer_rect>()->buffer_pitch[1]
-						- src_row_pitch * cb[1];
-				const size_t dst_slice_pitch = cmd.as<FreeOCL::command_read_buffer_rect>()->host_pitch[1]
-						- dst_row_pitch * cb[1];
-				for(size_t z = 0 ; z < cb[2] ; ++z, src_ptr += src_slice_pitch, dst_ptr += dst_slice_pitch)
-					for(size_t y = 0 ; y < cb[1] ; ++y, src_ptr += src_row_pitch, dst_ptr += dst_row_pitch)
-						memcpy(dst_ptr, src_ptr, cb[0]);
-			}
-			break;
-		case CL_COMMAND_WRITE_IMAGE:
-		case CL_COMMAND_WRITE_BUFFER_RECT:
+			cmd->event->lock();
+			cmd->event->change_status(status);
+			cmd->event->unlock();
+		}
+	}
+	return 0;
+}
+
+cl_int _cl_command_queue::process(FreeOCL::smartptr<FreeOCL::command> &cmd)
+{
+	cl_int status = CL_COMPLETE;
+	switch(cmd->get_type())
+	{
+	case CL_COMMAND_READ_IMAGE:
+		{
+			const FreeOCL::command_read_image *ci = cmd.as<FreeOCL::command_read_image>();
+			const size_t zero[3] = { 0, 0, 0 };
+			FreeOCL::copy_image_rect(ci->ptr, FreeOCL::linear_layout(ci->buffer->element_size, ci->host_pitch[0], ci->host_pitch[1]), zero,
+									 ci->buffer->ptr, ci->buffer->layout, ci->origin,
+									 ci->region);
+		}
+		break;
+	case CL_COMMAND_READ_BUFFER_RECT:
+		{
+			const FreeOCL::command_read_buffer_rect *rect = cmd.as<FreeOCL::command_read_buffer_rect>();
+			FreeOCL::copy_rect(rect->ptr, rect->host_pitch[0], rect->host_pitch[1],
+							   (const char*)rect->buffer->ptr + rect->offset, rect->buffer_pitch[0], rect->buffer_pitch[1],
+							   rect->cb);
+		}
+		break;
+	case CL_COMMAND_WRITE_IMAGE:
+		{
+			const FreeOCL::command_write_image *ci = cmd.as<FreeOCL::command_write_image>();
+			const size_t zero[3] = { 0, 0, 0 };
+			FreeOCL::copy_image_rect(ci->buffer->ptr, ci->buffer->layout, ci->origin,
+									 ci->ptr, FreeOCL::linear_layout(ci->buffer->element_size, ci->host_pitch[0], ci->host_pitch[1]), zero,
+									 ci->region);
+		}
+		break;
+	case CL_COMMAND_WRITE_BUFFER_RECT:
+		{
+			const FreeOCL::command_write_buffer_rect *rect = cmd.as<FreeOCL::command_write_buffer_rect>();
+			FreeOCL::copy_rect((char*)rect->buffer->ptr + rect->offset, rect->buffer_pitch[0], rect->buffer_pitch[1],
+							   rect->ptr, rect->host_pitch[0], rect->host_pitch[1],
+							   rect->cb);
+		}
+		break;
+	case CL_COMMAND_COPY_IMAGE_TO_BUFFER:
+	case CL_COMMAND_COPY_BUFFER_TO_IMAGE:
+	case CL_COMMAND_COPY_IMAGE:
+		{
+			const FreeOCL::command_copy_image *ci = cmd.as<FreeOCL::command_copy_image>();
+			const bool b_src_buffer = ci->get_type() == CL_COMMAND_COPY_BUFFER_TO_IMAGE;
+			const bool b_dst_buffer = ci->get_type() == CL_COMMAND_COPY_IMAGE_TO_BUFFER;
+			const size_t element_size = b_src_buffer ? ci->dst_buffer->element_size : ci->src_buffer->element_size;
+			const FreeOCL::image_layout packed = FreeOCL::linear_layout(element_size,
+																		 ci->region[0] * element_size,
+																		 ci->region[0] * ci->region[1] * element_size);
+			FreeOCL::copy_image_rect((char*)ci->dst_buffer->ptr + ci->dst_offset, b_dst_buffer ? packed : ci->dst_buffer->layout, ci->dst_origin,
+									 (const char*)ci->src_buffer->ptr + ci->src_offset, b_src_buffer ? packed : ci->src_buffer->layout, ci->src_origin,
+									 ci->region);
+		}
+		break;
+	case CL_COMMAND_COPY_BUFFER_RECT:
+		{
+			const FreeOCL::command_copy_buffer_rect *rect = cmd.as<FreeOCL::command_copy_buffer_rect>();
+			FreeOCL::copy_rect((char*)rect->dst_buffer->ptr + rect->dst_offset, rect->dst_pitch[0], rect->dst_pitch[1],
+							   (const char*)rect->src_buffer->ptr + rect->src_offset, rect->src_pitch[0], rect->src_pitch[1],
+							   rect->cb);
+		}
+		break;
+	case CL_COMMAND_READ_BUFFER:
+		FreeOCL::parallel_memcpy(cmd.as<FreeOCL::command_read_buffer>()->ptr, (char*)cmd.as<FreeOCL::command_read_buffer>()->buffer->ptr + cmd.as<FreeOCL::command_read_buffer>()->offset, cmd.as<FreeOCL::command_read_buffer>()->cb);
+		break;
+	case CL_COMMAND_WRITE_BUFFER:
+		FreeOCL::parallel_memcpy((char*)cmd.as<FreeOCL::command_write_buffer>()->buffer->ptr + cmd.as<FreeOCL::command_write_buffer>()->offset, cmd.as<FreeOCL::command_write_buffer>()->ptr, cmd.as<FreeOCL::command_write_buffer>()->cb);
+		break;
+	case CL_COMMAND_COPY_BUFFER:
+		FreeOCL::parallel_memcpy((char*)cmd.as<FreeOCL::command_copy_buffer>()->dst_buffer->ptr + cmd.as<FreeOCL::command_copy_buffer>()->dst_offset,
+			   (char*)cmd.as<FreeOCL::command_copy_buffer>()->src_buffer->ptr + cmd.as<FreeOCL::command_copy_buffer>()->src_offset,
+			   cmd.as<FreeOCL::command_copy_buffer>()->cb);
+		break;
+	case CL_COMMAND_MIGRATE_MEM_OBJECTS:
+		{
+			const FreeOCL::command_migrate_mem_objects *cm = cmd.as<FreeOCL::command_migrate_mem_objects>();
+			for(size_t i = 0 ; i < cm->mem_objects.size() ; ++i)
+				FreeOCL::migrate_mem_object(cm->mem_objects[i].weak(), cm->flags);
+		}
+		break;
+	case CL_COMMAND_CLONE_BUFFER_FREEOCL:
+		{
+			const FreeOCL::command_clone_buffer *cc = cmd.as<FreeOCL::command_clone_buffer>();
+			// Clones of buffers which aren't cloneable are plain copies
+			if (cc->src_buffer->storage != FreeOCL::STORAGE_SHARED_FILE || cc->src_buffer->file != cc->dst_buffer->file)
+				FreeOCL::parallel_memcpy(cc->dst_buffer->ptr, cc->src_buffer->ptr, cc->src_buffer->size);
+			else if (!FreeOCL::clone_shared_file(cc->src_buffer->file, cc->src_buffer->ptr, cc->dst_buffer->ptr))
+				status = CL_OUT_OF_RESOURCES;
+		}
+		break;
+	case CL_COMMAND_SIGNAL_FENCE_FREEOCL:
+		{
+			const FreeOCL::command_fence *cf = cmd.as<FreeOCL::command_fence>();
+			FreeOCL::signal_fence(cf->buffer->file, cf->value);
+		}
+		break;
+	case CL_COMMAND_WAIT_FENCE_FREEOCL:
+		{
+			const FreeOCL::command_fence *cf = cmd.as<FreeOCL::command_fence>();
+			// The fence is signaled by another process: wake up from time to
+			// time in case the queue is being destroyed
+			while(!FreeOCL::wait_fence(cf->buffer->file, cf->value, 100000000U))
 			{
-				const char *src_ptr = (const char*)cmd.as<FreeOCL::command_write_buffer_rect>()->ptr;
-				char *dst_ptr = (char*)cmd.as<FreeOCL::command_write_buffer_rect>()->buffer->ptr
-						+ cmd.as<FreeOCL::command_write_buffer_rect>()->offset;
-				const size_t dst_row_pitch = cmd.as<FreeOCL::command_write_buffer_rect>()->buffer_pitch[0];
-				const size_t src_row_pitch = cmd.as<FreeOCL::command_write_buffer_rect>()->host_pitch[0];
-				const size_t cb[3] = { cmd.as<FreeOCL::command_write_buffer_rect>()->cb[0],
-									   cmd.as<FreeOCL::command_write_buffer_rect>()->cb[1],
-									   cmd.as<FreeOCL::command_write_buffer_rect>()->cb[2] };
-				const size_t dst_slice_pitch = cmd.as<FreeOCL::command_write_buffer_rect>()->buffer_pitch[1]
-						- dst_row_pitch * cb[1];
-				const size_t src_slice_pitch = cmd.as<FreeOCL::command_write_buffer_rect>()->host_pitch[1]
-						- src_row_pitch * cb[1];
-				for(size_t z = 0 ; z < cb[2] ; ++z, src_ptr += src_slice_pitch, dst_ptr += dst_slice_pitch)
-					for(size_t y = 0 ; y < cb[1] ; ++y, src_ptr += src_row_pitch, dst_ptr += dst_row_pitch)
-						memcpy(dst_ptr, src_ptr, cb[0]);
+				if (b_stop)
+				{
+					status = CL_INVALID_COMMAND_QUEUE;
+					break;
+				}
 			}
-			break;
-		case CL_COMMAND_COPY_IMAGE_TO_BUFFER:
-		case CL_COMMAND_COPY_BUFFER_TO_IMAGE:
-		case CL_COMMAND_COPY_IMAGE:
-		case CL_COMMAND_COPY_BUFFER_RECT:
+		}
+		break;
+	case CL_COMMAND_MAP_IMAGE:
+	case CL_COMMAND_MAP_BUFFER:
+		FreeOCL::load_image_mapping(cmd.as<FreeOCL::command_map_buffer>()->buffer.weak(), cmd.as<FreeOCL::command_map_buffer>()->ptr);
+		cmd.as<FreeOCL::command_map_buffer>()->buffer->lock();
+		cmd.as<FreeOCL::command_map_buffer>()->buffer->mapped.insert(cmd.as<FreeOCL::command_map_buffer>()->ptr);
+		cmd.as<FreeOCL::command_map_buffer>()->buffer->unlock();
+		break;
+	case CL_COMMAND_UNMAP_MEM_OBJECT:
+		cmd.as<FreeOCL::command_unmap_buffer>()->buffer->lock();
+		cmd.as<FreeOCL::command_unmap_buffer>()->buffer->mapped.erase(cmd.as<FreeOCL::command_unmap_buffer>()->ptr);
+		cmd.as<FreeOCL::command_unmap_buffer>()->buffer->unlock();
+		FreeOCL::unload_image_mapping(cmd.as<FreeOCL::command_unmap_buffer>()->buffer.weak(), cmd.as<FreeOCL::command_unmap_buffer>()->ptr);
+		break;
+	case CL_COMMAND_NATIVE_KERNEL:
+		cmd.as<FreeOCL::command_native_kernel>()->user_func(cmd.as<FreeOCL::command_native_kernel>()->args);
+		break;
+	case CL_COMMAND_NDRANGE_KERNEL:
+		{
+			FreeOCL::command_ndrange_kernel *ptr = cmd.as<FreeOCL::command_ndrange_kernel>();
+			// The thread pool is shared by all command queues
+			device->pool->lock();
+			const bool b_use_sync = ptr->kernel->__FCL_init(ptr->args,
+															ptr->dim,
+															ptr->global_offset,
+															ptr->global_size,
+															ptr->local_size);
+			device->pool->set_local_size(ptr->local_size);
+			device->pool->set_require_sync(b_use_sync);
+			device->pool->set_thread_num(device->cpu_cores);
+			const size_t num_groups[3] = { ptr->global_size[0] / ptr->local_size[0],
+										   ptr->global_size[1] / ptr->local_size[1],
+										   ptr->global_size[2] / ptr->local_size[2] };
+			device->pool->set_num_groups(num_groups);
+			device->pool->run(ptr->kernel->__FCL_setwg, ptr->kernel->__FCL_kernel);
+			device->pool->unlock();
+		}
+		break;
+	case CL_COMMAND_NDRANGE_NATIVE_KERNEL_FREEOCL:
+		{
+			native_ndrange_job job;
+			job.cmd = cmd.as<FreeOCL::command_ndrange_native_kernel>();
+			size_t nb_groups = 1;
+			for(size_t i = 0 ; i < 3 ; ++i)
 			{
-				const char *src_ptr = (const char*)cmd.as<FreeOCL::command_copy_buffer_rect>()->src_buffer->ptr
-									  + cmd.as<FreeOCL::command_copy_buffer_rect>()->src_offset;
-				char *dst_ptr = (char*)cmd.as<FreeOCL::command_copy_buffer_rect>()->dst_buffer->ptr
-								+ cmd.as<FreeOCL::command_copy_buffer_rect>()->dst_offset;
-				const size_t dst_row_pitch = cmd.as<FreeOCL::command_copy_buffer_rect>()->dst_pitch[0];
-				const size_t src_row_pitch = cmd.as<FreeOCL::command_copy_buffer_rect>()->src_pitch[0];
-				const size_t cb[3] = { cmd.as<FreeOCL::command_copy_buffer_rect>()->cb[0],
-									   cmd.as<FreeOCL::command_copy_buffer_rect>()->cb[1],
-									   cmd.as<FreeOCL::command_copy_buffer_rect>()->cb[2] };
-				const size_t dst_slice_pitch = cmd.as<FreeOCL::command_copy_buffer_rect>()->dst_pitch[1]
-						- dst_row_pitch * cb[1];
-				const size_t src_slice_pitch = cmd.as<FreeOCL::command_copy_buffer_rect>()->src_pitch[1]
-						- src_row_pitch * cb[1];
-				for(size_t z = 0 ; z < cb[2] ; ++z, src_ptr += src_slice_pitch, dst_ptr += dst_slice_pitch)
-					for(size_t y = 0 ; y < cb[1] ; ++y, src_ptr += src_row_pitch, dst_ptr += dst_row_pitch)
-						memcpy(dst_ptr, src_ptr, cb[0]);
+				job.num_groups[i] = (job.cmd->global_size[i] + job.cmd->local_size[i] - 1) / job.cmd->local_size[i];
+				nb_groups *= job.num_groups[i];
 			}
-			break;
-		case CL_COMMAND_READ_BUFFER:
-			memcpy(cmd.as<FreeOCL::command_read_buffer>()->ptr, (char*)cmd.as<FreeOCL::command_read_buffer>()->buffer->ptr + cmd.as<FreeOCL::command_read_buffer>()->offset, cmd.as<FreeOCL::command_read_buffer>()->cb);
-			break;
-		case CL_COMMAND_WRITE_BUFFER:
-			memcpy((char*)cmd.as<FreeOCL::command_write_buffer>()->buffer->ptr + cmd.as<FreeOCL::command_write_buffer>()->offset, cmd.as<FreeOCL::command_write_buffer>()->ptr, cmd.as<FreeOCL::command_write_buffer>()->cb);
-			break;
-		case CL_COMMAND_COPY_BUFFER:
-			memcpy((char*)cmd.as<FreeOCL::command_copy_buffer>()->dst_buffer->ptr + cmd.as<FreeOCL::command_copy_buffer>()->dst_offset,
-				   (char*)cmd.as<FreeOCL::command_copy_buffer>()->src_buffer->ptr + cmd.as<FreeOCL::command_copy_buffer>()->src_offset,
-				   cmd.as<FreeOCL::command_copy_buffer>()->cb);
-			break;
-		case CL_COMMAND_MAP_IMAGE:
-		case CL_COMMAND_MAP_BUFFER:
-			cmd.as<FreeOCL::command_map_buffer>()->buffer->lock();
-			cmd.as<FreeOCL::command_map_buffer>()->buffer->mapped.insert(cmd.as<FreeOCL::command_map_buffer>()->ptr);
-			cmd.as<FreeOCL::command_map_buffer>()->buffer->unlock();
-			break;
-		case CL_COMMAND_UNMAP_MEM_OBJECT:
-			cmd.as<FreeOCL::command_unmap_buffer>()->buffer->lock();
-			cmd.as<FreeOCL::command_unmap_buffer>()->buffer->mapped.erase(cmd.as<FreeOCL::command_unmap_buffer>()->ptr);
-			cmd.as<FreeOCL::command_unmap_buffer>()->buffer->unlock();
-			break;
-		case CL_COMMAND_NATIVE_KERNEL:
-			cmd.as<FreeOCL::command_native_kernel>()->user_func(cmd.as<FreeOCL::command_native_kernel>()->args);
-			free(cmd.as<FreeOCL::command_native_kernel>()->args);
-			break;
-		case CL_COMMAND_NDRANGE_KERNEL:
-			{
-				FreeOCL::command_ndrange_kernel *ptr = cmd.as<FreeOCL::command_ndrange_kernel>();
-				const bool b_use_sync = ptr->kernel->__FCL_init(ptr->args,
-																ptr->dim,
-																ptr->global_offset,
-																ptr->global_size,
-																ptr->local_size);
-				device->pool->set_local_size(ptr->local_size);
-				device->pool->set_require_sync(b_use_sync);
-				device->pool->set_thread_num(device->cpu_cores);
-				const size_t num_groups[3] = { ptr->global_size[0] / ptr->local_size[0],
-											   ptr->global_size[1] / ptr->local_size[1],
-											   ptr->global_size[2] / ptr->local_size[2] };
-				device->pool->set_num_groups(num_groups);
-                device->pool->run(ptr->kernel->__FCL_setwg, ptr->kernel->__FCL_kernel);
-                if (ptr->args)
-					free(ptr->args);
-            }
-			break;
-		case CL_COMMAND_FILL_BUFFER:
+			// Work-groups are scheduled on the shared thread pool like
+			// OpenCL kernels
+			device->pool->run_tasks_locked(native_ndrange_group, &job, nb_groups, device->cpu_cores);
+		}
+		break;
+	case CL_COMMAND_READ_FILE_FREEOCL:
+	case CL_COMMAND_WRITE_FILE_FREEOCL:
+		{
+			const FreeOCL::command_read_file *cf = cmd.as<FreeOCL::command_read_file>();
+			if (!FreeOCL::parallel_file_io(cf->fd, cf->file_offset,
+										   cf->offset + (char*)cf->buffer->ptr, cf->cb,
+										   cf->get_type() == CL_COMMAND_READ_FILE_FREEOCL))
+				status = CL_FILE_IO_ERROR_FREEOCL;
+		}
+		break;
+	case CL_COMMAND_FILL_BUFFER:
+		{
+			FreeOCL::command_fill_buffer *cfb = cmd.as<FreeOCL::command_fill_buffer>();
+			// Pages can only be discarded when FreeOCL owns private anonymous
+			// storage: discarded pages of a file mapping would be read again
+			const cl_mem root = cfb->buffer->parent ? cfb->buffer->parent : cfb->buffer.weak();
+			// Buffers nothing has written to still hold the zeros of a new mapping
+			if (root->b_zero && FreeOCL::is_zero(cfb->pattern, cfb->pattern_size))
+				break;
+			FreeOCL::parallel_fill(cfb->offset + (char*)cfb->buffer->ptr, cfb->size,
+								   cfb->pattern, cfb->pattern_size,
+								   root->storage == FreeOCL::STORAGE_ALLOCATED);
+		}
+		break;
+	case CL_COMMAND_FILL_IMAGE:
+		cmd.as<FreeOCL::command_fill_image>()->process();
+		break;
+	case CL_COMMAND_MEMFILL_INTEL:
+		{
+			const FreeOCL::command_usm_fill *cf = cmd.as<FreeOCL::command_usm_fill>();
+			FreeOCL::parallel_fill(cf->ptr, cf->size, cf->pattern, cf->pattern_size, cf->b_discard);
+		}
+		break;
+	case CL_COMMAND_MEMCPY_INTEL:
+		{
+			const FreeOCL::command_usm_copy *cc = cmd.as<FreeOCL::command_usm_copy>();
+			FreeOCL::parallel_memcpy(cc->dst_ptr, cc->src_ptr, cc->size);
+		}
+		break;
+	case CL_COMMAND_MIGRATEMEM_INTEL:
+		{
+			const FreeOCL::command_usm_migrate *cm = cmd.as<FreeOCL::command_usm_migrate>();
+			if (cm->flags & CL_MIGRATE_MEM_OBJECT_CONTENT_UNDEFINED)
 			{
-				FreeOCL::command_fill_buffer *cfb = cmd.as<FreeOCL::command_fill_buffer>();
-				const size_t nb_elts = cfb->size / cfb->pattern_size;
-				switch(cfb->pattern_size)
-				{
-				case 1:
-					memset(cfb->offset + (char*)cfb->buffer->ptr, *(char*)cfb->pattern, cfb->size);
-					break;
-				case 2:
-					{
-						cl_ushort * const ptr = (cfb->offset >> 1) + (cl_ushort*)cfb->buffer->ptr;
-						const cl_ushort &pattern = *(const cl_ushort*)cfb->pattern;
-						for(size_t i = 0 ; i < nb_elts ; ++i)
-							ptr[i] = pattern;
-					}
-					break;
-				case 4:
-					{
-						cl_uint * const ptr = (cfb->offset >> 2) + (cl_uint*)cfb->buffer->ptr;
-						const cl_uint &pattern = *(const cl_uint*)cfb->pattern;
-						for(size_t i = 0 ; i < nb_elts ; ++i)
-							ptr[i] = pattern;
-					}
-					break;
-				case 8:
-					{
-						cl_ulong * const ptr = (cfb->offset >> 3) + (cl_ulong*)cfb->buffer->ptr;
-						const cl_ulong &pattern = *(const cl_ulong*)cfb->pattern;
-						for(size_t i = 0 ; i < nb_elts ; ++i)
-							ptr[i] = pattern;
-					}
-					break;
-				case 16:
-					{
-						cl_float4 * const ptr = (cfb->offset >> 4) + (cl_float4*)cfb->buffer->ptr;
-						const cl_float4 &pattern = *(const cl_float4*)cfb->pattern;
-						for(size_t i = 0 ; i < nb_elts ; ++i)
-							ptr[i] = pattern;
-					}
-					break;
-				case 32:
-					{
-						cl_float8 * const ptr = (cfb->offset >> 5) + (cl_float8*)cfb->buffer->ptr;
-						const cl_float8 &pattern = *(const cl_float8*)cfb->pattern;
-						for(size_t i = 0 ; i < nb_elts ; ++i)
-							ptr[i] = pattern;
-					}
-					break;
-				case 64:
-					{
-						cl_float16 * const ptr = (cfb->offset >> 6) + (cl_float16*)cfb->buffer->ptr;
-						const cl_float16 &pattern = *(const cl_float16*)cfb->pattern;
-						for(size_t i = 0 ; i < nb_elts ; ++i)
-							ptr[i] = pattern;
-					}
-					break;
-				case 128:
-					{
-						cl_double16 * const ptr = (cfb->offset >> 7) + (cl_double16*)cfb->buffer->ptr;
-						const cl_double16 &pattern = *(const cl_double16*)cfb->pattern;
-						for(size_t i = 0 ; i < nb_elts ; ++i)
-							ptr[i] = pattern;
-					}
-					break;
-				}
-				free(cfb->pattern);
+				if (cm->b_anonymous)
+					FreeOCL::discard_memory(cm->ptr, cm->size, true);
 			}
-			break;
-		case CL_COMMAND_FILL_IMAGE:
-			cmd.as<FreeOCL::command_fill_image>()->process();
-			free(cmd.as<FreeOCL::command_fill_image>()->fill_color);
-			break;
+			else if (!(cm->flags & CL_MIGRATE_MEM_OBJECT_HOST))
+				FreeOCL::prefault_memory(cm->ptr, cm->size, cm->numa_policy, cm->b_anonymous);
 		}
-
-		if (cmd->event)
+		break;
+	case CL_COMMAND_COMMAND_BUFFER_KHR:
 		{
-			cmd->event->lock();
-			cmd->event->change_status(CL_COMPLETE);
-			cmd->event->unlock();
+			cl_command_buffer_khr command_buffer = cmd.as<FreeOCL::command_command_buffer>()->command_buffer.weak();
+			// Recorded commands run in order so sync points are always satisfied
+			for(std::vector<FreeOCL::smartptr<FreeOCL::command> >::iterator i = command_buffer->commands.begin() ; i != command_buffer->commands.end() && status == CL_COMPLETE ; ++i)
+				status = process(*i);
+
+			command_buffer->lock();
+			if (--command_buffer->pending == 0)
+				command_buffer->state = CL_COMMAND_BUFFER_STATE_EXECUTABLE_KHR;
+			command_buffer->unlock();
 		}
+		break;
 	}
-	return 0;
+	return status;
 }
 
 size_t _cl_command_queue::thread::proc()
@@ -33,8 +33,17 @@ namespace FreeOCL
 		smartptr<_cl_event>	event;
 		cl_uint				num_events_in_wait_list;
 		const cl_event		*event_wait_list;
-
-		command_common()
+		// Queue the command has been enqueued in. It is protected by queue_lock
+		// and not by the command lock since the queue locks commands while
+		// locked itself.
+		cl_command_queue	queue;
+		mutex				queue_lock;
+		// Number of events of the wait list which are not complete yet
+		volatile cl_uint	pending_deps;
+		// Set when an event of the wait list failed or was destroyed
+		volatile bool		b_dep_error;
+
+		command_common() : queue(NULL), pending_deps(0), b_dep_error(false)
 		{
 			ref_counter::release();
 		}
@@ -74,6 +83,40 @@ namespace FreeOCL
 		virtual cl_command_type get_type() const;
 	};
 
+	struct command_clone_buffer : public command_common
+	{
+		smartptr<_cl_mem> src_buffer;
+		smartptr<_cl_mem> dst_buffer;
+
+		virtual cl_command_type get_type() const;
+	};
+
+	// Signals or waits for the fence of a shareable buffer
+	struct command_fence : public command_common
+	{
+		smartptr<_cl_mem> buffer;
+		cl_uint value;
+		cl_command_type type;
+
+		virtual cl_command_type get_type() const;
+	};
+
+	struct command_read_file : public command_common
+	{
+		smartptr<_cl_mem> buffer;
+		size_t offset;
+		size_t cb;
+		int fd;
+		cl_ulong file_offset;
+
+		virtual cl_command_type get_type() const;
+	};
+
+	struct command_write_file : public command_read_file
+	{
+		virtual cl_command_type get_type() const;
+	};
+
 	struct command_fill_buffer : public command_common
 	{
 		smartptr<_cl_mem> buffer;
@@ -82,6 +125,9 @@ namespace FreeOCL
 		void *pattern;
 		size_t pattern_size;
 
+		command_fill_buffer();
+		virtual ~command_fill_buffer();
+
 		virtual cl_command_type get_type() const;
 	};
 
@@ -112,11 +158,13 @@ namespace FreeOCL
 	struct command_fill_image : public command_common
 	{
 		smartptr<_cl_mem> buffer;
-		size_t offset;
-		size_t cb[3];
-		size_t buffer_pitch[2];
+		size_t origin[3];
+		size_t region[3];
 		void *fill_color;
 
+		command_fill_image();
+		virtual ~command_fill_image();
+
 		virtual cl_command_type get_type() const;
 
 		void process() const;
@@ -135,27 +183,51 @@ namespace FreeOCL
 		virtual cl_command_type get_type() const;
 	};
 
-	struct command_read_image : public command_read_buffer_rect
+	// Images are addressed in texels since their storage may be tiled (see
+	// image_layout)
+	struct command_read_image : public command_common
 	{
+		smartptr<_cl_mem> buffer;
+		size_t origin[3];
+		size_t region[3];
+		size_t host_pitch[2];
+		void *ptr;
+
 		virtual cl_command_type get_type() const;
 	};
 
-	struct command_write_image : public command_write_buffer_rect
+	struct command_write_image : public command_common
 	{
+		smartptr<_cl_mem> buffer;
+		size_t origin[3];
+		size_t region[3];
+		size_t host_pitch[2];
+		const void *ptr;
+
 		virtual cl_command_type get_type() const;
 	};
 
-	struct command_copy_image : public command_copy_buffer_rect
+	// The buffer of a copy between an image and a buffer holds the region
+	// tightly packed from its offset
+	struct command_copy_image : public command_common
 	{
+		smartptr<_cl_mem> src_buffer;
+		smartptr<_cl_mem> dst_buffer;
+		size_t src_offset;
+		size_t dst_offset;
+		size_t src_origin[3];
+		size_t dst_origin[3];
+		size_t region[3];
+
 		virtual cl_command_type get_type() const;
 	};
 
-	struct command_copy_image_to_buffer : public command_copy_buffer_rect
+	struct command_copy_image_to_buffer : public command_copy_image
 	{
 		virtual cl_command_type get_type() const;
 	};
 
-	struct command_copy_buffer_to_image : public command_copy_buffer_rect
+	struct command_copy_buffer_to_image : public command_copy_image
 	{
 		virtual cl_command_type get_type() const;
 	};
@@ -178,6 +250,49 @@ namespace FreeOCL
 		virtual cl_command_type get_type() const;
 	};
 
+	struct command_migrate_mem_objects : public command_common
+	{
+		std::vector<smartptr<_cl_mem> > mem_objects;
+		cl_mem_migration_flags flags;
+
+		virtual cl_command_type get_type() const;
+	};
+
+	// Commands of cl_intel_unified_shared_memory, on raw pointers
+	struct command_usm_fill : public command_common
+	{
+		void *ptr;
+		size_t size;
+		void *pattern;
+		size_t pattern_size;
+		bool b_discard;		// ptr is in private anonymous storage FreeOCL owns
+
+		command_usm_fill();
+		virtual ~command_usm_fill();
+
+		virtual cl_command_type get_type() const;
+	};
+
+	struct command_usm_copy : public command_common
+	{
+		void *dst_ptr;
+		const void *src_ptr;
+		size_t size;
+
+		virtual cl_command_type get_type() const;
+	};
+
+	struct command_usm_migrate : public command_common
+	{
+		void *ptr;
+		size_t size;
+		cl_mem_migration_flags flags;
+		cl_mem_flags numa_policy;
+		bool b_anonymous;	// as b_discard
+
+		virtual cl_command_type get_type() const;
+	};
+
 	struct command_marker : public command_common
 	{
 		virtual cl_command_type get_type() const;
@@ -187,6 +302,13 @@ namespace FreeOCL
 	{
 		void (*user_func)(void *);
 		void *args;
+		size_t args_size;
+
+		command_native_kernel();
+		// Copies the arguments, native kernels have no context so they are
+		// counted in the memory usage of the process
+		void set_args(const void *data, const size_t size);
+		virtual ~command_native_kernel();
 
 		virtual cl_command_type get_type() const;
 	};
@@ -195,11 +317,43 @@ namespace FreeOCL
 	{
 		smartptr<_cl_kernel> kernel;
 		void *args;
+		size_t args_size;
+		cl_uint dim;
+		size_t global_offset[3];
+		size_t global_size[3];
+		size_t local_size[3];
+
+		command_ndrange_kernel();
+		// Copies the arguments set on kernel, which must be set first, and
+		// counts them in the memory usage of its context
+		void set_args();
+		virtual ~command_ndrange_kernel();
+
+		virtual cl_command_type get_type() const;
+	};
+
+	struct command_ndrange_native_kernel : public command_common
+	{
+		cl_native_ndrange_func_freeocl user_func;
+		void *args;
+		size_t args_size;
 		cl_uint dim;
 		size_t global_offset[3];
 		size_t global_size[3];
 		size_t local_size[3];
 
+		command_ndrange_native_kernel();
+		// Same as command_native_kernel::set_args
+		void set_args(const void *data, const size_t size);
+		virtual ~command_ndrange_native_kernel();
+
+		virtual cl_command_type get_type() const;
+	};
+
+	struct command_command_buffer : public command_common
+	{
+		smartptr<_cl_command_buffer_khr> command_buffer;
+
 		virtual cl_command_type get_type() const;
 	};
 
@@ -234,10 +388,13 @@ private:
 public:
 	bool empty();
 	bool done();
+	inline bool is_queue_thread() const	{	return q_thread.is_current();	}
 	void enqueue(const FreeOCL::smartptr<FreeOCL::command> &cmd);
 
 private:
     size_t proc();
+	// Returns CL_COMPLETE or a negative error code
+	cl_int process(FreeOCL::smartptr<FreeOCL::command> &cmd);
 };
 
 #endif
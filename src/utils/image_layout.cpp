@@ -0,0 +1,224 @@
+/*
+	FreeOCL - a free OpenCL implementation for CPU
+	Copyright (C) 2011  Roland Brochard
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include "image_layout.h"
+#include "memops.h"
+#include "threadpool.h"
+#include "device.h"
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+namespace
+{
+	// Below this size, copying on the calling thread is faster than waking
+	// up the workers
+	const size_t parallel_threshold = 0x400000;
+	// Smallest number of bytes handed to a worker
+	const size_t min_chunk_size = 0x100000;
+
+	bool read_tiled_default()
+	{
+		const char *env = getenv("FREEOCL_IMAGE_LAYOUT");
+		return env && !strcmp(env, "tiled");
+	}
+
+	inline cl_uint log2(size_t n)
+	{
+		cl_uint l = 0;
+		while(n > 1)
+		{
+			n >>= 1;
+			++l;
+		}
+		return l;
+	}
+
+	struct image_job
+	{
+		char *dst;
+		const char *src;		// NULL for fills
+		const FreeOCL::image_layout *dst_layout;
+		const FreeOCL::image_layout *src_layout;
+		size_t dst_origin[3];
+		size_t src_origin[3];
+		size_t width, height;	// of the region
+		size_t rows_per_task;
+		size_t nb_rows;
+		// Copies of the texel of fills, as long as any run of a tiled layout
+		char block[FreeOCL::image_layout::tile_size];
+	};
+
+	// Processes rows [first, last) of the region, rows being numbered slice
+	// by slice, run by run
+	void image_rows(const image_job *job, size_t first, const size_t last)
+	{
+		const FreeOCL::image_layout &dl = *job->dst_layout;
+		const size_t element_size = dl.element_size;
+		for(; first < last ; ++first)
+		{
+			const size_t y = first % job->height;
+			const size_t z = first / job->height;
+			for(size_t x = 0 ; x < job->width ; )
+			{
+				size_t n = std::min(job->width - x, dl.run(job->dst_origin[0] + x));
+				char *dst = job->dst + dl.offset(job->dst_origin[0] + x, job->dst_origin[1] + y, job->dst_origin[2] + z);
+				if (job->src)
+				{
+					const FreeOCL::image_layout &sl = *job->src_layout;
+					n = std::min(n, sl.run(job->src_origin[0] + x));
+					memcpy(dst, job->src + sl.offset(job->src_origin[0] + x, job->src_origin[1] + y, job->src_origin[2] + z), n * element_size);
+				}
+				else
+					memcpy(dst, job->block, n * element_size);
+				x += n;
+			}
+		}
+	}
+
+	void image_chunk(void *data, const size_t id)
+	{
+		const image_job *job = (const image_job*)data;
+		const size_t first = id * job->rows_per_task;
+		image_rows(job, first, std::min(job->nb_rows, first + job->rows_per_task));
+	}
+
+	void run_image_job(image_job &job, const size_t region[3])
+	{
+		job.width = region[0];
+		job.height = region[1];
+		job.nb_rows = region[1] * region[2];
+		const size_t size = region[0] * job.nb_rows * job.dst_layout->element_size;
+		if (size < parallel_threshold || FreeOCL::device->cpu_cores <= 1)
+		{
+			image_rows(&job, 0, job.nb_rows);
+			return;
+		}
+
+		const size_t nb_chunks = std::max<size_t>(1, std::min<size_t>(FreeOCL::device->cpu_cores * 4, size / min_chunk_size));
+		job.rows_per_task = (job.nb_rows + nb_chunks - 1) / nb_chunks;
+
+		FreeOCL::device->pool->run_tasks_locked(image_chunk, &job, (job.nb_rows + job.rows_per_task - 1) / job.rows_per_task, FreeOCL::device->cpu_cores);
+	}
+}
+
+namespace FreeOCL
+{
+	image_layout linear_layout(const size_t element_size, const size_t row_pitch, const size_t slice_pitch)
+	{
+		image_layout layout;
+		layout.element_size = element_size;
+		layout.row_pitch = row_pitch;
+		layout.slice_pitch = slice_pitch;
+		layout.tile_shift[0] = layout.tile_shift[1] = layout.tile_shift[2] = 0;
+		return layout;
+	}
+
+	bool use_tiled_layout(const cl_mem_flags flags)
+	{
+		static const bool b_default = read_tiled_default();
+		if (flags & CL_MEM_USE_HOST_PTR)
+			return false;
+		return b_default || (flags & CL_MEM_TILED_FREEOCL);
+	}
+
+	size_t tile_layout(image_layout &layout, const size_t width, const size_t height, const size_t depth)
+	{
+		// Formats have 1 to 16 bytes per texel, always a power of two
+		if (layout.element_size & (layout.element_size - 1))
+			return 0;
+		// Tiles are as close to squares or cubes as possible
+		const cl_uint bits = log2(image_layout::tile_size / layout.element_size);
+		cl_uint shift[3];
+		if (depth > 1)
+		{
+			shift[0] = (bits + 2) / 3;
+			shift[1] = (bits + 1) / 3;
+			shift[2] = bits / 3;
+		}
+		else
+		{
+			shift[0] = (bits + 1) / 2;
+			shift[1] = bits / 2;
+			shift[2] = 0;
+		}
+		if (width < (size_t(1) << shift[0])
+			|| height < (size_t(1) << shift[1])
+			|| depth < (size_t(1) << shift[2]))
+			return 0;
+
+		const size_t tiles_x = (width + (size_t(1) << shift[0]) - 1) >> shift[0];
+		const size_t tiles_y = (height + (size_t(1) << shift[1]) - 1) >> shift[1];
+		const size_t tiles_z = (depth + (size_t(1) << shift[2]) - 1) >> shift[2];
+		layout.row_pitch = tiles_x * image_layout::tile_size;
+		layout.slice_pitch = tiles_y * layout.row_pitch;
+		for(size_t i = 0 ; i < 3 ; ++i)
+			layout.tile_shift[i] = shift[i];
+		return tiles_z * layout.slice_pitch;
+	}
+
+	void copy_image_rect(void *dst, const image_layout &dst_layout, const size_t dst_origin[3],
+						 const void *src, const image_layout &src_layout, const size_t src_origin[3],
+						 const size_t region[3])
+	{
+		if (!dst_layout.is_tiled() && !src_layout.is_tiled())
+		{
+			const size_t cb[3] = { region[0] * dst_layout.element_size, region[1], region[2] };
+			copy_rect((char*)dst + dst_layout.offset(dst_origin[0], dst_origin[1], dst_origin[2]),
+					  dst_layout.row_pitch, dst_layout.slice_pitch,
+					  (const char*)src + src_layout.offset(src_origin[0], src_origin[1], src_origin[2]),
+					  src_layout.row_pitch, src_layout.slice_pitch,
+					  cb);
+			return;
+		}
+
+		image_job job;
+		job.dst = (char*)dst;
+		job.src = (const char*)src;
+		job.dst_layout = &dst_layout;
+		job.src_layout = &src_layout;
+		for(size_t i = 0 ; i < 3 ; ++i)
+		{
+			job.dst_origin[i] = dst_origin[i];
+			job.src_origin[i] = src_origin[i];
+		}
+		run_image_job(job, region);
+	}
+
+	void fill_image_rect(void *dst, const image_layout &layout, const size_t origin[3], const size_t region[3], const void *texel)
+	{
+		if (!layout.is_tiled())
+		{
+			const size_t cb[3] = { region[0] * layout.element_size, region[1], region[2] };
+			fill_rect((char*)dst + layout.offset(origin[0], origin[1], origin[2]),
+					  layout.row_pitch, layout.slice_pitch,
+					  cb, texel, layout.element_size);
+			return;
+		}
+
+		image_job job;
+		job.dst = (char*)dst;
+		job.src = NULL;
+		job.dst_layout = &layout;
+		job.src_layout = NULL;
+		for(size_t i = 0 ; i < 3 ; ++i)
+			job.dst_origin[i] = origin[i];
+		for(size_t i = 0 ; i < sizeof(job.block) ; i += layout.element_size)
+			memcpy(job.block + i, texel, layout.element_size);
+		run_image_job(job, region);
+	}
+}
@@ -0,0 +1,90 @@
+/*
+	FreeOCL - a free OpenCL implementation for CPU
+	Copyright (C) 2011  Roland Brochard
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#ifndef __FREEOCL_UTILS_IMAGE_LAYOUT_H__
+#define __FREEOCL_UTILS_IMAGE_LAYOUT_H__
+
+#include <cstddef>
+#include <CL/cl_freeocl.h>
+
+namespace FreeOCL
+{
+	// Where the texels of an image are in its storage. Linear layouts store
+	// rows one after the other. Tiled layouts store tiles of 4KB one after
+	// the other, row of tiles by row of tiles, each tile holding a block of
+	// texels row by row, so that texels close in 2D or 3D are close in memory
+	// and a tile is a page. Must match __texel_offset from
+	// include/FreeOCL/image2d_t.h and image3d_t.h.
+	struct image_layout
+	{
+		size_t element_size;
+		size_t row_pitch;		// bytes between rows, or rows of tiles
+		size_t slice_pitch;		// bytes between slices, or slices of tiles
+		cl_uint tile_shift[3];	// log2 of the tile size in texels, 0 when linear
+
+		inline bool is_tiled() const	{	return tile_shift[0] != 0;	}
+
+		inline size_t offset(const size_t x, const size_t y, const size_t z) const
+		{
+			if (!is_tiled())
+				return x * element_size + y * row_pitch + z * slice_pitch;
+			const size_t mask_x = (size_t(1) << tile_shift[0]) - 1;
+			const size_t mask_y = (size_t(1) << tile_shift[1]) - 1;
+			const size_t mask_z = (size_t(1) << tile_shift[2]) - 1;
+			const size_t texel = ((((z & mask_z) << tile_shift[1]) | (y & mask_y)) << tile_shift[0]) | (x & mask_x);
+			return (x >> tile_shift[0]) * tile_size
+					+ (y >> tile_shift[1]) * row_pitch
+					+ (z >> tile_shift[2]) * slice_pitch
+					+ texel * element_size;
+		}
+
+		// Number of texels stored contiguously from column x on
+		inline size_t run(const size_t x) const
+		{
+			return is_tiled() ? (size_t(1) << tile_shift[0]) - (x & ((size_t(1) << tile_shift[0]) - 1)) : ~size_t(0);
+		}
+
+		static const size_t tile_size = 4096;
+	};
+
+	image_layout linear_layout(const size_t element_size, const size_t row_pitch, const size_t slice_pitch);
+
+	// Returns true if images created with flags should be tiled: with
+	// CL_MEM_TILED_FREEOCL, or by default when FREEOCL_IMAGE_LAYOUT is
+	// "tiled". Images using a host pointer are always linear.
+	bool use_tiled_layout(const cl_mem_flags flags);
+
+	// Makes layout tiled for an image of width x height x depth texels of
+	// layout.element_size bytes (depth is 1 for 2D images) and returns the
+	// size of its storage. Returns 0 and leaves layout unchanged if the image
+	// is smaller than a tile in some dimension, as padding would waste most
+	// of its storage.
+	size_t tile_layout(image_layout &layout, const size_t width, const size_t height, const size_t depth);
+
+	// Copies a region of region[0] x region[1] x region[2] texels between two
+	// layouts with the same element size. Linear to linear copies are
+	// copy_rect. Large regions are split by rows across the device thread
+	// pool.
+	void copy_image_rect(void *dst, const image_layout &dst_layout, const size_t dst_origin[3],
+						 const void *src, const image_layout &src_layout, const size_t src_origin[3],
+						 const size_t region[3]);
+
+	// Fills a region with copies of a texel of layout.element_size bytes
+	void fill_image_rect(void *dst, const image_layout &layout, const size_t origin[3], const size_t region[3], const void *texel);
+}
+
+#endif
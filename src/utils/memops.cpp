@@ -0,0 +1,581 @@
+/*
+	FreeOCL - a free OpenCL implementation for CPU
+	Copyright (C) 2011  Roland Brochard
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include "memops.h"
+#include "threadpool.h"
+#include "device.h"
+#include <cstring>
+#include <algorithm>
+#ifndef FREEOCL_OS_WINDOWS
+#include <sys/mman.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	// Below this size a single memcpy on the calling thread is faster than
+	// waking up the workers
+	const size_t parallel_copy_threshold = 0x400000;
+	// Smallest chunk handed to a worker
+	const size_t min_chunk_size = 0x100000;
+	// Used when the cache size of the CPU could not be detected
+	const size_t default_cache_size = 0x800000;
+
+	struct copy_job
+	{
+		char *dst;
+		const char *src;
+		size_t size;
+		size_t chunk_size;
+		bool b_stream;
+	};
+
+	void copy_chunk(void *data, const size_t id)
+	{
+		const copy_job *job = (const copy_job*)data;
+		const size_t offset = id * job->chunk_size;
+		const size_t size = std::min(job->chunk_size, job->size - offset);
+		if (job->b_stream)
+			FreeOCL::stream_memcpy(job->dst + offset, job->src + offset, size);
+		else
+			memcpy(job->dst + offset, job->src + offset, size);
+	}
+
+	struct rect_job
+	{
+		char *dst;
+		const char *src;
+		size_t dst_row_pitch, dst_slice_pitch;
+		size_t src_row_pitch, src_slice_pitch;
+		size_t width;
+		size_t height;
+		size_t rows_per_task;
+		size_t nb_rows;
+	};
+
+	template<size_t N>
+	inline void copy_rows(char *dst, const size_t dst_pitch, const char *src, const size_t src_pitch, const size_t nb_rows)
+	{
+		// N is a compile time constant so this memcpy is expanded inline
+		for(size_t y = 0 ; y < nb_rows ; ++y, dst += dst_pitch, src += src_pitch)
+			memcpy(dst, src, N);
+	}
+
+	// Copies nb_rows rows of width bytes, avoiding the memcpy call for narrow
+	// rows (typical of image rows of small formats)
+	inline void copy_rows(char *dst, const size_t dst_pitch, const char *src, const size_t src_pitch, const size_t width, const size_t nb_rows)
+	{
+		switch(width)
+		{
+		case 1:		copy_rows<1>(dst, dst_pitch, src, src_pitch, nb_rows);	return;
+		case 2:		copy_rows<2>(dst, dst_pitch, src, src_pitch, nb_rows);	return;
+		case 4:		copy_rows<4>(dst, dst_pitch, src, src_pitch, nb_rows);	return;
+		case 8:		copy_rows<8>(dst, dst_pitch, src, src_pitch, nb_rows);	return;
+		case 12:	copy_rows<12>(dst, dst_pitch, src, src_pitch, nb_rows);	return;
+		case 16:	copy_rows<16>(dst, dst_pitch, src, src_pitch, nb_rows);	return;
+		case 32:	copy_rows<32>(dst, dst_pitch, src, src_pitch, nb_rows);	return;
+		case 64:	copy_rows<64>(dst, dst_pitch, src, src_pitch, nb_rows);	return;
+		}
+		for(size_t y = 0 ; y < nb_rows ; ++y, dst += dst_pitch, src += src_pitch)
+			memcpy(dst, src, width);
+	}
+
+	// Copies rows [first, last) of the region, rows being numbered slice by slice
+	void copy_rect_rows(const rect_job *job, size_t first, const size_t last)
+	{
+		while(first < last)
+		{
+			const size_t z = first / job->height;
+			const size_t y = first % job->height;
+			const size_t n = std::min(last - first, job->height - y);
+			copy_rows(job->dst + z * job->dst_slice_pitch + y * job->dst_row_pitch, job->dst_row_pitch,
+					  job->src + z * job->src_slice_pitch + y * job->src_row_pitch, job->src_row_pitch,
+					  job->width, n);
+			first += n;
+		}
+	}
+
+	void copy_rect_chunk(void *data, const size_t id)
+	{
+		const rect_job *job = (const rect_job*)data;
+		const size_t first = id * job->rows_per_task;
+		copy_rect_rows(job, first, std::min(job->nb_rows, first + job->rows_per_task));
+	}
+
+	// Every supported pattern size divides this period
+	const size_t fill_period = 128;
+	// Below this size discarding pages is not worth a system call
+	const size_t discard_threshold = 0x100000;
+
+	struct fill_job
+	{
+		char *dst;
+		size_t size;
+		size_t chunk_size;
+		bool b_stream;
+		// The pattern repeated twice over the fill period so that
+		// block + (offset % fill_period) is always fill_period bytes long
+		unsigned char block[2 * fill_period];
+		// Rect fills
+		size_t width;
+		size_t height;
+		size_t row_pitch, slice_pitch;
+		size_t rows_per_task;
+		size_t nb_rows;
+	};
+
+	inline void init_fill_block(fill_job &job, const void *pattern, const size_t pattern_size)
+	{
+		for(size_t i = 0 ; i < sizeof(job.block) ; i += pattern_size)
+			memcpy(job.block + i, pattern, pattern_size);
+	}
+
+	// Writes bytes [begin, end) of dst, the pattern starting at dst
+	void fill_range(char *dst, const unsigned char *block, size_t begin, const size_t end, const bool b_stream)
+	{
+		// Reach a 16 bytes boundary first
+		const size_t head = std::min(end - begin, (16 - (size_t(dst + begin) & 15)) & 15);
+		memcpy(dst + begin, block + begin % fill_period, head);
+		begin += head;
+		if (begin >= end)
+			return;
+
+		const unsigned char *b = block + begin % fill_period;
+		const size_t n = (end - begin) & ~(fill_period - 1);
+		char *d = dst + begin;
+#ifdef __SSE2__
+		const __m128i v0 = _mm_loadu_si128((const __m128i*)b);
+		const __m128i v1 = _mm_loadu_si128((const __m128i*)(b + 16));
+		const __m128i v2 = _mm_loadu_si128((const __m128i*)(b + 32));
+		const __m128i v3 = _mm_loadu_si128((const __m128i*)(b + 48));
+		const __m128i v4 = _mm_loadu_si128((const __m128i*)(b + 64));
+		const __m128i v5 = _mm_loadu_si128((const __m128i*)(b + 80));
+		const __m128i v6 = _mm_loadu_si128((const __m128i*)(b + 96));
+		const __m128i v7 = _mm_loadu_si128((const __m128i*)(b + 112));
+		if (b_stream)
+		{
+			for(size_t i = 0 ; i < n ; i += fill_period)
+			{
+				_mm_stream_si128((__m128i*)(d + i), v0);
+				_mm_stream_si128((__m128i*)(d + i + 16), v1);
+				_mm_stream_si128((__m128i*)(d + i + 32), v2);
+				_mm_stream_si128((__m128i*)(d + i + 48), v3);
+				_mm_stream_si128((__m128i*)(d + i + 64), v4);
+				_mm_stream_si128((__m128i*)(d + i + 80), v5);
+				_mm_stream_si128((__m128i*)(d + i + 96), v6);
+				_mm_stream_si128((__m128i*)(d + i + 112), v7);
+			}
+			_mm_sfence();
+		}
+		else
+		{
+			for(size_t i = 0 ; i < n ; i += fill_period)
+			{
+				_mm_store_si128((__m128i*)(d + i), v0);
+				_mm_store_si128((__m128i*)(d + i + 16), v1);
+				_mm_store_si128((__m128i*)(d + i + 32), v2);
+				_mm_store_si128((__m128i*)(d + i + 48), v3);
+				_mm_store_si128((__m128i*)(d + i + 64), v4);
+				_mm_store_si128((__m128i*)(d + i + 80), v5);
+				_mm_store_si128((__m128i*)(d + i + 96), v6);
+				_mm_store_si128((__m128i*)(d + i + 112), v7);
+			}
+		}
+#else
+		(void)b_stream;
+		for(size_t i = 0 ; i < n ; i += fill_period)
+			memcpy(d + i, b, fill_period);
+#endif
+		memcpy(d + n, b, end - begin - n);
+	}
+
+	void fill_chunk(void *data, const size_t id)
+	{
+		const fill_job *job = (const fill_job*)data;
+		const size_t begin = id * job->chunk_size;
+		fill_range(job->dst, job->block, begin, std::min(job->size, begin + job->chunk_size), job->b_stream);
+	}
+
+	struct pages_job
+	{
+		char *begin;
+		size_t size;
+		size_t chunk_size;
+		void (*f)(char *, const size_t, void *);
+		void *data;
+	};
+
+	void pages_chunk(void *data, const size_t id)
+	{
+		const pages_job *job = (const pages_job*)data;
+		const size_t offset = id * job->chunk_size;
+		job->f(job->begin + offset, std::min(job->chunk_size, job->size - offset), job->data);
+	}
+
+	void fill_rect_rows(const fill_job *job, size_t first, const size_t last)
+	{
+		for(; first < last ; ++first)
+		{
+			char *row = job->dst + (first / job->height) * job->slice_pitch + (first % job->height) * job->row_pitch;
+			fill_range(row, job->block, 0, job->width, false);
+		}
+	}
+
+	void fill_rect_chunk(void *data, const size_t id)
+	{
+		const fill_job *job = (const fill_job*)data;
+		const size_t first = id * job->rows_per_task;
+		fill_rect_rows(job, first, std::min(job->nb_rows, first + job->rows_per_task));
+	}
+
+	// Fills with a pattern size that doesn't divide the fill period
+	void generic_fill(char *dst, const size_t size, const void *pattern, const size_t pattern_size)
+	{
+		for(size_t i = 0 ; i + pattern_size <= size ; i += pattern_size)
+			memcpy(dst + i, pattern, pattern_size);
+	}
+
+	// Returns the pages fully covered by [dst, dst + size) to the system so
+	// they read back as zero, and returns the number of bytes discarded from
+	// the beginning of the first page
+	size_t discard_pages(char *dst, const size_t size, size_t &first)
+	{
+#ifndef FREEOCL_OS_WINDOWS
+		const size_t page_size = sysconf(_SC_PAGESIZE);
+		first = (page_size - (size_t(dst) & (page_size - 1))) & (page_size - 1);
+		if (first >= size)
+			return 0;
+		const size_t len = (size - first) & ~(page_size - 1);
+		if (len == 0 || madvise(dst + first, len, MADV_DONTNEED))
+			return 0;
+		return len;
+#else
+		(void)dst;
+		(void)size;
+		first = 0;
+		return 0;
+#endif
+	}
+
+	inline size_t cache_size()
+	{
+		return FreeOCL::device->mem_cache_size ? size_t(FreeOCL::device->mem_cache_size) : default_cache_size;
+	}
+}
+
+namespace FreeOCL
+{
+	void stream_memcpy(void *dst, const void *src, const size_t size)
+	{
+#ifdef __SSE2__
+		char *d = (char*)dst;
+		const char *s = (const char*)src;
+		// Align the destination on 16 bytes so we can use streaming stores
+		const size_t head = (16 - (size_t(d) & 15)) & 15;
+		if (size < head + 64)
+		{
+			memcpy(d, s, size);
+			return;
+		}
+		memcpy(d, s, head);
+		d += head;
+		s += head;
+		const size_t remaining = size - head;
+		const size_t n = remaining & ~size_t(63);
+		for(size_t i = 0 ; i < n ; i += 64)
+		{
+			const __m128i a = _mm_loadu_si128((const __m128i*)(s + i));
+			const __m128i b = _mm_loadu_si128((const __m128i*)(s + i + 16));
+			const __m128i c = _mm_loadu_si128((const __m128i*)(s + i + 32));
+			const __m128i e = _mm_loadu_si128((const __m128i*)(s + i + 48));
+			_mm_stream_si128((__m128i*)(d + i), a);
+			_mm_stream_si128((__m128i*)(d + i + 16), b);
+			_mm_stream_si128((__m128i*)(d + i + 32), c);
+			_mm_stream_si128((__m128i*)(d + i + 48), e);
+		}
+		_mm_sfence();
+		memcpy(d + n, s + n, remaining - n);
+#else
+		memcpy(dst, src, size);
+#endif
+	}
+
+	void parallel_memcpy(void *dst, const void *src, const size_t size)
+	{
+		const bool b_stream = size > cache_size();
+		if (size < parallel_copy_threshold || device->cpu_cores <= 1)
+		{
+			if (b_stream)
+				stream_memcpy(dst, src, size);
+			else
+				memcpy(dst, src, size);
+			return;
+		}
+
+		copy_job job;
+		job.dst = (char*)dst;
+		job.src = (const char*)src;
+		job.size = size;
+		job.b_stream = b_stream;
+		// A few chunks per worker balances the load when some cores are busy
+		const size_t nb_chunks = std::max<size_t>(1, std::min<size_t>(device->cpu_cores * 4, size / min_chunk_size));
+		// Keep chunk boundaries on cache lines
+		job.chunk_size = ((size + nb_chunks - 1) / nb_chunks + 63) & ~size_t(63);
+
+		device->pool->run_tasks_locked(copy_chunk, &job, (size + job.chunk_size - 1) / job.chunk_size, device->cpu_cores);
+	}
+
+	void copy_rect(void *dst, const size_t dst_row_pitch, const size_t dst_slice_pitch,
+				   const void *src, const size_t src_row_pitch, const size_t src_slice_pitch,
+				   const size_t cb[3])
+	{
+		rect_job job;
+		job.dst = (char*)dst;
+		job.src = (const char*)src;
+		job.dst_row_pitch = dst_row_pitch;
+		job.dst_slice_pitch = dst_slice_pitch;
+		job.src_row_pitch = src_row_pitch;
+		job.src_slice_pitch = src_slice_pitch;
+		job.width = cb[0];
+		job.height = cb[1];
+		size_t depth = cb[2];
+
+		// Merge rows which are contiguous in both layouts
+		if (job.width == src_row_pitch && job.width == dst_row_pitch)
+		{
+			job.width *= job.height;
+			job.height = 1;
+			job.src_row_pitch = job.dst_row_pitch = job.width;
+			// and then slices
+			if (job.width == src_slice_pitch && job.width == dst_slice_pitch)
+			{
+				job.width *= depth;
+				depth = 1;
+			}
+		}
+		if (job.height == 1 && depth == 1)
+		{
+			parallel_memcpy(dst, src, job.width);
+			return;
+		}
+		if (job.height == 1)
+		{
+			// Only slices are left: treat them as rows
+			job.height = depth;
+			job.src_row_pitch = src_slice_pitch;
+			job.dst_row_pitch = dst_slice_pitch;
+			depth = 1;
+		}
+
+		job.nb_rows = job.height * depth;
+		const size_t size = job.width * job.nb_rows;
+		if (size < parallel_copy_threshold || device->cpu_cores <= 1)
+		{
+			copy_rect_rows(&job, 0, job.nb_rows);
+			return;
+		}
+
+		const size_t nb_chunks = std::max<size_t>(1, std::min<size_t>(device->cpu_cores * 4, size / min_chunk_size));
+		job.rows_per_task = (job.nb_rows + nb_chunks - 1) / nb_chunks;
+
+		device->pool->run_tasks_locked(copy_rect_chunk, &job, (job.nb_rows + job.rows_per_task - 1) / job.rows_per_task, device->cpu_cores);
+	}
+
+	void parallel_fill(void *dst, const size_t size, const void *pattern, const size_t pattern_size, const bool b_discard)
+	{
+		if (fill_period % pattern_size)
+		{
+			generic_fill((char*)dst, size, pattern, pattern_size);
+			return;
+		}
+
+		if (is_zero(pattern, pattern_size))
+		{
+			if (b_discard && size >= discard_threshold)
+			{
+				size_t first;
+				const size_t len = discard_pages((char*)dst, size, first);
+				if (len)
+				{
+					memset(dst, 0, first);
+					memset((char*)dst + first + len, 0, size - first - len);
+					return;
+				}
+			}
+			if (size < parallel_copy_threshold || device->cpu_cores <= 1)
+			{
+				memset(dst, 0, size);
+				return;
+			}
+		}
+
+		fill_job job;
+		job.dst = (char*)dst;
+		job.size = size;
+		job.b_stream = size > cache_size();
+		init_fill_block(job, pattern, pattern_size);
+		if (size < parallel_copy_threshold || device->cpu_cores <= 1)
+		{
+			fill_range(job.dst, job.block, 0, size, job.b_stream);
+			return;
+		}
+
+		const size_t nb_chunks = std::max<size_t>(1, std::min<size_t>(device->cpu_cores * 4, size / min_chunk_size));
+		// Chunks must start on a pattern boundary
+		job.chunk_size = ((size + nb_chunks - 1) / nb_chunks + fill_period - 1) & ~(fill_period - 1);
+
+		device->pool->run_tasks_locked(fill_chunk, &job, (size + job.chunk_size - 1) / job.chunk_size, device->cpu_cores);
+	}
+
+	void parallel_pages(void *ptr, const size_t size, void (*f)(char *begin, const size_t size, void *data), void *data)
+	{
+#ifndef FREEOCL_OS_WINDOWS
+		const size_t page_size = sysconf(_SC_PAGESIZE);
+#else
+		const size_t page_size = 4096;
+#endif
+		pages_job job;
+		job.begin = (char*)(size_t(ptr) & ~(page_size - 1));
+		job.size = ((size_t(ptr) + size + page_size - 1) & ~(page_size - 1)) - size_t(job.begin);
+		job.f = f;
+		job.data = data;
+		if (job.size < parallel_copy_threshold || device->cpu_cores <= 1)
+		{
+			f(job.begin, job.size, data);
+			return;
+		}
+
+		const size_t nb_chunks = std::max<size_t>(1, std::min<size_t>(device->cpu_cores * 4, job.size / min_chunk_size));
+		job.chunk_size = ((job.size + nb_chunks - 1) / nb_chunks + page_size - 1) & ~(page_size - 1);
+
+		device->pool->run_tasks_locked(pages_chunk, &job, (job.size + job.chunk_size - 1) / job.chunk_size, device->cpu_cores);
+	}
+
+	void fill_rect(void *dst, const size_t row_pitch, const size_t slice_pitch,
+				   const size_t cb[3], const void *pattern, const size_t pattern_size)
+	{
+		if (cb[0] == row_pitch && (cb[1] * row_pitch == slice_pitch || cb[2] == 1))
+		{
+			parallel_fill(dst, cb[0] * cb[1] * cb[2], pattern, pattern_size, false);
+			return;
+		}
+		if (fill_period % pattern_size)
+		{
+			for(size_t z = 0 ; z < cb[2] ; ++z)
+				for(size_t y = 0 ; y < cb[1] ; ++y)
+					generic_fill((char*)dst + z * slice_pitch + y * row_pitch, cb[0], pattern, pattern_size);
+			return;
+		}
+
+		fill_job job;
+		job.dst = (char*)dst;
+		job.width = cb[0];
+		job.height = cb[1];
+		job.row_pitch = row_pitch;
+		job.slice_pitch = slice_pitch;
+		job.nb_rows = cb[1] * cb[2];
+		init_fill_block(job, pattern, pattern_size);
+
+		const size_t size = job.width * job.nb_rows;
+		if (size < parallel_copy_threshold || device->cpu_cores <= 1)
+		{
+			fill_rect_rows(&job, 0, job.nb_rows);
+			return;
+		}
+
+		const size_t nb_chunks = std::max<size_t>(1, std::min<size_t>(device->cpu_cores * 4, size / min_chunk_size));
+		job.rows_per_task = (job.nb_rows + nb_chunks - 1) / nb_chunks;
+
+		device->pool->run_tasks_locked(fill_rect_chunk, &job, (job.nb_rows + job.rows_per_task - 1) / job.rows_per_task, device->cpu_cores);
+	}
+}
+
+#ifndef FREEOCL_OS_WINDOWS
+namespace
+{
+	// Chunks are kept page aligned so file descriptors opened with O_DIRECT
+	// work as long as the caller's offsets are aligned too
+	const size_t file_io_alignment = 0x1000;
+	const size_t min_file_io_chunk_size = 0x400000;
+
+	struct file_io_job
+	{
+		int fd;
+		unsigned long long file_offset;
+		char *ptr;
+		size_t size;
+		size_t chunk_size;
+		bool b_read;
+		volatile bool b_error;
+	};
+
+	bool file_io(const int fd, unsigned long long file_offset, char *ptr, size_t size, const bool b_read)
+	{
+		while(size > 0)
+		{
+			const ssize_t r = b_read ? pread(fd, ptr, size, file_offset) : pwrite(fd, ptr, size, file_offset);
+			if (r < 0 && errno == EINTR)
+				continue;
+			if (r <= 0)
+				return false;
+			ptr += r;
+			size -= r;
+			file_offset += r;
+		}
+		return true;
+	}
+
+	void file_io_chunk(void *data, const size_t id)
+	{
+		file_io_job *job = (file_io_job*)data;
+		const size_t offset = id * job->chunk_size;
+		const size_t size = std::min(job->chunk_size, job->size - offset);
+		if (!file_io(job->fd, job->file_offset + offset, job->ptr + offset, size, job->b_read))
+			job->b_error = true;
+	}
+}
+#endif
+
+namespace FreeOCL
+{
+	bool parallel_file_io(const int fd, const unsigned long long file_offset, void *ptr, const size_t size, const bool b_read)
+	{
+#ifdef FREEOCL_OS_WINDOWS
+		return false;
+#else
+		if (size < 2 * min_file_io_chunk_size || device->cpu_cores <= 1)
+			return file_io(fd, file_offset, (char*)ptr, size, b_read);
+
+		file_io_job job;
+		job.fd = fd;
+		job.file_offset = file_offset;
+		job.ptr = (char*)ptr;
+		job.size = size;
+		job.b_read = b_read;
+		job.b_error = false;
+		const size_t nb_chunks = std::max<size_t>(1, std::min<size_t>(device->cpu_cores * 2, size / min_file_io_chunk_size));
+		job.chunk_size = ((size + nb_chunks - 1) / nb_chunks + file_io_alignment - 1) & ~(file_io_alignment - 1);
+
+		device->pool->run_tasks_locked(file_io_chunk, &job, (size + job.chunk_size - 1) / job.chunk_size, device->cpu_cores);
+		return !job.b_error;
+#endif
+	}
+}
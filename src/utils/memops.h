@@ -0,0 +1,70 @@
+/*
+	FreeOCL - a free OpenCL implementation for CPU
+	Copyright (C) 2011  Roland Brochard
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#ifndef __FREEOCL_UTILS_MEMOPS_H__
+#define __FREEOCL_UTILS_MEMOPS_H__
+
+#include <cstddef>
+
+namespace FreeOCL
+{
+	inline bool is_zero(const void *pattern, const size_t pattern_size)
+	{
+		for(size_t i = 0 ; i < pattern_size ; ++i)
+			if (((const unsigned char*)pattern)[i])
+				return false;
+		return true;
+	}
+
+	// Copies size bytes from src to dst. Large transfers are split across the
+	// device thread pool and use non-temporal stores when the destination does
+	// not fit in the last level cache.
+	void parallel_memcpy(void *dst, const void *src, const size_t size);
+
+	// Same as memcpy but bypasses the cache for the destination when possible
+	void stream_memcpy(void *dst, const void *src, const size_t size);
+
+	// Copies a cb[0] x cb[1] x cb[2] region between two pitched layouts. Rows
+	// are merged when the pitches are contiguous and large regions are split by
+	// rows across the device thread pool.
+	void copy_rect(void *dst, const size_t dst_row_pitch, const size_t dst_slice_pitch,
+				   const void *src, const size_t src_row_pitch, const size_t src_slice_pitch,
+				   const size_t cb[3]);
+
+	// Fills size bytes with copies of a pattern. Large fills are split across
+	// the device thread pool. If b_discard is set, dst must be private
+	// anonymous memory: zero fills then return whole pages to the system
+	// instead of writing them.
+	void parallel_fill(void *dst, const size_t size, const void *pattern, const size_t pattern_size, const bool b_discard);
+
+	// Fills a cb[0] x cb[1] x cb[2] region with copies of a pattern, each row
+	// starting with a whole pattern
+	void fill_rect(void *dst, const size_t row_pitch, const size_t slice_pitch,
+				   const size_t cb[3], const void *pattern, const size_t pattern_size);
+
+	// Calls f(begin, size, data) on consecutive page aligned chunks covering
+	// [ptr, ptr + size) from the workers of the device thread pool. The first
+	// and last chunks extend to the page boundaries around the range.
+	void parallel_pages(void *ptr, const size_t size, void (*f)(char *begin, const size_t size, void *data), void *data);
+
+	// Reads (b_read) or writes size bytes at file_offset of the file fd into
+	// or from ptr. Large transfers are split in page aligned chunks across the
+	// device thread pool. Returns false on I/O error or early end of file.
+	bool parallel_file_io(const int fd, const unsigned long long file_offset, void *ptr, const size_t size, const bool b_read);
+}
+
+#endif
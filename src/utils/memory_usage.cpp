@@ -0,0 +1,150 @@
+/*
+	FreeOCL - a free OpenCL implementation for CPU
+	Copyright (C) 2011  Roland Brochard
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include "memory_usage.h"
+#include <cstdlib>
+#include <cstdio>
+
+namespace
+{
+	const char *const kind_names[CL_MEMORY_KIND_COUNT_FREEOCL] = {
+		"buffers",
+		"images",
+		"pipes",
+		"buffer cache",
+		"programs",
+		"stacks",
+		"file mappings",
+		"unified shared memory",
+		"kernel arguments"
+	};
+
+	cl_ulong read_budget()
+	{
+		const char *env = getenv("FREEOCL_MEMORY_BUDGET");
+		if (!env)
+			return 0;
+		char *end;
+		const long size = strtol(env, &end, 10);
+		if (end == env || *end || size < 0)
+			return 0;
+		return cl_ulong(size) << 20;
+	}
+
+	class process_usage : public FreeOCL::memory_usage
+	{
+	public:
+		process_usage() : memory_usage(NULL, read_budget())	{}
+		~process_usage()
+		{
+			if (FreeOCL::memory_stats_enabled())
+				dump("process");
+		}
+	};
+
+	inline bool is_budgeted(const cl_uint kind)
+	{
+		return kind != CL_MEMORY_KIND_FILE_MAPPINGS_FREEOCL;
+	}
+}
+
+namespace FreeOCL
+{
+	memory_usage::memory_usage(memory_usage *parent, const cl_ulong budget)
+		: parent(parent), total(0), peak(0), budget(budget)
+	{
+		for(size_t i = 0 ; i < CL_MEMORY_KIND_COUNT_FREEOCL ; ++i)
+			bytes[i] = 0;
+	}
+
+	bool memory_usage::reserve(const cl_uint kind, const size_t size)
+	{
+		if (!is_budgeted(kind))
+		{
+			add(kind, size);
+			return true;
+		}
+		const cl_ulong new_total = __sync_add_and_fetch(&total, cl_ulong(size));
+		if (budget && new_total > budget)
+		{
+			__sync_sub_and_fetch(&total, cl_ulong(size));
+			return false;
+		}
+		if (parent && !parent->reserve(kind, size))
+		{
+			__sync_sub_and_fetch(&total, cl_ulong(size));
+			return false;
+		}
+		__sync_add_and_fetch(bytes + kind, cl_ulong(size));
+		count(kind, 0);
+		return true;
+	}
+
+	void memory_usage::add(const cl_uint kind, const size_t size)
+	{
+		__sync_add_and_fetch(bytes + kind, cl_ulong(size));
+		count(kind, size);
+		if (parent)
+			parent->add(kind, size);
+	}
+
+	void memory_usage::release(const cl_uint kind, const size_t size)
+	{
+		__sync_sub_and_fetch(bytes + kind, cl_ulong(size));
+		if (is_budgeted(kind))
+			__sync_sub_and_fetch(&total, cl_ulong(size));
+		if (parent)
+			parent->release(kind, size);
+	}
+
+	void memory_usage::count(const cl_uint kind, const size_t size)
+	{
+		if (!is_budgeted(kind))
+			return;
+		const cl_ulong new_total = __sync_add_and_fetch(&total, cl_ulong(size));
+		for(cl_ulong old_peak = peak ; old_peak < new_total ; old_peak = peak)
+			if (__sync_bool_compare_and_swap(&peak, old_peak, new_total))
+				break;
+	}
+
+	void memory_usage::get_bytes(cl_ulong bytes[CL_MEMORY_KIND_COUNT_FREEOCL]) const
+	{
+		for(size_t i = 0 ; i < CL_MEMORY_KIND_COUNT_FREEOCL ; ++i)
+			bytes[i] = this->bytes[i];
+	}
+
+	void memory_usage::dump(const char *name) const
+	{
+		fprintf(stderr, "FreeOCL: memory usage of %s %p:", name, (const void*)this);
+		for(size_t i = 0 ; i < CL_MEMORY_KIND_COUNT_FREEOCL ; ++i)
+			fprintf(stderr, " %s %lu,", kind_names[i], (unsigned long)bytes[i]);
+		fprintf(stderr, " total %lu, peak %lu, budget %lu\n",
+				(unsigned long)total, (unsigned long)peak, (unsigned long)budget);
+	}
+
+	memory_usage &process_memory_usage()
+	{
+		static process_usage usage;
+		return usage;
+	}
+
+	bool memory_stats_enabled()
+	{
+		static const bool b_enabled = getenv("FREEOCL_MEMORY_STATS") != NULL;
+		return b_enabled;
+	}
+}
@@ -0,0 +1,72 @@
+/*
+	FreeOCL - a free OpenCL implementation for CPU
+	Copyright (C) 2011  Roland Brochard
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#ifndef __FREEOCL_UTILS_MEMORY_USAGE_H__
+#define __FREEOCL_UTILS_MEMORY_USAGE_H__
+
+#include <cstddef>
+#include <CL/cl_freeocl.h>
+
+namespace FreeOCL
+{
+	// Bytes of memory held by FreeOCL, by kind (CL_MEMORY_KIND_*_FREEOCL).
+	// Every context has one whose parent is process_memory_usage(), which
+	// also counts storage owned by the device. All kinds but file mappings,
+	// which the system can write back and drop, add up to the total checked
+	// against the budget. Counters are updated atomically.
+	class memory_usage
+	{
+	public:
+		memory_usage(memory_usage *parent, const cl_ulong budget);
+
+		// Counts size bytes of kind here and in the parent. Returns false and
+		// counts nothing if that would exceed one of the budgets.
+		bool reserve(const cl_uint kind, const size_t size);
+		// Counts size bytes of kind whatever the budgets
+		void add(const cl_uint kind, const size_t size);
+		void release(const cl_uint kind, const size_t size);
+
+		void get_bytes(cl_ulong bytes[CL_MEMORY_KIND_COUNT_FREEOCL]) const;
+		cl_ulong get_total() const	{	return total;	}
+		cl_ulong get_peak() const	{	return peak;	}
+		// 0 if there is no budget
+		cl_ulong get_budget() const	{	return budget;	}
+		void set_budget(const cl_ulong budget)	{	this->budget = budget;	}
+
+		// Prints the counters to stderr
+		void dump(const char *name) const;
+
+	private:
+		void count(const cl_uint kind, const size_t size);
+
+	private:
+		memory_usage *parent;
+		volatile cl_ulong bytes[CL_MEMORY_KIND_COUNT_FREEOCL];
+		volatile cl_ulong total;
+		volatile cl_ulong peak;
+		cl_ulong budget;
+	};
+
+	// Usage of the whole process, its budget is FREEOCL_MEMORY_BUDGET MB
+	memory_usage &process_memory_usage();
+
+	// True if FREEOCL_MEMORY_STATS is set: usage is dumped when contexts are
+	// released, when the process exits and when a budget is exceeded
+	bool memory_stats_enabled();
+}
+
+#endif
@@ -42,18 +42,43 @@ namespace FreeOCL
 
 	void unlocker::handle(mutex *m)
 	{
-		objects.insert(m);
+		for(size_t i = 0 ; i < n ; ++i)
+			if (objects[i] == m)
+				return;
+		if (n < max_inline_objects)
+		{
+			objects[n++] = m;
+			return;
+		}
+		for(size_t i = 0 ; i < overflow.size() ; ++i)
+			if (overflow[i] == m)
+				return;
+		overflow.push_back(m);
 	}
 
 	void unlocker::forget(mutex *m)
 	{
-		objects.erase(m);
+		for(size_t i = 0 ; i < n ; ++i)
+			if (objects[i] == m)
+			{
+				objects[i] = objects[--n];
+				return;
+			}
+		for(size_t i = 0 ; i < overflow.size() ; ++i)
+			if (overflow[i] == m)
+			{
+				overflow[i] = overflow.back();
+				overflow.pop_back();
+				return;
+			}
 	}
 
 	void unlocker::unlockall()
 	{
-		for(set<mutex*>::const_iterator i = objects.begin() ; i != objects.end() ; ++i)
-			(*i)->unlock();
-		objects.clear();
+		for(size_t i = 0 ; i < overflow.size() ; ++i)
+			overflow[i]->unlock();
+		overflow.clear();
+		while(n > 0)
+			objects[--n]->unlock();
 	}
 }
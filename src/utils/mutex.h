@@ -20,7 +20,7 @@
 
 #include <pthread.h>
 #include <errno.h>
-#include "set.h"
+#include <vector>
 
 namespace FreeOCL
 {
@@ -51,9 +51,13 @@ namespace FreeOCL
 		mutable pthread_mutex_t pm;
 	};
 
+	// Unlocks the objects locked by an API call when it returns. The first
+	// objects are kept in a fixed size array so no allocation is needed
+	// in the common case.
 	class unlocker
 	{
 	public:
+		inline unlocker() : n(0)	{}
 		~unlocker();
 
 		void handle(mutex *m);
@@ -65,7 +69,10 @@ namespace FreeOCL
 		void unlockall();
 
 	private:
-		set<mutex*> objects;
+		enum { max_inline_objects = 8 };
+		mutex *objects[max_inline_objects];
+		size_t n;
+		std::vector<mutex*> overflow;
 	};
 }
 
@@ -29,8 +29,9 @@ namespace FreeOCL
 
 		inline ref_count &operator=(const ref_count &)	{	return *this;	}
 
-		inline void retain()	{	++counter;	}
-		inline void release()	{	--counter;	}
+		inline void retain()	{	__sync_add_and_fetch(&counter, 1);	}
+		// Returns true when the last reference has been released
+		inline bool release()	{	return __sync_sub_and_fetch(&counter, 1) == 0;	}
 		inline size_t get_ref_count() const	{	return counter;	}
 	private:
 		size_t counter;
@@ -84,58 +85,34 @@ namespace FreeOCL
 		inline smartptr(T *ptr) : ptr(ptr)
 		{
 			if (ptr)
-			{
-				__smartptr_trait_lockable<T>::lock(ptr);
 				ptr->retain();
-				__smartptr_trait_lockable<T>::unlock(ptr);
-			}
 		}
 		inline smartptr(const T *ptr) : ptr(const_cast<T*>(ptr))
 		{
 			if (this->ptr)
-			{
-				__smartptr_trait_lockable<T>::lock(this->ptr);
 				this->ptr->retain();
-				__smartptr_trait_lockable<T>::unlock(this->ptr);
-			}
 		}
 		inline smartptr(smartptr &ptr) : ptr(ptr.ptr)
 		{
 			if (this->ptr)
-			{
-				__smartptr_trait_lockable<T>::lock(this->ptr);
 				this->ptr->retain();
-				__smartptr_trait_lockable<T>::unlock(this->ptr);
-			}
 		}
 		inline smartptr(const smartptr &ptr) : ptr(const_cast<T*>(ptr.ptr))
 		{
 			if (this->ptr)
-			{
-				__smartptr_trait_lockable<T>::lock(this->ptr);
 				this->ptr->retain();
-				__smartptr_trait_lockable<T>::unlock(this->ptr);
-			}
 		}
 		template<class U>
 		inline smartptr(const smartptr<U> &ptr) : ptr(dynamic_cast<T*>(const_cast<U*>(ptr.ptr)))
 		{
 			if (this->ptr)
-			{
-				__smartptr_trait_lockable<T>::lock(this->ptr);
 				this->ptr->retain();
-				__smartptr_trait_lockable<T>::unlock(this->ptr);
-			}
 		}
 		template<class U>
 		inline smartptr(const U *ptr) : ptr(dynamic_cast<T*>(const_cast<U*>(ptr)))
 		{
 			if (this->ptr)
-			{
-				__smartptr_trait_lockable<T>::lock(this->ptr);
 				this->ptr->retain();
-				__smartptr_trait_lockable<T>::unlock(this->ptr);
-			}
 		}
 		inline ~smartptr()
 		{
@@ -147,10 +124,8 @@ namespace FreeOCL
 		{
 			if (this->ptr == ptr.ptr)
 				return *this;
-			__smartptr_trait_lockable<T>::lock(ptr.ptr);
 			if (!__smartptr_trait_validation<T>::valid(ptr.ptr))
 			{
-				__smartptr_trait_lockable<T>::unlock(ptr.ptr);
 				clear(this->ptr);
 				this->ptr = NULL;
 				return *this;
@@ -160,7 +135,6 @@ namespace FreeOCL
 			this->ptr = const_cast<T*>(ptr.ptr);
 			if (this->ptr)
 				this->ptr->retain();
-			__smartptr_trait_lockable<T>::unlock(ptr.ptr);
 			if (old)
 				clear(old);
 			return *this;
@@ -171,10 +145,8 @@ namespace FreeOCL
 			if (this->ptr == ptr)
 				return *this;
 
-			__smartptr_trait_lockable<T>::lock(ptr);
 			if (!__smartptr_trait_validation<T>::valid(ptr))
 			{
-				__smartptr_trait_lockable<T>::unlock(ptr);
 				clear(this->ptr);
 				this->ptr = NULL;
 				return *this;
@@ -184,7 +156,6 @@ namespace FreeOCL
 			this->ptr = const_cast<T*>(ptr);
 			if (this->ptr)
 				this->ptr->retain();
-			__smartptr_trait_lockable<T>::unlock(ptr);
 			if (old)
 				clear(old);
 			return *this;
@@ -213,18 +184,19 @@ namespace FreeOCL
 		inline T * &weak()	{	return ptr;	}
 
 	private:
+		// Reference counts are atomic, the object is only destroyed by the
+		// thread releasing the last reference
 		inline void clear(T *p) const
 		{
-			__smartptr_trait_lockable<T>::lock(p);
-			p->release();
-			if (p->get_ref_count() == 0)
+			if (p && p->release())
 			{
 				__smartptr_trait_validation<T>::invalidate(p);
+				// A clRelease* call may still hold the lock after having
+				// released its own reference
+				__smartptr_trait_lockable<T>::lock(p);
 				__smartptr_trait_lockable<T>::unlock(p);
 				delete p;
 			}
-			else
-				__smartptr_trait_lockable<T>::unlock(p);
 		}
 	private:
 		T *ptr;
@@ -36,6 +36,8 @@ namespace FreeOCL
 		void kill();
 		void join();
 		inline bool running() const	{	return b_running;	}
+		// Returns true when called from this thread
+		inline bool is_current() const	{	return b_running && pthread_equal(pt, pthread_self());	}
 
 	private:
 		static void *exec(void *p);
@@ -18,17 +18,19 @@
 #include "threadpool.h"
 #include <FreeOCL/config.h>
 #include <sched.h>
+#include <algorithm>
 #ifndef __GNUC__
 #include <atomic_ops.h>
 #endif
 #include <utils/time.h>
+#include <utils/memory_usage.h>
 #ifdef __SSE__
 #include <xmmintrin.h>
 #endif
 
 namespace FreeOCL
 {
-	threadpool::threadpool()
+	threadpool::threadpool() : task(NULL), task_data(NULL), nb_tasks(0), nb_threads(0)
 	{
 
 	}
@@ -83,16 +85,51 @@ namespace FreeOCL
 	{
 		this->setwg = setwg;
 		this->kernel = kernel;
+		this->task = NULL;
 
+		start_workers(nb_threads);
+    }
+
+	void threadpool::run_tasks(void (*task)(void *, const size_t), void *data, const size_t nb_tasks)
+	{
+		if (nb_tasks == 0)
+			return;
+		lock();
+		if (pool.empty())
+		{
+			for(size_t i = 0 ; i < nb_tasks ; ++i)
+				task(data, i);
+			unlock();
+			return;
+		}
+		this->task = task;
+		this->task_data = data;
+		this->nb_tasks = nb_tasks;
+
+		start_workers(std::min(nb_threads, nb_tasks));
+		this->task = NULL;
+		unlock();
+	}
+
+	void threadpool::run_tasks_locked(void (*task)(void *, const size_t), void *data, const size_t nb_tasks, const size_t nb_threads)
+	{
+		lock();
+		set_thread_num(nb_threads);
+		run_tasks(task, data, nb_tasks);
+		unlock();
+	}
+
+	void threadpool::start_workers(const size_t nb_workers)
+	{
 		next_workgroup = 0;
-		for(size_t i = 1 ; i < nb_threads ; ++i)
+		for(size_t i = 1 ; i < nb_workers ; ++i)
 		{
 			pool[i].set_working();
 			pool[i].start();
 		}
 		pool.front().work();
-        wait_for_all();
-    }
+		wait_for_all();
+	}
 
     threadpool::worker::~worker()
     {
@@ -102,6 +139,7 @@ namespace FreeOCL
 #else
             free(stack_data);
 #endif
+        process_memory_usage().release(CL_MEMORY_KIND_STACKS_FREEOCL, stack_data_size);
     }
 
     size_t threadpool::worker::proc()
@@ -137,6 +175,13 @@ namespace FreeOCL
 
 	void threadpool::worker::work()
 	{
+		if (pool->task)
+		{
+			for(size_t id = pool->get_next_workgroup() ; id < pool->nb_tasks ; id = pool->get_next_workgroup())
+				pool->task(pool->task_data, id);
+			return;
+		}
+
 		const size_t l_size = pool->local_size[0] * pool->local_size[1] * pool->local_size[2];
 		const size_t g_size = pool->num_groups[0] * pool->num_groups[1] * pool->num_groups[2];
 		char local_memory[0x8000];
@@ -177,6 +222,7 @@ namespace FreeOCL
                         free(stack_data);
                     stack_data = malloc(STACK_SIZE * l_size);
 #endif
+                    process_memory_usage().add(CL_MEMORY_KIND_STACKS_FREEOCL, STACK_SIZE * l_size - stack_data_size);
                     stack_data_size = STACK_SIZE * l_size;
                 }
 				for(size_t i = 0 ; i < l_size ; ++i)
@@ -19,6 +19,7 @@
 #define __FREEOCL_THREADPOOL_H__
 
 #include "thread.h"
+#include "mutex.h"
 #include <deque>
 #include <vector>
 #include <ucontext.h>
@@ -29,7 +30,7 @@
 
 namespace FreeOCL
 {
-	class threadpool
+	class threadpool : public mutex
 	{
 	private:
 		class worker : public thread
@@ -66,14 +67,24 @@ namespace FreeOCL
 		void set_thread_num(const size_t nb_threads);
 
         void run(void (*setwg)(char * const,const size_t *, ucontext_t *, ucontext_t *), void (*kernel)(DUMMYARGS const int));
+		// Runs task(data, i) for i in [0, nb_tasks) on at most nb_threads workers
+		void run_tasks(void (*task)(void *, const size_t), void *data, const size_t nb_tasks);
+		// Same as run_tasks with nb_threads workers, the pool being locked
+		// from set_thread_num to the end of the last task since it is
+		// shared by all command queues
+		void run_tasks_locked(void (*task)(void *, const size_t), void *data, const size_t nb_tasks, const size_t nb_threads);
 
 		void set_require_sync(bool b_require_sync);
 	private:
 		inline unsigned int get_next_workgroup();
+		void start_workers(const size_t nb_workers);
 
 	private:
         void (*kernel)(DUMMYARGS const int);
 		void (*setwg)(char * const,const size_t *, ucontext_t *, ucontext_t *);
+		void (*task)(void *, const size_t);
+		void *task_data;
+		size_t nb_tasks;
 		size_t num_groups[3];
 		size_t local_size[3];
 		size_t nb_threads;